@@ -0,0 +1,42 @@
+// matches CompactVertex in types.h
+struct CompactVertex {
+
+	uint positionXY;
+	uint positionZNormal;
+	uint uv;
+	uint color;
+};
+
+layout(buffer_reference, std430) readonly buffer CompactVertexBuffer{ 
+	CompactVertex vertices[];
+};
+
+struct UnpackedVertex {
+
+	vec3 position;
+	vec3 normal;
+	vec2 uv;
+	vec4 color;
+};
+
+// the octahedral encoding of vertex_format.cpp
+vec3 octahedral_decode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// positions are snorm16 in the box of the mesh
+UnpackedVertex unpack_vertex(CompactVertex v, vec4 positionOrigin, vec4 positionExtents)
+{
+	UnpackedVertex u;
+	vec3 q = vec3(unpackSnorm2x16(v.positionXY), unpackSnorm2x16(v.positionZNormal).x);
+	u.position = positionOrigin.xyz + q * positionExtents.xyz;
+	u.normal = octahedral_decode(unpackSnorm4x8(v.positionZNormal).zw);
+	u.uv = unpackHalf2x16(v.uv);
+	u.color = unpackUnorm4x8(v.color);
+	return u;
+}
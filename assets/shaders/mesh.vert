@@ -26,6 +26,8 @@ layout(buffer_reference, std430) readonly buffer VertexBuffer{
 layout( push_constant ) uniform constants
 {
 	mat4 render_matrix;
+	vec4 positionOrigin;
+	vec4 positionExtents;
 	VertexBuffer vertexBuffer;
 } PushConstants;
 
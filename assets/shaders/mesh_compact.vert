@@ -0,0 +1,34 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_buffer_reference : require
+
+#include "input_structures.glsl"
+#include "compact_vertex.glsl"
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+
+//push constants block
+layout( push_constant ) uniform constants
+{
+	mat4 render_matrix;
+	vec4 positionOrigin;
+	vec4 positionExtents;
+	CompactVertexBuffer vertexBuffer;
+} PushConstants;
+
+void main() 
+{
+	UnpackedVertex v = unpack_vertex(PushConstants.vertexBuffer.vertices[gl_VertexIndex],
+	                                 PushConstants.positionOrigin, PushConstants.positionExtents);
+	
+	vec4 position = vec4(v.position, 1.0f);
+
+	gl_Position =  sceneData.viewproj * PushConstants.render_matrix *position;
+
+	outNormal = (PushConstants.render_matrix * vec4(v.normal, 0.f)).xyz;
+	outColor = v.color.xyz * materialData.colorFactors.xyz;	
+	outUV = v.uv;
+}
@@ -0,0 +1,64 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_buffer_reference : require
+
+#include "input_structures.glsl"
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+
+struct Vertex {
+
+	vec3 position;
+	float uv_x;
+	vec3 normal;
+	float uv_y;
+	vec4 color;
+}; 
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer{ 
+	Vertex vertices[];
+};
+
+struct ObjectData {
+	mat4 transform;
+	vec4 boundsOrigin;
+	vec4 boundsExtents;
+	vec4 positionOrigin;
+	vec4 positionExtents;
+	VertexBuffer vertexBuffer;
+	uint firstIndex;
+	uint indexCount;
+	int vertexOffset;
+	uint batchIndex;
+	uint commandOffset;
+	uint pad;
+};
+
+layout(buffer_reference, std430) readonly buffer ObjectBuffer{ 
+	ObjectData objects[];
+};
+
+//push constants block
+layout( push_constant ) uniform constants
+{
+	ObjectBuffer objectBuffer;
+} PushConstants;
+
+void main() 
+{
+	// firstInstance of the indirect command is the object index
+	ObjectData obj = PushConstants.objectBuffer.objects[gl_InstanceIndex];
+	Vertex v = obj.vertexBuffer.vertices[gl_VertexIndex];
+	
+	vec4 position = vec4(v.position, 1.0f);
+
+	gl_Position =  sceneData.viewproj * obj.transform * position;
+
+	outNormal = (obj.transform * vec4(v.normal, 0.f)).xyz;
+	outColor = v.color.xyz * materialData.colorFactors.xyz;	
+	outUV.x = v.uv_x;
+	outUV.y = v.uv_y;
+}
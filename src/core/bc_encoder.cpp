@@ -0,0 +1,322 @@
+#include "core/bc_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//> bc_encoder
+// NOTE(champ): the two texels of the block that lie furthest apart along its
+// principal axis, found with a few power iterations on the covariance of the
+// first channel_count channels
+static void
+principal_endpoints(const u8* block, int channel_count, float lo[4], float hi[4])
+{
+    float mean[4] = {};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < channel_count; c++) {
+            mean[c] += block[i * 4 + c];
+        }
+    }
+    for (int c = 0; c < channel_count; c++) {
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[4] = {};
+        for (int c = 0; c < channel_count; c++) {
+            d[c] = block[i * 4 + c] - mean[c];
+        }
+        for (int a = 0; a < channel_count; a++) {
+            for (int b = 0; b < channel_count; b++) {
+                covariance[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < channel_count; a++) {
+            for (int b = 0; b < channel_count; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length = std::max(length, std::abs(next[a]));
+        }
+        if (length == 0.0f) {
+            break;
+        }
+        for (int a = 0; a < channel_count; a++) {
+            axis[a] = next[a] / length;
+        }
+    }
+
+    float min_t = 0.0f;
+    float max_t = 0.0f;
+    for (int c = 0; c < 4; c++) {
+        lo[c] = 0.0f;
+        hi[c] = 0.0f;
+    }
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channel_count; c++) {
+            t += (block[i * 4 + c] - mean[c]) * axis[c];
+        }
+        if (i == 0 || t < min_t) {
+            min_t = t;
+            for (int c = 0; c < channel_count; c++) {
+                lo[c] = block[i * 4 + c];
+            }
+        }
+        if (i == 0 || t > max_t) {
+            max_t = t;
+            for (int c = 0; c < channel_count; c++) {
+                hi[c] = block[i * 4 + c];
+            }
+        }
+    }
+}
+
+static int
+squared_distance(const int* a, const u8* b, int channel_count)
+{
+    int sum = 0;
+    for (int c = 0; c < channel_count; c++) {
+        int d = a[c] - b[c];
+        sum += d * d;
+    }
+    return sum;
+}
+
+static u16
+to_565(const float color[4])
+{
+    int r = std::clamp((int)(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+    int g = std::clamp((int)(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+    int b = std::clamp((int)(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+static void
+from_565(u16 packed, int color[3])
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// the color half of BC1 and BC3, always in four color mode
+static void
+encode_color(const u8* block, u8* out)
+{
+    float lo[4];
+    float hi[4];
+    principal_endpoints(block, 3, lo, hi);
+
+    u16 c0 = to_565(hi);
+    u16 c1 = to_565(lo);
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+
+    u32 indices = 0;
+    if (c0 != c1) {
+        int palette[4][3];
+        from_565(c0, palette[0]);
+        from_565(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int best_error = squared_distance(palette[0], block + i * 4, 3);
+            for (int p = 1; p < 4; p++) {
+                int error = squared_distance(palette[p], block + i * 4, 3);
+                if (error < best_error) {
+                    best = p;
+                    best_error = error;
+                }
+            }
+            indices |= (u32)best << (i * 2);
+        }
+    }
+
+    out[0] = (u8)(c0 & 0xff);
+    out[1] = (u8)(c0 >> 8);
+    out[2] = (u8)(c1 & 0xff);
+    out[3] = (u8)(c1 >> 8);
+    memcpy(out + 4, &indices, sizeof(indices));
+}
+
+// BC4 style block of one channel, the alpha of BC3 and both halves of BC5
+static void
+encode_channel(const u8* block, int channel, u8* out)
+{
+    int a0 = 0;
+    int a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, (int)block[i * 4 + channel]);
+        a1 = std::min(a1, (int)block[i * 4 + channel]);
+    }
+
+    u64 indices = 0;
+    if (a0 != a1) {
+        // a0 > a1 selects the eight value palette
+        int palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for (int p = 2; p < 8; p++) {
+            palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int value = block[i * 4 + channel];
+            int best = 0;
+            int best_error = std::abs(palette[0] - value);
+            for (int p = 1; p < 8; p++) {
+                int error = std::abs(palette[p] - value);
+                if (error < best_error) {
+                    best = p;
+                    best_error = error;
+                }
+            }
+            indices |= (u64)best << (i * 3);
+        }
+    }
+
+    out[0] = (u8)a0;
+    out[1] = (u8)a1;
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (u8)(indices >> (i * 8));
+    }
+}
+
+void
+bc::encode_bc1(const u8 block[64], u8 out[8])
+{
+    encode_color(block, out);
+}
+
+void
+bc::encode_bc3(const u8 block[64], u8 out[16])
+{
+    encode_channel(block, 3, out);
+    encode_color(block, out + 8);
+}
+
+void
+bc::encode_bc5(const u8 block[64], u8 out[16])
+{
+    encode_channel(block, 0, out);
+    encode_channel(block, 1, out + 8);
+}
+
+// NOTE(champ): BC7 blocks are one 128 bit little endian stream
+struct BitWriter {
+    u8* out;
+    u32 position = 0;
+
+    void put(u32 value, u32 bits)
+    {
+        for (u32 i = 0; i < bits; i++, position++) {
+            if (value & (1u << i)) {
+                out[position / 8] |= (u8)(1u << (position % 8));
+            }
+        }
+    }
+};
+
+static const int BC7_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// 7 bit endpoint plus the p bit shared by its four channels, picked to be
+// the closest to the wanted color
+static void
+quantize_bc7_endpoint(const float color[4], int quantized[4], int& pbit)
+{
+    int best_error = -1;
+    for (int p = 0; p < 2; p++) {
+        int candidate[4];
+        int error = 0;
+        for (int c = 0; c < 4; c++) {
+            candidate[c] = std::clamp((int)((color[c] - p) / 2.0f + 0.5f), 0, 127);
+            int d = ((candidate[c] << 1) | p) - (int)(color[c] + 0.5f);
+            error += d * d;
+        }
+        if (best_error < 0 || error < best_error) {
+            best_error = error;
+            pbit = p;
+            memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+void
+bc::encode_bc7(const u8 block[64], u8 out[16])
+{
+    float lo[4];
+    float hi[4];
+    principal_endpoints(block, 4, lo, hi);
+
+    int q[2][4];
+    int p[2];
+    quantize_bc7_endpoint(lo, q[0], p[0]);
+    quantize_bc7_endpoint(hi, q[1], p[1]);
+
+    int endpoints[2][4];
+    for (int e = 0; e < 2; e++) {
+        for (int c = 0; c < 4; c++) {
+            endpoints[e][c] = (q[e][c] << 1) | p[e];
+        }
+    }
+    int palette[16][4];
+    for (int w = 0; w < 16; w++) {
+        for (int c = 0; c < 4; c++) {
+            palette[w][c] = ((64 - BC7_WEIGHTS_4[w]) * endpoints[0][c] + BC7_WEIGHTS_4[w] * endpoints[1][c] + 32) >> 6;
+        }
+    }
+
+    int indices[16];
+    for (int i = 0; i < 16; i++) {
+        int best = 0;
+        int best_error = squared_distance(palette[0], block + i * 4, 4);
+        for (int w = 1; w < 16; w++) {
+            int error = squared_distance(palette[w], block + i * 4, 4);
+            if (error < best_error) {
+                best = w;
+                best_error = error;
+            }
+        }
+        indices[i] = best;
+    }
+
+    // the top bit of the first index is implied to be 0, flip the endpoints
+    // around when it is not
+    if (indices[0] & 8) {
+        std::swap(q[0], q[1]);
+        std::swap(p[0], p[1]);
+        for (int& index : indices) {
+            index = 15 - index;
+        }
+    }
+
+    memset(out, 0, 16);
+    BitWriter writer = { out };
+    writer.put(1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.put((u32)q[0][c], 7);
+        writer.put((u32)q[1][c], 7);
+    }
+    writer.put((u32)p[0], 1);
+    writer.put((u32)p[1], 1);
+    writer.put((u32)indices[0], 3);
+    for (int i = 1; i < 16; i++) {
+        writer.put((u32)indices[i], 4);
+    }
+}
+//< bc_encoder
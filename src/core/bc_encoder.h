@@ -0,0 +1,21 @@
+#pragma once
+
+#include "core/types.h"
+
+//> bc_encoder
+// NOTE(champ): CPU block compressors for the offline texture tool. They fit
+// the endpoints to the principal axis of each block and pick the closest
+// palette entry per texel, good enough for albedo and normal maps without
+// the search of a production encoder.
+// A block is 16 RGBA8 texels, row by row.
+namespace bc {
+    // opaque, alpha is ignored
+    void encode_bc1(const u8 block[64], u8 out[8]);
+    // BC1 color plus interpolated alpha
+    void encode_bc3(const u8 block[64], u8 out[16]);
+    // red and green only, for normal maps
+    void encode_bc5(const u8 block[64], u8 out[16]);
+    // mode 6 only: one subset, RGBA endpoints and 4 bit indices
+    void encode_bc7(const u8 block[64], u8 out[16]);
+}
+//< bc_encoder
@@ -0,0 +1,683 @@
+#include "core/benchmark.h"
+
+#include "core/engine.h"
+#include "core/scene_bake.h"
+#include "SDL3/SDL.h"
+#include "imgui.h"
+#include "imgui_impl_sdl3.h"
+#include "imgui_impl_vulkan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <glm/common.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtx/transform.hpp>
+
+struct TimingSummary {
+    float mean;
+    float p50;
+    float p95;
+    float p99;
+    float max;
+};
+
+struct TimingColumn {
+    const char* name;
+    float FrameTimings::* member;
+};
+
+static const TimingColumn timing_columns[] = {
+    {"update_scene",   &FrameTimings::update_scene_time},
+    {"draw_geometry",  &FrameTimings::draw_geometry_time},
+    {"draw",           &FrameTimings::draw_time},
+    {"gpu_frame",      &FrameTimings::gpu_frame_time},
+    {"gpu_background", &FrameTimings::gpu_background_time},
+    {"gpu_geometry",   &FrameTimings::gpu_geometry_time},
+    {"gpu_blit",       &FrameTimings::gpu_blit_time},
+    {"gpu_imgui",      &FrameTimings::gpu_imgui_time},
+    {"input_to_submit", &FrameTimings::input_to_submit},
+    {"submit_to_done", &FrameTimings::submit_to_done},
+};
+constexpr size_t TIMING_COLUMN_COUNT = sizeof(timing_columns) / sizeof(timing_columns[0]);
+
+static TimingSummary summarize(std::vector<float> values);
+static bool write_csv_report(const std::string& path,
+                             const std::vector<FrameTimings>& frames,
+                             const TimingSummary* summaries);
+static bool write_json_report(const std::string& path,
+                              const BenchmarkConfig& config,
+                              const std::vector<FrameTimings>& frames,
+                              const TimingSummary* summaries);
+
+std::optional<CameraPath>
+benchmark::load_camera_path(const std::string& filePath)
+{
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        spdlog::error("Failed to open camera path at: {}!", filePath);
+        return {};
+    }
+
+    // NOTE(champ): one keyframe per line: "pos_x pos_y pos_z pitch yaw"
+    // lines starting with # are comments
+    CameraPath path;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        CameraKeyframe keyframe = {};
+        int read = sscanf(line.c_str(), "%f %f %f %f %f",
+                          &keyframe.position.x, &keyframe.position.y, &keyframe.position.z,
+                          &keyframe.pitch, &keyframe.yaw);
+        if (read != 5) {
+            spdlog::warn("Skipping malformed camera keyframe: {}", line);
+            continue;
+        }
+        path.keyframes.push_back(keyframe);
+    }
+
+    if (path.keyframes.empty()) {
+        spdlog::error("Camera path at {} has no keyframes!", filePath);
+        return {};
+    }
+    return path;
+}
+
+bool
+benchmark::save_camera_path(const CameraPath& path, const std::string& filePath)
+{
+    FILE* file = fopen(filePath.c_str(), "w");
+    if (file == nullptr) {
+        spdlog::error("Failed to open {} for writing!", filePath);
+        return false;
+    }
+
+    fprintf(file, "# pos_x pos_y pos_z pitch yaw\n");
+    for (const CameraKeyframe& k : path.keyframes) {
+        fprintf(file, "%f %f %f %f %f\n",
+                k.position.x, k.position.y, k.position.z, k.pitch, k.yaw);
+    }
+    fclose(file);
+
+    spdlog::info("Saved camera path with {} keyframes to {}", path.keyframes.size(), filePath);
+    return true;
+}
+
+CameraPath
+benchmark::make_orbit_path(float radius, float height, u32 keyframeCount)
+{
+    CameraPath path;
+    for (u32 i = 0; i < keyframeCount; i++) {
+        float angle = glm::two_pi<float>() * (float)i / (float)(keyframeCount - 1);
+
+        // NOTE(champ): the camera yaw rotates around -Y, so looking back at
+        // the origin from this point of the circle is a yaw of -angle
+        CameraKeyframe keyframe = {};
+        keyframe.position = glm::vec3{radius * std::sin(angle), height, radius * std::cos(angle)};
+        keyframe.pitch = 0.0f;
+        keyframe.yaw = -angle;
+        path.keyframes.push_back(keyframe);
+    }
+    return path;
+}
+
+CameraKeyframe
+benchmark::sample_camera_path(const CameraPath& path, float t)
+{
+    assert(!path.keyframes.empty());
+    if (path.keyframes.size() == 1) {
+        return path.keyframes[0];
+    }
+
+    t = glm::clamp(t, 0.0f, 1.0f);
+    float position = t * (float)(path.keyframes.size() - 1);
+    size_t index = std::min((size_t)position, path.keyframes.size() - 2);
+    float alpha = position - (float)index;
+
+    const CameraKeyframe& a = path.keyframes[index];
+    const CameraKeyframe& b = path.keyframes[index + 1];
+
+    CameraKeyframe result = {};
+    result.position = glm::mix(a.position, b.position, alpha);
+    result.pitch = glm::mix(a.pitch, b.pitch, alpha);
+    result.yaw = glm::mix(a.yaw, b.yaw, alpha);
+    return result;
+}
+
+void
+benchmark::apply_keyframe(Camera* camera, const CameraKeyframe& keyframe)
+{
+    camera->velocity = glm::vec3{0.0f};
+    camera->position = keyframe.position;
+    camera->pitch = keyframe.pitch;
+    camera->yaw = keyframe.yaw;
+}
+
+bool
+benchmark::run(VulkanEngine* engine, const BenchmarkConfig& config)
+{
+    CameraPath path;
+    if (!config.cameraPathFile.empty()) {
+        auto loaded = load_camera_path(config.cameraPathFile);
+        if (!loaded.has_value()) {
+            return false;
+        }
+        path = *loaded;
+    } else {
+        path = make_orbit_path(10.0f, 2.0f, 64);
+    }
+
+    // NOTE(champ): only the benchmarked scene should be drawn
+    vkDeviceWaitIdle(engine->_device);
+    engine->loadedScenes.clear();
+    auto scene = gltf::load_scene_from_file(engine, config.scenePath);
+    if (!scene.has_value()) {
+        spdlog::error("Failed to load benchmark scene at: {}!", config.scenePath);
+        return false;
+    }
+    engine->loadedScenes["benchmark"] = *scene;
+
+    spdlog::info("Benchmarking {} for {} frames ({} warmup)",
+                 config.scenePath, config.frameCount, config.warmupFrames);
+
+    std::vector<FrameTimings> frames;
+    frames.reserve(config.frameCount);
+
+    const u32 totalFrames = config.warmupFrames + config.frameCount;
+    for (u32 i = 0; i < totalFrames; i++) {
+        if (!engine->_headless) {
+            // keep the window responsive and imgui draw data valid
+            SDL_Event e;
+            while (SDL_PollEvent(&e) != 0) {
+                if (e.type == SDL_EVENT_QUIT) {
+                    spdlog::warn("Benchmark aborted!");
+                    return false;
+                }
+            }
+            ImGui_ImplVulkan_NewFrame();
+            ImGui_ImplSDL3_NewFrame();
+            ImGui::NewFrame();
+            ImGui::Render();
+        }
+
+        // warmup frames sit at the start of the path
+        float t = 0.0f;
+        if (i >= config.warmupFrames && config.frameCount > 1) {
+            t = (float)(i - config.warmupFrames) / (float)(config.frameCount - 1);
+        }
+        apply_keyframe(&engine->mainCamera, sample_camera_path(path, t));
+
+        u64 start = SDL_GetTicksNS();
+        engine->draw();
+        u64 end = SDL_GetTicksNS();
+
+        if (i < config.warmupFrames) {
+            continue;
+        }
+
+        const EngineStats& stats = engine->stats;
+        FrameTimings timings = {};
+        timings.update_scene_time = stats.scene_update_time;
+        timings.draw_geometry_time = stats.mesh_draw_time;
+        timings.draw_time = (float)(end - start) / 1000000.0f;
+        timings.gpu_frame_time = stats.gpu_frame_time;
+        timings.gpu_background_time = stats.gpu_background_time;
+        timings.gpu_geometry_time = stats.gpu_geometry_time;
+        timings.gpu_blit_time = stats.gpu_blit_time;
+        timings.gpu_imgui_time = stats.gpu_imgui_time;
+        timings.input_to_submit = stats.input_to_submit;
+        timings.submit_to_done = stats.submit_to_gpu_done;
+        frames.push_back(timings);
+    }
+    vkDeviceWaitIdle(engine->_device);
+
+    TimingSummary summaries[TIMING_COLUMN_COUNT];
+    for (size_t i = 0; i < TIMING_COLUMN_COUNT; i++) {
+        std::vector<float> values;
+        values.reserve(frames.size());
+        for (const FrameTimings& f : frames) {
+            values.push_back(f.*timing_columns[i].member);
+        }
+        summaries[i] = summarize(std::move(values));
+        spdlog::info("{:>14}: mean {:.3f} ms | p50 {:.3f} ms | p95 {:.3f} ms | p99 {:.3f} ms | max {:.3f} ms",
+                     timing_columns[i].name, summaries[i].mean, summaries[i].p50,
+                     summaries[i].p95, summaries[i].p99, summaries[i].max);
+    }
+
+    // NOTE(champ): rough hint of what limits the frame, the GPU frame time
+    // covers the whole command buffer while draw is the CPU side of it
+    const TimingSummary& cpu = summaries[2];
+    const TimingSummary& gpu = summaries[3];
+    spdlog::info("Frame looks {}-bound (p50 cpu {:.3f} ms vs gpu {:.3f} ms)",
+                 cpu.p50 >= gpu.p50 ? "CPU" : "GPU", cpu.p50, gpu.p50);
+
+    const std::string& report = config.reportPath;
+    bool isJson = report.size() >= 5 && report.compare(report.size() - 5, 5, ".json") == 0;
+    if (isJson) {
+        return write_json_report(report, config, frames, summaries);
+    }
+    return write_csv_report(report, frames, summaries);
+}
+
+bool
+benchmark::run_load_benchmark(VulkanEngine* engine, const std::string& scenePath, u32 iterations)
+{
+    // NOTE(champ): the bake is written up front if it is missing or stale so
+    // that only loading it is timed
+    if (!bake::is_up_to_date(scenePath) && !gltf::bake_scene(scenePath, &engine->_jobSystem)) {
+        spdlog::error("Failed to bake benchmark scene at: {}!", scenePath);
+        return false;
+    }
+
+    // NOTE(champ): serial, parallel and baked loads are interleaved so all
+    // see the same disk cache state, the first iteration is mostly a cold load
+    enum LoadKind { LOAD_SERIAL, LOAD_PARALLEL, LOAD_BAKED, LOAD_KIND_COUNT };
+    std::vector<float> times[LOAD_KIND_COUNT];
+    vkDeviceWaitIdle(engine->_device);
+    for (u32 i = 0; i < iterations; i++) {
+        for (int kind = 0; kind < LOAD_KIND_COUNT; kind++) {
+            u64 start = SDL_GetTicksNS();
+            auto scene = kind == LOAD_BAKED
+                ? gltf::load_scene_from_bake(engine, bake::bake_path(scenePath))
+                : gltf::load_scene_from_file(engine, scenePath, kind == LOAD_PARALLEL, nullptr, false);
+            u64 end = SDL_GetTicksNS();
+            if (!scene.has_value()) {
+                spdlog::error("Failed to load benchmark scene at: {}!", scenePath);
+                return false;
+            }
+
+            float ms = (float)(end - start) / 1000000.0f;
+            times[kind].push_back(ms);
+        }
+    }
+
+    TimingSummary serial = summarize(times[LOAD_SERIAL]);
+    TimingSummary parallel = summarize(times[LOAD_PARALLEL]);
+    TimingSummary baked = summarize(times[LOAD_BAKED]);
+    spdlog::info("Load benchmark of {} over {} iterations with {} worker threads",
+                 scenePath, iterations, engine->_jobSystem.worker_count());
+    spdlog::info("  serial: mean {:.2f} ms | p50 {:.2f} ms | max {:.2f} ms", serial.mean, serial.p50, serial.max);
+    spdlog::info("parallel: mean {:.2f} ms | p50 {:.2f} ms | max {:.2f} ms", parallel.mean, parallel.p50, parallel.max);
+    spdlog::info("   baked: mean {:.2f} ms | p50 {:.2f} ms | max {:.2f} ms", baked.mean, baked.p50, baked.max);
+    if (parallel.p50 > 0.0f) {
+        spdlog::info(" speedup: {:.2f}x parallel over serial", serial.p50 / parallel.p50);
+    }
+    if (baked.p50 > 0.0f) {
+        spdlog::info(" speedup: {:.2f}x baked over parallel", parallel.p50 / baked.p50);
+    }
+    return true;
+}
+
+void
+benchmark::run_vertex_benchmark(const std::vector<std::string>& scenePaths, u32 iterations)
+{
+    for (const std::string& scenePath : scenePaths) {
+        std::vector<float> readTimes;
+        std::vector<float> bulkTimes;
+        u64 vertexCount = 0;
+        if (!gltf::time_mesh_conversion(scenePath, iterations, false, readTimes, &vertexCount)
+            || !gltf::time_mesh_conversion(scenePath, iterations, true, bulkTimes, &vertexCount)) {
+            continue;
+        }
+
+        TimingSummary read = summarize(readTimes);
+        TimingSummary bulk = summarize(bulkTimes);
+        // vertices per second from the median pass, in millions
+        auto mverts = [&](const TimingSummary& s) {
+            return s.p50 > 0.0f ? (double)vertexCount / (s.p50 * 1000.0) : 0.0;
+        };
+        spdlog::info("Vertex conversion of {} ({} vertices) over {} iterations", scenePath, vertexCount, iterations);
+        spdlog::info("per element: p50 {:.3f} ms | {:.1f} Mverts/s", read.p50, mverts(read));
+        spdlog::info("       bulk: p50 {:.3f} ms | {:.1f} Mverts/s", bulk.p50, mverts(bulk));
+        if (bulk.p50 > 0.0f) {
+            spdlog::info("    speedup: {:.2f}x", read.p50 / bulk.p50);
+        }
+    }
+}
+
+void
+benchmark::run_culling_benchmark(u32 iterations)
+{
+    // NOTE(champ): same projection as update_scene, looking down -Z from the
+    // origin into a cube of randomly placed, rotated and scaled boxes
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 1000.0f, 0.1f);
+    projection[1][1] *= -1;
+    glm::mat4 viewproj = projection * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum = extract_frustum(viewproj);
+
+    for (u32 objectCount : {10000u, 100000u}) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.5f, 5.0f);
+        std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+
+        std::vector<RenderObject> objects(objectCount);
+        for (RenderObject& obj : objects) {
+            obj = {};
+            obj.bounds.origin = glm::vec3(0.0f);
+            obj.bounds.extents = glm::vec3(size(rng), size(rng), size(rng));
+            obj.bounds.sphere_radius = glm::length(obj.bounds.extents);
+            obj.transform = glm::translate(glm::vec3(position(rng), position(rng), position(rng)))
+                * glm::rotate(angle(rng), glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)))
+                * glm::scale(glm::vec3(size(rng) * 0.5f));
+        }
+
+        std::vector<float> scalarTimes;
+        std::vector<float> buildTimes;
+        std::vector<float> soaScalarTimes;
+        std::vector<float> simdTimes;
+        u32 scalarVisible = 0;
+        u32 simdVisible = 0;
+        CullingBounds bounds;
+        std::vector<u32> visible;
+        visible.reserve(objectCount);
+
+        for (u32 i = 0; i < iterations; i++) {
+            visible.clear();
+            u64 start = SDL_GetTicksNS();
+            for (u32 o = 0; o < objectCount; o++) {
+                if (is_renderobj_visible(objects[o], viewproj)) {
+                    visible.push_back(o);
+                }
+            }
+            u64 end = SDL_GetTicksNS();
+            scalarTimes.push_back((float)(end - start) / 1000000.0f);
+            scalarVisible = (u32)visible.size();
+
+            start = SDL_GetTicksNS();
+            build_culling_bounds(objects, bounds);
+            end = SDL_GetTicksNS();
+            buildTimes.push_back((float)(end - start) / 1000000.0f);
+
+            visible.clear();
+            start = SDL_GetTicksNS();
+            cull_frustum_scalar(bounds, frustum, visible);
+            end = SDL_GetTicksNS();
+            soaScalarTimes.push_back((float)(end - start) / 1000000.0f);
+
+            visible.clear();
+            start = SDL_GetTicksNS();
+            simdVisible = cull_frustum_simd(bounds, frustum, visible);
+            end = SDL_GetTicksNS();
+            simdTimes.push_back((float)(end - start) / 1000000.0f);
+        }
+
+        TimingSummary scalar = summarize(scalarTimes);
+        TimingSummary build = summarize(buildTimes);
+        TimingSummary soaScalar = summarize(soaScalarTimes);
+        TimingSummary simd = summarize(simdTimes);
+        spdlog::info("Culling benchmark, {} objects over {} iterations", objectCount, iterations);
+        spdlog::info("   is_renderobj_visible: p50 {:.3f} ms | max {:.3f} ms | {} visible", scalar.p50, scalar.max, scalarVisible);
+        spdlog::info("    SoA bounds building: p50 {:.3f} ms | max {:.3f} ms", build.p50, build.max);
+        spdlog::info("     SoA planes, scalar: p50 {:.3f} ms | max {:.3f} ms", soaScalar.p50, soaScalar.max);
+        spdlog::info("       SoA planes, SIMD: p50 {:.3f} ms | max {:.3f} ms | {} visible", simd.p50, simd.max, simdVisible);
+        if (simd.p50 > 0.0f) {
+            spdlog::info("  speedup over scalar: {:.2f}x culling only, {:.2f}x with building",
+                         scalar.p50 / simd.p50, scalar.p50 / (simd.p50 + build.p50));
+        }
+    }
+}
+
+void
+benchmark::run_sort_benchmark(u32 iterations)
+{
+    // NOTE(champ): a few pipelines, materials and meshes shared by many
+    // objects spread in front of the camera, like a large loaded scene
+    constexpr u32 PIPELINE_COUNT = 2;
+    constexpr u32 MATERIAL_COUNT = 256;
+    constexpr u32 MESH_COUNT = 2048;
+    MaterialPipeline pipelines[PIPELINE_COUNT] = {};
+    std::vector<MaterialInstance> materials(MATERIAL_COUNT);
+    for (u32 i = 0; i < MATERIAL_COUNT; i++) {
+        materials[i] = {};
+        materials[i].pipeline = &pipelines[i % PIPELINE_COUNT];
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 1000.0f, 0.1f);
+    projection[1][1] *= -1;
+    glm::mat4 viewproj = projection * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (u32 objectCount : {10000u, 100000u}) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_int_distribution<u32> material(0, MATERIAL_COUNT - 1);
+        std::uniform_int_distribution<u32> mesh(0, MESH_COUNT - 1);
+
+        std::vector<RenderObject> objects(objectCount);
+        std::vector<u64> stateKeys(objectCount);
+        SortKeyIds ids;
+        for (u32 o = 0; o < objectCount; o++) {
+            RenderObject& obj = objects[o];
+            obj = {};
+            obj.material = &materials[material(rng)];
+            obj.indexBuffer = VK_NULL_HANDLE;
+            obj.firstIndex = mesh(rng) * 3000;
+            obj.bounds.origin = glm::vec3(0.0f);
+            obj.transform = glm::translate(glm::vec3(position(rng), position(rng), position(rng) * 0.5f - 500.0f));
+            stateKeys[o] = ids.state_key(obj);
+        }
+
+        std::vector<float> comparatorTimes;
+        std::vector<float> keyTimes;
+        std::vector<float> keySortTimes;
+        std::vector<float> radixTimes;
+        std::vector<u32> order(objectCount);
+        std::vector<DrawKey> keys;
+        std::vector<DrawKey> sortedKeys;
+        std::vector<DrawKey> scratch;
+        bool sameOrder = true;
+
+        for (u32 i = 0; i < iterations; i++) {
+            // what draw_geometry did before the sort keys
+            for (u32 o = 0; o < objectCount; o++) {
+                order[o] = o;
+            }
+            u64 start = SDL_GetTicksNS();
+            std::sort(order.begin(), order.end(), [&](u32 iA, u32 iB) {
+                const RenderObject& A = objects[iA];
+                const RenderObject& B = objects[iB];
+                if (A.material == B.material) {
+                    if (A.indexBuffer == B.indexBuffer) {
+                        return A.firstIndex < B.firstIndex;
+                    }
+                    return A.indexBuffer < B.indexBuffer;
+                }
+                return A.material < B.material;
+            });
+            u64 end = SDL_GetTicksNS();
+            comparatorTimes.push_back((float)(end - start) / 1000000.0f);
+
+            start = SDL_GetTicksNS();
+            keys.clear();
+            keys.reserve(objectCount);
+            for (u32 o = 0; o < objectCount; o++) {
+                const glm::mat4& m = objects[o].transform;
+                float depth = viewproj[0][3] * m[3].x + viewproj[1][3] * m[3].y
+                    + viewproj[2][3] * m[3].z + viewproj[3][3];
+                keys.push_back({ opaque_sort_key(stateKeys[o], quantize_depth(depth, 1000.0f)), o });
+            }
+            end = SDL_GetTicksNS();
+            keyTimes.push_back((float)(end - start) / 1000000.0f);
+
+            sortedKeys = keys;
+            start = SDL_GetTicksNS();
+            std::sort(sortedKeys.begin(), sortedKeys.end(),
+                      [](const DrawKey& a, const DrawKey& b) { return a.key < b.key; });
+            end = SDL_GetTicksNS();
+            keySortTimes.push_back((float)(end - start) / 1000000.0f);
+
+            start = SDL_GetTicksNS();
+            radix_sort(keys, scratch);
+            end = SDL_GetTicksNS();
+            radixTimes.push_back((float)(end - start) / 1000000.0f);
+
+            for (u32 o = 0; o < objectCount; o++) {
+                sameOrder = sameOrder && keys[o].key == sortedKeys[o].key;
+            }
+        }
+
+        TimingSummary comparator = summarize(comparatorTimes);
+        TimingSummary keyBuild = summarize(keyTimes);
+        TimingSummary keySort = summarize(keySortTimes);
+        TimingSummary radix = summarize(radixTimes);
+        spdlog::info("Sort benchmark, {} draws over {} iterations", objectCount, iterations);
+        spdlog::info("  std::sort, comparator: p50 {:.3f} ms | max {:.3f} ms", comparator.p50, comparator.max);
+        spdlog::info("      building the keys: p50 {:.3f} ms | max {:.3f} ms", keyBuild.p50, keyBuild.max);
+        spdlog::info("        std::sort, keys: p50 {:.3f} ms | max {:.3f} ms", keySort.p50, keySort.max);
+        spdlog::info("       radix sort, keys: p50 {:.3f} ms | max {:.3f} ms | {}", radix.p50, radix.max,
+                     sameOrder ? "same order as std::sort" : "ORDER DIFFERS FROM std::sort");
+        if (radix.p50 > 0.0f) {
+            spdlog::info("  speedup over the comparator: {:.2f}x sort only, {:.2f}x with building",
+                         comparator.p50 / radix.p50, comparator.p50 / (radix.p50 + keyBuild.p50));
+        }
+    }
+}
+
+static TimingSummary
+summarize(std::vector<float> values)
+{
+    TimingSummary summary = {};
+    if (values.empty()) {
+        return summary;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    // nearest-rank percentile on the sorted samples
+    auto percentile = [&](float p) {
+        size_t rank = (size_t)std::ceil(p / 100.0f * (float)values.size());
+        rank = std::clamp<size_t>(rank, 1, values.size());
+        return values[rank - 1];
+    };
+
+    double sum = 0.0;
+    for (float v : values) {
+        sum += v;
+    }
+    summary.mean = (float)(sum / (double)values.size());
+    summary.p50 = percentile(50.0f);
+    summary.p95 = percentile(95.0f);
+    summary.p99 = percentile(99.0f);
+    summary.max = values.back();
+    return summary;
+}
+
+static bool
+write_csv_report(const std::string& path,
+                 const std::vector<FrameTimings>& frames,
+                 const TimingSummary* summaries)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        spdlog::error("Failed to open {} for writing!", path);
+        return false;
+    }
+    fprintf(file, "frame");
+    for (const TimingColumn& column : timing_columns) {
+        fprintf(file, ",%s_ms", column.name);
+    }
+    fprintf(file, "\n");
+    for (size_t i = 0; i < frames.size(); i++) {
+        fprintf(file, "%zu", i);
+        for (const TimingColumn& column : timing_columns) {
+            fprintf(file, ",%f", frames[i].*column.member);
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+
+    // NOTE(champ): the summary goes in a separate file so the per-frame CSV
+    // stays a plain table that any tool can load
+    std::string summaryPath = path;
+    size_t dot = summaryPath.find_last_of('.');
+    if (dot != std::string::npos) {
+        summaryPath.erase(dot);
+    }
+    summaryPath += "_summary.csv";
+
+    file = fopen(summaryPath.c_str(), "w");
+    if (file == nullptr) {
+        spdlog::error("Failed to open {} for writing!", summaryPath);
+        return false;
+    }
+    fprintf(file, "timing,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+    for (size_t i = 0; i < TIMING_COLUMN_COUNT; i++) {
+        const TimingSummary& s = summaries[i];
+        fprintf(file, "%s,%f,%f,%f,%f,%f\n", timing_columns[i].name, s.mean, s.p50, s.p95, s.p99, s.max);
+    }
+    fclose(file);
+
+    spdlog::info("Wrote benchmark report to {} and {}", path, summaryPath);
+    return true;
+}
+
+// NOTE(champ): scene paths are user input, Windows ones are full of
+// backslashes
+static std::string
+json_escape(const std::string& text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", (unsigned)(unsigned char)c);
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+static bool
+write_json_report(const std::string& path,
+                  const BenchmarkConfig& config,
+                  const std::vector<FrameTimings>& frames,
+                  const TimingSummary* summaries)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        spdlog::error("Failed to open {} for writing!", path);
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"scene\": \"%s\",\n", json_escape(config.scenePath).c_str());
+    fprintf(file, "  \"frame_count\": %zu,\n", frames.size());
+    fprintf(file, "  \"summary\": {\n");
+    for (size_t i = 0; i < TIMING_COLUMN_COUNT; i++) {
+        const TimingSummary& s = summaries[i];
+        fprintf(file, "    \"%s\": {\"mean_ms\": %f, \"p50_ms\": %f, \"p95_ms\": %f, \"p99_ms\": %f, \"max_ms\": %f}%s\n",
+                timing_columns[i].name, s.mean, s.p50, s.p95, s.p99, s.max,
+                i + 1 < TIMING_COLUMN_COUNT ? "," : "");
+    }
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"frames\": [\n");
+    for (size_t i = 0; i < frames.size(); i++) {
+        fprintf(file, "    {");
+        for (size_t c = 0; c < TIMING_COLUMN_COUNT; c++) {
+            fprintf(file, "\"%s_ms\": %f%s", timing_columns[c].name,
+                    frames[i].*timing_columns[c].member,
+                    c + 1 < TIMING_COLUMN_COUNT ? ", " : "");
+        }
+        fprintf(file, "}%s\n", i + 1 < frames.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+    fclose(file);
+
+    spdlog::info("Wrote benchmark report to {}", path);
+    return true;
+}
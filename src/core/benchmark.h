@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core/types.h"
+#include "core/camera.h"
+#include <optional>
+#include <vector>
+
+struct VulkanEngine;
+
+// NOTE(champ): one recorded camera pose, paths are replayed by interpolating
+// between consecutive keyframes
+struct CameraKeyframe {
+    glm::vec3 position;
+    float pitch;
+    float yaw;
+};
+
+struct CameraPath {
+    std::vector<CameraKeyframe> keyframes;
+};
+
+// timings of a single benchmark frame, in miliseconds
+// NOTE(champ): GPU times come from timestamp queries and lag frames in
+// flight frames behind the CPU times of the same row, so does submit_to_done
+struct FrameTimings {
+    float update_scene_time;
+    float draw_geometry_time;
+    float draw_time;
+    float gpu_frame_time;
+    float gpu_background_time;
+    float gpu_geometry_time;
+    float gpu_blit_time;
+    float gpu_imgui_time;
+    float input_to_submit;
+    float submit_to_done;
+};
+
+struct BenchmarkConfig {
+    std::string scenePath;
+    // if empty, a default orbit around the origin is used
+    std::string cameraPathFile;
+    // .json writes a JSON report, anything else is written as CSV
+    std::string reportPath = "benchmark.csv";
+    u32 frameCount = 1000;
+    u32 warmupFrames = 30;
+};
+
+namespace benchmark {
+    std::optional<CameraPath> load_camera_path(const std::string& filePath);
+    bool save_camera_path(const CameraPath& path, const std::string& filePath);
+    CameraPath make_orbit_path(float radius, float height, u32 keyframeCount);
+    CameraKeyframe sample_camera_path(const CameraPath& path, float t);
+    void apply_keyframe(Camera* camera, const CameraKeyframe& keyframe);
+
+    bool run(VulkanEngine* engine, const BenchmarkConfig& config);
+    // loads a scene serially, in parallel and from its bake and reports the
+    // speedups, bakes the scene first if needed
+    bool run_load_benchmark(VulkanEngine* engine, const std::string& scenePath, u32 iterations);
+    // CPU only, converts the meshes of each file with and without the bulk
+    // accessor path and reports vertices per second
+    void run_vertex_benchmark(const std::vector<std::string>& scenePaths, u32 iterations);
+    // CPU only, compares is_renderobj_visible against the SoA culling on
+    // random objects, does not need an initialized engine
+    void run_culling_benchmark(u32 iterations);
+    // CPU only, compares the old comparator std::sort of the draws against
+    // std::sort and radix sort of the packed keys
+    void run_sort_benchmark(u32 iterations);
+}
@@ -0,0 +1,146 @@
+#include "core/bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <glm/common.hpp>
+
+static AABB
+empty_box()
+{
+    return { glm::vec3(std::numeric_limits<float>::max()),
+             glm::vec3(std::numeric_limits<float>::lowest()) };
+}
+
+static void
+grow(AABB& box, const AABB& other)
+{
+    box.min = glm::min(box.min, other.min);
+    box.max = glm::max(box.max, other.max);
+}
+
+AABB
+transform_box(const glm::vec3& origin,
+              const glm::vec3& extents,
+              const glm::mat4& transform)
+{
+    glm::vec3 center = glm::vec3(transform * glm::vec4(origin, 1.0f));
+    glm::vec3 halfSize;
+    for (int axis = 0; axis < 3; axis++) {
+        halfSize[axis] = std::abs(transform[0][axis]) * extents.x
+            + std::abs(transform[1][axis]) * extents.y
+            + std::abs(transform[2][axis]) * extents.z;
+    }
+    return { center - halfSize, center + halfSize };
+}
+
+FrustumTest
+test_frustum(const AABB& box, const Frustum& frustum)
+{
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 halfSize = (box.max - box.min) * 0.5f;
+
+    FrustumTest result = FrustumTest::INSIDE;
+    for (const glm::vec4& plane : frustum.planes) {
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float radius = std::abs(plane.x) * halfSize.x + std::abs(plane.y) * halfSize.y + std::abs(plane.z) * halfSize.z;
+        if (distance + radius < 0.0f) {
+            return FrustumTest::OUTSIDE;
+        }
+        if (distance - radius < 0.0f) {
+            result = FrustumTest::INTERSECTS;
+        }
+    }
+    return result;
+}
+
+//> bvh
+void
+BVH::build(const std::vector<AABB>& boxes)
+{
+    clear();
+    if (boxes.empty()) {
+        return;
+    }
+
+    itemBounds = boxes;
+    itemOrder.resize(boxes.size());
+    std::iota(itemOrder.begin(), itemOrder.end(), 0u);
+
+    nodes.reserve(2 * boxes.size() / BVH_LEAF_SIZE + 1);
+    nodes.push_back({});
+    subdivide(0, 0, (u32)boxes.size());
+}
+
+void
+BVH::subdivide(u32 nodeIndex, u32 first, u32 count)
+{
+    AABB bounds = empty_box();
+    AABB centers = empty_box();
+    for (u32 i = first; i < first + count; i++) {
+        const AABB& box = itemBounds[itemOrder[i]];
+        grow(bounds, box);
+        glm::vec3 center = (box.min + box.max) * 0.5f;
+        grow(centers, { center, center });
+    }
+    nodes[nodeIndex].bounds = bounds;
+
+    glm::vec3 spread = centers.max - centers.min;
+    int axis = 0;
+    if (spread.y > spread[axis]) axis = 1;
+    if (spread.z > spread[axis]) axis = 2;
+
+    // all the centers in the same spot can not be split any further
+    if (count <= BVH_LEAF_SIZE || spread[axis] <= 0.0f) {
+        nodes[nodeIndex].first = first;
+        nodes[nodeIndex].count = count;
+        return;
+    }
+
+    u32 mid = first + count / 2;
+    std::nth_element(itemOrder.begin() + first, itemOrder.begin() + mid, itemOrder.begin() + first + count,
+                     [&](u32 a, u32 b) {
+                         return itemBounds[a].min[axis] + itemBounds[a].max[axis]
+                             < itemBounds[b].min[axis] + itemBounds[b].max[axis];
+                     });
+
+    // NOTE(champ): push_back can move the array, only hold on to indices
+    u32 left = (u32)nodes.size();
+    nodes.push_back({});
+    nodes.push_back({});
+    nodes[nodeIndex].first = left;
+    nodes[nodeIndex].count = 0;
+
+    subdivide(left, first, mid - first);
+    subdivide(left + 1, mid, first + count - mid);
+}
+
+void
+BVH::refit(const std::vector<AABB>& boxes)
+{
+    itemBounds = boxes;
+    // children always come after their parent
+    for (size_t i = nodes.size(); i-- > 0;) {
+        BVHNode& node = nodes[i];
+        AABB bounds = empty_box();
+        if (node.count > 0) {
+            for (u32 j = node.first; j < node.first + node.count; j++) {
+                grow(bounds, itemBounds[itemOrder[j]]);
+            }
+        } else {
+            grow(bounds, nodes[node.first].bounds);
+            grow(bounds, nodes[node.first + 1].bounds);
+        }
+        node.bounds = bounds;
+    }
+}
+
+void
+BVH::clear()
+{
+    nodes.clear();
+    itemOrder.clear();
+    itemBounds.clear();
+}
+//< bvh
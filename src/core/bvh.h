@@ -0,0 +1,109 @@
+#pragma once
+
+#include "core/culling.h"
+#include "core/types.h"
+#include <vector>
+
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// axis aligned box around a box of half size extents centered on origin,
+// once moved by transform
+AABB transform_box(const glm::vec3& origin, const glm::vec3& extents, const glm::mat4& transform);
+
+enum class FrustumTest {
+    OUTSIDE,
+    INTERSECTS,
+    INSIDE,
+};
+
+FrustumTest test_frustum(const AABB& box, const Frustum& frustum);
+
+constexpr u32 BVH_LEAF_SIZE = 4;
+
+//> bvh
+// NOTE(champ): bounding volume hierarchy over a list of boxes, built by
+// splitting the items at the median of their centers along the longest axis.
+// Nodes are stored flat with every parent before its children, so refit only
+// has to walk the array backwards. Items are referred to by their index in
+// the boxes given to build().
+struct BVH {
+    struct BVHNode {
+        AABB bounds;
+        // leaves: first item in itemOrder, interior nodes: index of the left
+        // child, the right one comes right after it
+        u32 first;
+        // 0 for interior nodes
+        u32 count;
+    };
+
+    void build(const std::vector<AABB>& boxes);
+    // keeps the tree as it is and only recomputes the boxes, for when items
+    // moved but not enough to make a rebuild worth it
+    void refit(const std::vector<AABB>& boxes);
+    void clear();
+    bool empty() const { return nodes.empty(); }
+
+    // calls visit(item) for each item whose box touches the frustum. Subtrees
+    // outside of it are skipped whole and the items of subtrees fully inside
+    // are not tested anymore. Returns how many nodes were visited.
+    template<typename F>
+    u32 query(const Frustum& frustum, F&& visit) const;
+
+    std::vector<BVHNode> nodes;
+    std::vector<u32> itemOrder;
+    std::vector<AABB> itemBounds;
+
+    private:
+    void subdivide(u32 nodeIndex, u32 first, u32 count);
+};
+
+template<typename F>
+u32
+BVH::query(const Frustum& frustum, F&& visit) const
+{
+    if (nodes.empty()) {
+        return 0;
+    }
+
+    struct Entry {
+        u32 node;
+        bool inside;
+    };
+    // median splits keep the depth at log2 of the item count
+    Entry stack[64];
+    u32 stackSize = 0;
+    u32 visited = 0;
+    stack[stackSize++] = { 0, false };
+
+    while (stackSize > 0) {
+        Entry entry = stack[--stackSize];
+        const BVHNode& node = nodes[entry.node];
+        visited += 1;
+
+        bool inside = entry.inside;
+        if (!inside) {
+            FrustumTest test = test_frustum(node.bounds, frustum);
+            if (test == FrustumTest::OUTSIDE) {
+                continue;
+            }
+            inside = test == FrustumTest::INSIDE;
+        }
+
+        if (node.count > 0) {
+            for (u32 i = node.first; i < node.first + node.count; i++) {
+                u32 item = itemOrder[i];
+                if (inside || test_frustum(itemBounds[item], frustum) != FrustumTest::OUTSIDE) {
+                    visit(item);
+                }
+            }
+        } else {
+            stack[stackSize++] = { node.first + 1, inside };
+            stack[stackSize++] = { node.first, inside };
+        }
+    }
+    return visited;
+}
+//< bvh
@@ -0,0 +1,284 @@
+#include "core/culling.h"
+
+#include "core/engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE 1
+#endif
+
+Frustum
+extract_frustum(const glm::mat4& viewproj)
+{
+    // glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    auto row = [&](int i) {
+        return glm::vec4(viewproj[0][i], viewproj[1][i], viewproj[2][i], viewproj[3][i]);
+    };
+
+    Frustum frustum;
+    frustum.planes[0] = row(3) + row(0); // left
+    frustum.planes[1] = row(3) - row(0); // right
+    frustum.planes[2] = row(3) + row(1); // bottom
+    frustum.planes[3] = row(3) - row(1); // top
+    frustum.planes[4] = row(2);          // z >= 0
+    frustum.planes[5] = row(3) - row(2); // z <= w
+
+    // NOTE(champ): normalized so the plane distance can be compared against
+    // the sphere radius and the projected box extents
+    for (glm::vec4& plane : frustum.planes) {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f) {
+            plane /= length;
+        }
+    }
+    return frustum;
+}
+
+//> culling_bounds
+void
+CullingBounds::clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    radius.clear();
+    count = 0;
+}
+
+void
+CullingBounds::reserve(u32 objectCount)
+{
+    const u32 padded = (objectCount + CULLING_BATCH - 1) / CULLING_BATCH * CULLING_BATCH;
+    centerX.reserve(padded);
+    centerY.reserve(padded);
+    centerZ.reserve(padded);
+    extentX.reserve(padded);
+    extentY.reserve(padded);
+    extentZ.reserve(padded);
+    radius.reserve(padded);
+}
+
+void
+CullingBounds::push(const glm::vec3& origin,
+                    const glm::vec3& extents,
+                    float sphereRadius,
+                    const glm::mat4& transform)
+{
+    glm::vec4 center = transform * glm::vec4(origin, 1.0f);
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+
+    // the world space box around the transformed one is |M| * extents
+    extentX.push_back(std::abs(transform[0][0]) * extents.x + std::abs(transform[1][0]) * extents.y + std::abs(transform[2][0]) * extents.z);
+    extentY.push_back(std::abs(transform[0][1]) * extents.x + std::abs(transform[1][1]) * extents.y + std::abs(transform[2][1]) * extents.z);
+    extentZ.push_back(std::abs(transform[0][2]) * extents.x + std::abs(transform[1][2]) * extents.y + std::abs(transform[2][2]) * extents.z);
+
+    float scale = std::max({ glm::length(glm::vec3(transform[0])),
+                             glm::length(glm::vec3(transform[1])),
+                             glm::length(glm::vec3(transform[2])) });
+    radius.push_back(sphereRadius * scale);
+
+    count += 1;
+}
+
+void
+CullingBounds::finish()
+{
+    const u32 padded = (count + CULLING_BATCH - 1) / CULLING_BATCH * CULLING_BATCH;
+    centerX.resize(padded, 0.0f);
+    centerY.resize(padded, 0.0f);
+    centerZ.resize(padded, 0.0f);
+    extentX.resize(padded, 0.0f);
+    extentY.resize(padded, 0.0f);
+    extentZ.resize(padded, 0.0f);
+    radius.resize(padded, 0.0f);
+}
+//< culling_bounds
+
+void
+build_culling_bounds(const std::vector<RenderObject>& objects, CullingBounds& bounds)
+{
+    bounds.clear();
+    bounds.reserve((u32)objects.size());
+    for (const RenderObject& obj : objects) {
+        bounds.push(obj.bounds.origin, obj.bounds.extents, obj.bounds.sphere_radius, obj.transform);
+    }
+    bounds.finish();
+}
+
+u32
+cull_frustum_scalar(const CullingBounds& bounds,
+                    const Frustum& frustum,
+                    std::vector<u32>& visible)
+{
+    u32 added = 0;
+    for (u32 i = 0; i < bounds.size(); i++) {
+        bool inside = true;
+        for (const glm::vec4& plane : frustum.planes) {
+            float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+            float boxRadius = std::abs(plane.x) * bounds.extentX[i] + std::abs(plane.y) * bounds.extentY[i] + std::abs(plane.z) * bounds.extentZ[i];
+            // both volumes contain the object, the tighter one decides
+            if (distance + std::min(boxRadius, bounds.radius[i]) < 0.0f) {
+                inside = false;
+                break;
+            }
+        }
+        if (inside) {
+            visible.push_back(i);
+            added += 1;
+        }
+    }
+    return added;
+}
+
+//> cull_simd
+#if defined(CULLING_AVX)
+u32
+cull_frustum_simd(const CullingBounds& bounds,
+                  const Frustum& frustum,
+                  std::vector<u32>& visible)
+{
+    const u32 count = bounds.size();
+    const __m256 zero = _mm256_setzero_ps();
+    u32 added = 0;
+
+    for (u32 i = 0; i < count; i += 8) {
+        const __m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+        const __m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+        const __m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+        const __m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+        const __m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+        const __m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+        const __m256 rad = _mm256_loadu_ps(&bounds.radius[i]);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), cx),
+                                                          _mm256_mul_ps(_mm256_set1_ps(plane.y), cy)),
+                                            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), cz),
+                                                          _mm256_set1_ps(plane.w)));
+            __m256 boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), ex),
+                                                           _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), ey)),
+                                             _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), ez));
+            __m256 test = _mm256_add_ps(distance, _mm256_min_ps(boxRadius, rad));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(test, zero, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        for (u32 lane = 0; mask != 0; lane++, mask >>= 1) {
+            // the padding lanes past count are never reported
+            if ((mask & 1) && i + lane < count) {
+                visible.push_back(i + lane);
+                added += 1;
+            }
+        }
+    }
+    return added;
+}
+#elif defined(CULLING_SSE)
+u32
+cull_frustum_simd(const CullingBounds& bounds,
+                  const Frustum& frustum,
+                  std::vector<u32>& visible)
+{
+    const u32 count = bounds.size();
+    const __m128 zero = _mm_setzero_ps();
+    u32 added = 0;
+
+    for (u32 i = 0; i < count; i += 4) {
+        const __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+        const __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+        const __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        const __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+        const __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+        const __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+        const __m128 rad = _mm_loadu_ps(&bounds.radius[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx),
+                                                    _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz),
+                                                    _mm_set1_ps(plane.w)));
+            __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex),
+                                                     _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+                                          _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+            __m128 test = _mm_add_ps(distance, _mm_min_ps(boxRadius, rad));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(test, zero));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (u32 lane = 0; mask != 0; lane++, mask >>= 1) {
+            // the padding lanes past count are never reported
+            if ((mask & 1) && i + lane < count) {
+                visible.push_back(i + lane);
+                added += 1;
+            }
+        }
+    }
+    return added;
+}
+#else
+u32
+cull_frustum_simd(const CullingBounds& bounds,
+                  const Frustum& frustum,
+                  std::vector<u32>& visible)
+{
+    return cull_frustum_scalar(bounds, frustum, visible);
+}
+#endif
+//< cull_simd
+
+bool
+is_renderobj_visible(const RenderObject& obj, const glm::mat4& viewproj)
+{
+    glm::vec3 corners[] = {
+        glm::vec3 { 1, 1, 1 },
+        glm::vec3 { 1, 1, -1 },
+        glm::vec3 { 1, -1, 1 },
+        glm::vec3 { 1, -1, -1 },
+        glm::vec3 { -1, 1, 1 },
+        glm::vec3 { -1, 1, -1 },
+        glm::vec3 { -1, -1, 1 },
+        glm::vec3 { -1, -1, -1 },
+    };
+
+    glm::mat4 matrix = viewproj * obj.transform;
+    glm::vec3 min = {1.5, 1.5, 1.5};
+    glm::vec3 max = {-1.5, -1.5, -1.5};
+
+    // NOTE(champ): project each corner of the view frustum into clip space
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec4 v = matrix * glm::vec4(obj.bounds.origin + (corners[i] * obj.bounds.extents), 1.0f);
+
+        // perspective correction using the w component
+        v.x /= v.w;
+        v.y /= v.w;
+        v.z /= v.w;
+
+        min = glm::min(min, glm::vec3{v});
+        max = glm::max(max, glm::vec3{v});
+    }
+
+    // NOTE(champ): check if the clip space box is within the view
+    if (min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f)
+    {
+        return false;
+    }
+    else
+    {
+        return true;
+    }
+}
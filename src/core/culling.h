@@ -0,0 +1,60 @@
+#pragma once
+
+#include "core/types.h"
+#include <vector>
+
+struct RenderObject;
+
+// NOTE(champ): the six planes of a view frustum, pointing inside, extracted
+// from a viewproj matrix with a [0, 1] depth range. A point p is inside a
+// plane when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+Frustum extract_frustum(const glm::mat4& viewproj);
+
+//> culling_bounds
+// NOTE(champ): world space bounds of a list of objects stored as a structure
+// of arrays, so the SIMD culling loads 4 or 8 objects per register. Every
+// array is padded to a multiple of CULLING_BATCH with empty bounds.
+constexpr u32 CULLING_BATCH = 8;
+
+struct CullingBounds {
+    void clear();
+    void reserve(u32 count);
+    // transforms the local bounds into world space: the box becomes the axis
+    // aligned box around the transformed one, the sphere radius is scaled by
+    // the largest axis scale
+    void push(const glm::vec3& origin, const glm::vec3& extents, float radius,
+              const glm::mat4& transform);
+    // pads the arrays, call it after the last push
+    void finish();
+    u32 size() const { return count; }
+
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+    std::vector<float> radius;
+
+    private:
+    u32 count = 0;
+};
+//< culling_bounds
+
+void build_culling_bounds(const std::vector<RenderObject>& objects, CullingBounds& bounds);
+
+// these append the indices of the visible objects to visible and return how
+// many were added. An object is culled when either its sphere or its box is
+// fully behind one of the planes
+u32 cull_frustum_scalar(const CullingBounds& bounds, const Frustum& frustum, std::vector<u32>& visible);
+// uses AVX when the build targets it, SSE otherwise and falls back to the
+// scalar version on other architectures
+u32 cull_frustum_simd(const CullingBounds& bounds, const Frustum& frustum, std::vector<u32>& visible);
+
+// NOTE(champ): projects the 8 corners of the object's box into clip space,
+// kept as the reference for the benchmark
+bool is_renderobj_visible(const RenderObject& obj, const glm::mat4& viewproj);
@@ -0,0 +1,130 @@
+#include "core/draw_sort.h"
+
+#include "core/engine.h"
+
+#include <algorithm>
+
+//> sort_keys
+template <typename Map>
+u32
+SortKeyIds::IdTable<Map>::acquire(const typename Map::key_type& key)
+{
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        it->second.users += 1;
+        return it->second.id;
+    }
+    u32 id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = nextId++;
+    }
+    entries.emplace(key, IdEntry{ id, 1 });
+    return id;
+}
+
+template <typename Map>
+void
+SortKeyIds::IdTable<Map>::release(const typename Map::key_type& key)
+{
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return;
+    }
+    it->second.users -= 1;
+    if (it->second.users == 0) {
+        // NOTE(champ): the pointer can come back as something else once its
+        // owner is freed, so the entry goes with its last user
+        freeIds.push_back(it->second.id);
+        entries.erase(it);
+    }
+}
+
+template <typename Map>
+void
+SortKeyIds::IdTable<Map>::clear()
+{
+    entries.clear();
+    freeIds.clear();
+    nextId = 0;
+}
+
+u64
+SortKeyIds::state_key(const RenderObject& obj)
+{
+    u64 pipeline = pipelines.acquire(obj.material->pipeline) & ((1u << SORT_PIPELINE_BITS) - 1);
+    u64 material = materials.acquire(obj.material) & ((1u << SORT_MATERIAL_BITS) - 1);
+    u64 mesh = meshes.acquire(std::make_pair(obj.indexBuffer, obj.firstIndex)) & ((1u << SORT_MESH_BITS) - 1);
+    return (pipeline << (SORT_MATERIAL_BITS + SORT_MESH_BITS)) | (material << SORT_MESH_BITS) | mesh;
+}
+
+void
+SortKeyIds::release(const RenderObject& obj)
+{
+    pipelines.release(obj.material->pipeline);
+    materials.release(obj.material);
+    meshes.release(std::make_pair(obj.indexBuffer, obj.firstIndex));
+}
+
+void
+SortKeyIds::clear()
+{
+    pipelines.clear();
+    materials.clear();
+    meshes.clear();
+}
+
+u32
+quantize_depth(float depth, float maxDepth)
+{
+    float t = std::clamp(depth / maxDepth, 0.0f, 1.0f);
+    return (u32)(t * (float)SORT_DEPTH_MAX);
+}
+//< sort_keys
+
+//> radix_sort
+void
+radix_sort(std::vector<DrawKey>& keys, std::vector<DrawKey>& scratch)
+{
+    const size_t count = keys.size();
+    if (count < 2) {
+        return;
+    }
+    scratch.resize(count);
+
+    // NOTE(champ): all 8 histograms in one pass over the keys
+    u32 histograms[8][256] = {};
+    for (const DrawKey& k : keys) {
+        for (u32 pass = 0; pass < 8; pass++) {
+            histograms[pass][(k.key >> (pass * 8)) & 0xFF] += 1;
+        }
+    }
+
+    DrawKey* src = keys.data();
+    DrawKey* dst = scratch.data();
+    for (u32 pass = 0; pass < 8; pass++) {
+        u32* histogram = histograms[pass];
+        const u32 shift = pass * 8;
+        if (histogram[(src[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        u32 offset = 0;
+        for (u32 bucket = 0; bucket < 256; bucket++) {
+            u32 bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != keys.data()) {
+        keys.swap(scratch);
+    }
+}
+//< radix_sort
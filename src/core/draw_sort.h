@@ -0,0 +1,83 @@
+#pragma once
+
+#include "core/types.h"
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct RenderObject;
+
+//> sort_keys
+// NOTE(champ): draws are ordered by a single 64 bit key so sorting never
+// touches the objects. The ids are handed out in the order things are first
+// seen instead of comparing pointers, which makes the order the same from
+// one run to the next. Fields from the most significant bit:
+//   opaque:      pipeline | material | mesh | depth, front to back
+//   transparent: inverted depth | pipeline | material | mesh, back to front
+constexpr u32 SORT_PIPELINE_BITS = 6;
+constexpr u32 SORT_MATERIAL_BITS = 16;
+constexpr u32 SORT_MESH_BITS = 18;
+constexpr u32 SORT_STATE_BITS = SORT_PIPELINE_BITS + SORT_MATERIAL_BITS + SORT_MESH_BITS;
+constexpr u32 SORT_DEPTH_BITS = 64 - SORT_STATE_BITS;
+constexpr u32 SORT_DEPTH_MAX = (1u << SORT_DEPTH_BITS) - 1;
+
+// hands out the pipeline, material and mesh ids packed in the state part of
+// the keys. Every state_key adds a user to the ids of obj and release drops
+// it, ids nothing uses anymore are handed out again so unloading and loading
+// scenes does not run through them. Ids only wrap around past the width of
+// their field when that many are in use at once, which only costs some
+// batching.
+struct SortKeyIds {
+    // the pipeline | material | mesh bits of obj, SORT_STATE_BITS wide
+    u64 state_key(const RenderObject& obj);
+    // obj has to be the same as it was given to state_key
+    void release(const RenderObject& obj);
+    void clear();
+
+    private:
+    struct IdEntry {
+        u32 id;
+        u32 users;
+    };
+    template <typename Map>
+    struct IdTable {
+        Map entries;
+        std::vector<u32> freeIds;
+        u32 nextId = 0;
+
+        u32 acquire(const typename Map::key_type& key);
+        void release(const typename Map::key_type& key);
+        void clear();
+    };
+
+    IdTable<std::unordered_map<const MaterialPipeline*, IdEntry>> pipelines;
+    IdTable<std::unordered_map<const MaterialInstance*, IdEntry>> materials;
+    IdTable<std::map<std::pair<VkBuffer, u32>, IdEntry>> meshes;
+};
+
+// maps a view space depth in [0, maxDepth] to SORT_DEPTH_BITS, anything
+// further away is clamped to maxDepth
+u32 quantize_depth(float depth, float maxDepth);
+
+inline u64 opaque_sort_key(u64 stateKey, u32 depth)
+{
+    return (stateKey << SORT_DEPTH_BITS) | depth;
+}
+
+inline u64 transparent_sort_key(u64 stateKey, u32 depth)
+{
+    return ((u64)(SORT_DEPTH_MAX - depth) << SORT_STATE_BITS) | stateKey;
+}
+//< sort_keys
+
+//> radix_sort
+struct DrawKey {
+    u64 key;
+    u32 handle;
+};
+
+// LSD radix sort on the whole key, 8 bits per pass. Passes where every key
+// has the same byte are skipped. Stable, scratch is resized as needed.
+void radix_sort(std::vector<DrawKey>& keys, std::vector<DrawKey>& scratch);
+//< radix_sort
@@ -1,4 +1,6 @@
 #include "engine.h"
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 
 #include "SDL3/SDL.h"
@@ -15,6 +17,7 @@
 #include "imgui_impl_sdl3.h"
 #include "imgui_impl_vulkan.h"
 
+#include "core/vertex_format.h"
 #include "core/vk_images.h"
 #include "core/vk_initializers.h"
 #include "vk_pipelines.h"
@@ -26,40 +29,67 @@ VulkanEngine& VulkanEngine::Get() { return *loadedEngine; }
 void
 VulkanEngine::init(int w, int h,
                    const char *title,
-                   bool useValidationLayers)
+                   bool useValidationLayers,
+                   bool headless)
 {
     // only one engine initialization per application
     assert(loadedEngine == nullptr);
     loadedEngine = this;
     
     _useValidationLayers = useValidationLayers;
+    _headless = headless;
     
-    const bool ok = SDL_Init(SDL_INIT_VIDEO);
-    if (!ok) {
-        spdlog::error("Failed to initialized SDL!");
-        abort();
+    // NOTE(champ): headless runs (CI, batch farms) have no display at all,
+    // so we skip SDL video and the window entirely and render offscreen
+    if (!_headless)
+    {
+        const bool ok = SDL_Init(SDL_INIT_VIDEO);
+        if (!ok) {
+            spdlog::error("Failed to initialized SDL!");
+            abort();
+        }
+        SDL_WindowFlags flags =
+        (SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+        _window = SDL_CreateWindow(title, w, h, flags);
+        if (_window == nullptr) {
+            spdlog::error("Failed to create SDL window!");
+            abort();
+        }
+        spdlog::info("Window created successfully.");
+        bool res = SDL_HideCursor();
+        assert(res);
     }
-    SDL_WindowFlags flags =
-    (SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
-    _window = SDL_CreateWindow(title, w, h, flags);
-    if (_window == nullptr) {
-        spdlog::error("Failed to create SDL window!");
-        abort();
+    else
+    {
+        spdlog::info("Running headless, no window will be created.");
     }
-    spdlog::info("Window created successfully.");
-    bool res = SDL_HideCursor();
-    assert(res);
     
     _windowExtent.width = w;
     _windowExtent.height = h;
     
+    // NOTE(champ): leave one core for the main thread, which also helps out
+    // while waiting on parallel work
+    u32 coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+    _jobSystem.init(coreCount - 1);
+    
     init_vulkan();
     init_swapchain();
     init_commands();
     init_sync_structures();
+    start_latency_thread();
+    _uploader.init(this, _graphicsQueue, _graphicsQueueFamily,
+                   _transferQueue, _transferQueueFamily, UPLOAD_STAGING_SIZE);
+    _mainDeletionQueue.push_function([&]() { _uploader.destroy(); });
+    _geometryArena.init(this, _arenaVertexCount, _arenaIndexCount, vertex_size());
+    _mainDeletionQueue.push_function([&]() { _geometryArena.destroy(); });
+    _textureCache.init(this);
+    _mainDeletionQueue.push_function([&]() { _textureCache.destroy(); });
     init_descriptors();
     init_pipelines();
-    init_imgui();
+    if (!_headless)
+    {
+        init_imgui();
+    }
     init_default_data();
     
     // NOTE(champ): Load all paths for .glb/.gltf files available
@@ -87,11 +117,20 @@ void VulkanEngine::run() {
     SDL_Event e;
     bool quit = false;
     
+    start_render_thread();
+    
     while (!quit) {
-        SDL_Time start_ticks;
-        SDL_GetCurrentTime(&start_ticks);
+        // NOTE(champ): SDL_GetTicksNS is monotonic, unlike the wall clock
+        u64 start_ticks = SDL_GetTicksNS();
+        // events wait in the queue until polled, the oldest one is where the
+        // latency of this frame starts
+        u64 input_ticks = start_ticks;
         // handle events on queue
         while (SDL_PollEvent(&e) != 0) {
+            if (e.common.timestamp != 0) {
+                input_ticks = std::min(input_ticks, (u64)e.common.timestamp);
+            }
+            
             if (e.type == SDL_EVENT_QUIT) {
                 quit = true;
             }
@@ -104,6 +143,15 @@ void VulkanEngine::run() {
                 if (e.key.key == SDLK_ESCAPE) {
                     quit = true;
                 }
+                if (e.key.key == SDLK_F5 && !e.key.repeat) {
+                    _recordingCameraPath = !_recordingCameraPath;
+                    if (_recordingCameraPath) {
+                        spdlog::info("Recording camera path...");
+                        _recordedCameraPath.keyframes.clear();
+                    } else {
+                        benchmark::save_camera_path(_recordedCameraPath, "camera_path.txt");
+                    }
+                }
             }
             
             camera::processSDLEvent(&this->mainCamera, e);
@@ -124,14 +172,18 @@ void VulkanEngine::run() {
             
             ImGui_ImplSDL3_ProcessEvent(&e);
         }
-        if (_resizeRequested) {
-            resize_swapchain();
-        }
+        // frame boundary, background loads that are done can join the scene
+        finish_scene_loads();
         
         if (_stopRendering) {
             continue;
         }
         
+        // NOTE(champ): blocks while the render thread still draws the packet
+        // filled two frames ago, the main thread is at most one frame ahead
+        FramePacket& packet = begin_frame_packet();
+        EngineStats shownStats = published_stats();
+        
         // imgui new frame
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplSDL3_NewFrame();
@@ -139,6 +191,23 @@ void VulkanEngine::run() {
         
         if (ImGui::Begin("Debug Window")) {
             ImGui::SliderFloat("Render scale", &_renderScale, 0.3f, 1.0f);
+            if (_gpuDrivenSupported) {
+                ImGui::Checkbox("GPU driven rendering", &_gpuDrivenRendering);
+            }
+            ImGui::Checkbox("CPU frustum culling", &_cpuFrustumCulling);
+            ImGui::Checkbox("BVH scene culling", &_bvhCulling);
+            ImGui::Checkbox("Parallel command recording", &_parallelRecording);
+            ImGui::SliderInt("Frames in flight", &_framesInFlightSetting, 1, MAX_FRAMES_IN_FLIGHT);
+            if (ImGui::BeginCombo("Present mode", present_mode_name(_presentModeSetting)))
+            {
+                for (VkPresentModeKHR mode : PRESENT_MODES)
+                {
+                    if (ImGui::Selectable(present_mode_name(mode), mode == _presentModeSetting))
+                        _presentModeSetting = mode;
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::SliderInt("Swapchain images", &_swapchainImageCountSetting, 0, 8);
             
             ComputeEffect &selected = backgroundEffects[currentBackgroundEffect];
             
@@ -182,17 +251,88 @@ void VulkanEngine::run() {
                         }
                         ImGui::EndCombo();
                     }
+                    
+                    if (ImGui::Button("Load model"))
+                    {
+                        const std::string& path = gltfFilesPath[item_selected_idx];
+                        load_scene_async(path, path);
+                    }
+                    
+                    for (const auto& load : _pendingSceneLoads)
+                    {
+                        ImGui::ProgressBar(load->progress.fraction(), ImVec2(-FLT_MIN, 0), load->name.c_str());
+                    }
+                }
+            }
+            
+            // NOTE(champ): moving a root node only dirties its subtree, the
+            // next update_scene moves its surfaces and refits the BVH
+            if (!loadedScenes.empty() && ImGui::CollapsingHeader("Scene nodes"))
+            {
+                for (const auto& pair: loadedScenes)
+                {
+                    gltf::LoadedScene* scene = pair.second.get();
+                    if (scene == nullptr || !ImGui::TreeNode(pair.first.c_str()))
+                    {
+                        continue;
+                    }
+                    for (u32 i = 0; i < scene->top_nodes.size(); i++)
+                    {
+                        Node* node = scene->top_nodes[i].get();
+                        glm::mat4 transform = node->localTransform;
+                        glm::vec3 translation = glm::vec3(transform[3]);
+                        ImGui::PushID((int)i);
+                        if (ImGui::DragFloat3("Translation", &translation.x, 0.05f))
+                        {
+                            transform[3] = glm::vec4(translation, 1.0f);
+                            node->set_local_transform(transform);
+                        }
+                        ImGui::PopID();
+                    }
+                    ImGui::TreePop();
                 }
             }
         }
         ImGui::End();
         
         ImGui::Begin("Stats");
-        ImGui::Text("frametime:   %f ms", stats.frame_time);
-        ImGui::Text("draw time:   %f ms", stats.mesh_draw_time);
-        ImGui::Text("update time: %f ms", stats.scene_update_time);
-        ImGui::Text("triangles:   %i", stats.triangle_count);
-        ImGui::Text("draws:       %i", stats.drawcall_count);
+        ImGui::Text("frametime:   %f ms", shownStats.frame_time);
+        ImGui::Text("draw time:   %f ms", shownStats.mesh_draw_time);
+        ImGui::Text("cull time:   %f ms", shownStats.culling_time);
+        ImGui::Text("sort time:   %f ms", shownStats.sort_time);
+        ImGui::Text("record time: %f ms, %i chunks", shownStats.record_time, shownStats.record_chunks);
+        ImGui::Text("bvh nodes:   %i visited", shownStats.bvh_visited_nodes);
+        ImGui::Text("transforms:  %i changed", shownStats.changed_nodes);
+        ImGui::Text("update time: %f ms", shownStats.scene_update_time);
+        ImGui::Text("triangles:   %i", shownStats.triangle_count);
+        ImGui::Text("draws:       %i", shownStats.drawcall_count);
+        if (_gpuDrivenRendering)
+        {
+            ImGui::Text("gpu culling: %i / %i visible", shownStats.gpu_visible_objects, shownStats.gpu_culled_input);
+        }
+        ImGui::Text("uploads:     %u submits, %.1f MB", _uploader.submitCount.load(),
+                    (double)_uploader.uploadedBytes.load() / (1024.0 * 1024.0));
+        ImGui::Text("binds:       %i pipeline, %i material, %i index",
+                    shownStats.pipeline_binds, shownStats.material_binds, shownStats.index_buffer_binds);
+        ImGui::Text("geometry:    %u meshes, %u dedicated", _geometryArena.allocationCount.load(),
+                    _dedicatedMeshBuffers.load());
+        ImGui::Text("textures:    %u shared, %u references", _textureCache.imageCount.load(),
+                    _textureCache.referenceCount.load());
+        ImGui::Text("vertices:    %u / %u, %u bytes each", _geometryArena.usedVertices.load(), _geometryArena.maxVertices,
+                    (u32)vertex_size());
+        ImGui::Text("indices:     %u / %u", _geometryArena.usedIndices.load(), _geometryArena.maxIndices);
+        ImGui::Separator();
+        ImGui::Text("gpu frame:      %f ms", shownStats.gpu_frame_time);
+        ImGui::Text("gpu background: %f ms", shownStats.gpu_background_time);
+        ImGui::Text("gpu geometry:   %f ms", shownStats.gpu_geometry_time);
+        ImGui::Text("gpu blit:       %f ms", shownStats.gpu_blit_time);
+        ImGui::Text("gpu imgui:      %f ms", shownStats.gpu_imgui_time);
+        ImGui::Separator();
+        ImGui::Text("frames in flight:   %i", shownStats.frames_in_flight);
+        ImGui::Text("swapchain:          %s, %i images", present_mode_name((VkPresentModeKHR)shownStats.present_mode),
+                    shownStats.swapchain_image_count);
+        ImGui::Text("input to submit:    %f ms", shownStats.input_to_submit);
+        ImGui::Text("submit to gpu done: %f ms", shownStats.submit_to_gpu_done);
         ImGui::End();
         
         // some imgui UI to test
@@ -201,25 +341,242 @@ void VulkanEngine::run() {
         // make imgui calculate internal draw structures
         ImGui::Render();
         
-        draw();
+        packet.windowExtent = window_extent();
+        packet.inputTicks = input_ticks;
+        packet.frameTime = _mainFrameTime;
+        update_scene(packet);
+        packet.imgui.capture(ImGui::GetDrawData());
+        submit_frame_packet();
         
-        SDL_Time end_ticks;
-        SDL_GetCurrentTime(&end_ticks);
+        if (_recordingCameraPath) {
+            CameraKeyframe keyframe = {};
+            keyframe.position = mainCamera.position;
+            keyframe.pitch = mainCamera.pitch;
+            keyframe.yaw = mainCamera.yaw;
+            _recordedCameraPath.keyframes.push_back(keyframe);
+        }
+        
+        u64 end_ticks = SDL_GetTicksNS();
         
         // Convert to miliseconds
-        SDL_Time diff = (float)(end_ticks - start_ticks);
-        stats.frame_time = diff / 1000000.0f;
+        _mainFrameTime = (float)(end_ticks - start_ticks) / 1000000.0f;
+    }
+    
+    stop_render_thread();
+}
+
+void VulkanEngine::run_headless(u32 frameCount) {
+    assert(_headless);
+    
+    for (u32 i = 0; i < frameCount; i++) {
+        u64 start_ticks = SDL_GetTicksNS();
+        
+        draw();
+        
+        u64 end_ticks = SDL_GetTicksNS();
+        stats.frame_time = (float)(end_ticks - start_ticks) / 1000000.0f;
+    }
+    
+    // make sure the last frame is done before anyone reads it back
+    vkDeviceWaitIdle(_device);
+    spdlog::info("Rendered {} headless frames.", frameCount);
+}
+
+//> render_thread
+void VulkanEngine::start_render_thread() {
+    _fillingPacket = 0;
+    _readyPacket = INVALID_PACKET;
+    _renderingPacket = INVALID_PACKET;
+    _stopRenderThread = false;
+    _renderThread = std::thread([this]() { render_thread_loop(); });
+}
+
+void VulkanEngine::stop_render_thread() {
+    {
+        std::lock_guard<std::mutex> lock(_packetMutex);
+        _stopRenderThread = true;
+    }
+    _packetCondition.notify_all();
+    if (_renderThread.joinable()) {
+        _renderThread.join();
+    }
+}
+
+void VulkanEngine::render_thread_loop() {
+    while (true) {
+        FramePacket* packet = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(_packetMutex);
+            _packetCondition.wait(lock, [this]() {
+                return _stopRenderThread || _readyPacket != INVALID_PACKET;
+            });
+            // a packet handed over before stopping is still drawn
+            if (_readyPacket == INVALID_PACKET) {
+                return;
+            }
+            _renderingPacket = _readyPacket;
+            _readyPacket = INVALID_PACKET;
+            packet = &_framePackets[_renderingPacket];
+        }
+        _packetCondition.notify_all();
+        
+        render_frame(*packet);
+        
+        {
+            std::lock_guard<std::mutex> lock(_packetMutex);
+            _renderingPacket = INVALID_PACKET;
+        }
+        _packetCondition.notify_all();
+    }
+}
+
+FramePacket& VulkanEngine::begin_frame_packet() {
+    std::unique_lock<std::mutex> lock(_packetMutex);
+    _packetCondition.wait(lock, [this]() {
+        return _readyPacket != _fillingPacket && _renderingPacket != _fillingPacket;
+    });
+    return _framePackets[_fillingPacket];
+}
+
+void VulkanEngine::submit_frame_packet() {
+    {
+        std::unique_lock<std::mutex> lock(_packetMutex);
+        // the render thread picks up one packet at a time
+        _packetCondition.wait(lock, [this]() { return _readyPacket == INVALID_PACKET; });
+        _readyPacket = _fillingPacket;
+        _fillingPacket = (_fillingPacket + 1) % FRAME_PACKET_COUNT;
+    }
+    _packetCondition.notify_all();
+}
+
+void VulkanEngine::publish_stats() {
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    _publishedStats = stats;
+}
+
+EngineStats VulkanEngine::published_stats() {
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    return _publishedStats;
+}
+
+VkExtent2D VulkanEngine::window_extent() {
+    if (!_window) {
+        return _windowExtent;
+    }
+    int width, height;
+    SDL_GetWindowSize(_window, &width, &height);
+    return { (u32)std::max(width, 0), (u32)std::max(height, 0) };
+}
+//< render_thread
+
+//> frame_pacing
+void VulkanEngine::wait_frame_timeline(u64 value) {
+    if (value == 0) {
+        return;
+    }
+    
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.pNext = nullptr;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &_frameTimeline;
+    waitInfo.pValues = &value;
+    VK_CHECK(vkWaitSemaphores(_device, &waitInfo, UINT64_MAX));
+}
+
+void VulkanEngine::set_frames_in_flight(u32 count) {
+    count = std::clamp(count, 1u, MAX_FRAMES_IN_FLIGHT);
+    if (count == _framesInFlight) {
+        return;
+    }
+    
+    // NOTE(champ): frames and scene data slices are picked with
+    // _frameNumber % _framesInFlight, they can only be remapped once none of
+    // them is in flight anymore
+    wait_frame_timeline(_frameTimelineValue);
+    for (auto &frame : _frames) {
+        frame._deletionQueue.flush();
     }
+    _framesInFlight = count;
 }
 
+void VulkanEngine::track_submit_latency(const FramePacket& packet, u64 timelineValue) {
+    u64 submitTicks = SDL_GetTicksNS();
+    stats.input_to_submit = (float)(submitTicks - std::min(packet.inputTicks, submitTicks)) / 1000000.0f;
+    {
+        std::lock_guard<std::mutex> lock(_latencyMutex);
+        _pendingSubmits.push_back({ timelineValue, submitTicks });
+    }
+    _latencyCondition.notify_one();
+}
+
+void VulkanEngine::start_latency_thread() {
+    _stopLatencyThread = false;
+    _latencyThread = std::thread([this]() { latency_thread_loop(); });
+}
+
+void VulkanEngine::stop_latency_thread() {
+    {
+        std::lock_guard<std::mutex> lock(_latencyMutex);
+        _stopLatencyThread = true;
+    }
+    _latencyCondition.notify_all();
+    if (_latencyThread.joinable()) {
+        _latencyThread.join();
+    }
+}
+
+void VulkanEngine::latency_thread_loop() {
+    while (true) {
+        std::pair<u64, u64> submitted;
+        {
+            std::unique_lock<std::mutex> lock(_latencyMutex);
+            _latencyCondition.wait(lock, [this]() {
+                return _stopLatencyThread || !_pendingSubmits.empty();
+            });
+            // frames submitted before stopping are still waited on, the
+            // device is idle by then so this does not block
+            if (_pendingSubmits.empty()) {
+                return;
+            }
+            submitted = _pendingSubmits.front();
+            _pendingSubmits.pop_front();
+        }
+        
+        wait_frame_timeline(submitted.first);
+        u64 doneTicks = SDL_GetTicksNS();
+        
+        std::lock_guard<std::mutex> lock(_latencyMutex);
+        _submitToGpuDone = (float)(doneTicks - submitted.second) / 1000000.0f;
+    }
+}
+//< frame_pacing
+
 void VulkanEngine::init_vulkan() {
     vkb::InstanceBuilder builder;
     
+    // NOTE(champ): present fences need VK_EXT_swapchain_maintenance1 on the
+    // device, which depends on these two instance extensions
+    bool surfaceMaintenance = false;
+    if (!_headless)
+    {
+        auto systemInfo = vkb::SystemInfo::get_system_info();
+        surfaceMaintenance = systemInfo
+            && systemInfo.value().is_extension_available(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME)
+            && systemInfo.value().is_extension_available(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+        if (surfaceMaintenance)
+        {
+            builder.enable_extension(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME)
+                .enable_extension(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+        }
+    }
+    
     auto instance_result = builder.set_app_name("Vulkan Engine App")
         .request_validation_layers()
         .request_validation_layers(_useValidationLayers)
         .use_default_debug_messenger()
         .require_api_version(1, 3, 0)
+        .set_headless(_headless)
         .build();
     if (!instance_result) {
         spdlog::error("Failed to create VkInstance!");
@@ -229,7 +586,10 @@ void VulkanEngine::init_vulkan() {
     _instance = vkb_instance.instance;
     _debugMessenger = vkb_instance.debug_messenger;
     
-    SDL_Vulkan_CreateSurface(_window, _instance, nullptr, &_surface);
+    if (!_headless)
+    {
+        SDL_Vulkan_CreateSurface(_window, _instance, nullptr, &_surface);
+    }
     
     // Vulkan 1.3 features
     VkPhysicalDeviceVulkan13Features features13{};
@@ -242,17 +602,83 @@ void VulkanEngine::init_vulkan() {
     features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     features12.bufferDeviceAddress = true;
     features12.descriptorIndexing = true;
+    features12.timelineSemaphore = true;
     
     // Use vkbootstrap to select a GPU
-    vkb::PhysicalDeviceSelector selector(vkb_instance);
-    vkb::PhysicalDevice physicalDevice = selector.set_minimum_version(1, 3)
-        .set_required_features_13(features13)
-        .set_required_features_12(features12)
-        .set_surface(_surface)
-        .select()
-        .value();
+    // NOTE(champ): a headless instance does not require present support, so
+    // software ICDs without any surface extensions can still be selected
+    auto select_device = [&](const VkPhysicalDeviceVulkan12Features& required12) {
+        vkb::PhysicalDeviceSelector selector(vkb_instance);
+        selector.set_minimum_version(1, 3)
+            .set_required_features_13(features13)
+            .set_required_features_12(required12);
+        if (!_headless)
+        {
+            selector.set_surface(_surface);
+        }
+        return selector.select().value();
+    };
+    vkb::PhysicalDevice physicalDevice = select_device(features12);
+    
+    // NOTE(champ): the GPU driven path draws many commands per indirect call,
+    // reads the draw count from the cull output and uses firstInstance to
+    // find the object in the vertex shader. Without all three it stays off
+    // and every surface goes through the CPU path
+    VkPhysicalDeviceVulkan12Features supported12{};
+    supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supported{};
+    supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported.pNext = &supported12;
+    vkGetPhysicalDeviceFeatures2(physicalDevice.physical_device, &supported);
+    if (supported12.drawIndirectCount)
+    {
+        // the 1.2 features are handed to the selector, so pick the device
+        // again with the count draws in them, the same device still matches
+        features12.drawIndirectCount = true;
+        physicalDevice = select_device(features12);
+    }
+    
+    VkPhysicalDeviceFeatures indirectFeatures{};
+    indirectFeatures.multiDrawIndirect = true;
+    indirectFeatures.drawIndirectFirstInstance = true;
+    bool indirectSupported = physicalDevice.enable_features_if_present(indirectFeatures);
+    _gpuDrivenSupported = indirectSupported && supported12.drawIndirectCount;
+    if (!_gpuDrivenSupported)
+    {
+        _gpuDrivenRendering = false;
+        spdlog::warn("Indirect draw features are not supported, GPU driven rendering is disabled.");
+    }
+    
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenance{};
+    swapchainMaintenance.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+    if (surfaceMaintenance
+        && physicalDevice.enable_extension_if_present(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceFeatures2 query{};
+        query.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        query.pNext = &swapchainMaintenance;
+        vkGetPhysicalDeviceFeatures2(physicalDevice.physical_device, &query);
+        swapchainMaintenance.pNext = nullptr;
+        _presentFencesSupported = swapchainMaintenance.swapchainMaintenance1;
+    }
+    if (!_headless && !_presentFencesSupported)
+    {
+        spdlog::warn("Present fences are not supported, retired swapchains are destroyed by frame timeline value.");
+    }
+    
+    VkPhysicalDeviceFeatures optionalFeatures{};
+    optionalFeatures.textureCompressionBC = true;
+    _textureCompressionBC = physicalDevice.enable_features_if_present(optionalFeatures);
+    if (!_textureCompressionBC)
+    {
+        spdlog::warn("BC texture compression is not supported, compressed textures are ignored.");
+    }
     
     vkb::DeviceBuilder deviceBuilder(physicalDevice);
+    if (_presentFencesSupported)
+    {
+        deviceBuilder.add_pNext(&swapchainMaintenance);
+    }
     vkb::Device vkbDevice = deviceBuilder.build().value();
     _device = vkbDevice.device;
     _physicalDevice = vkbDevice.physical_device;
@@ -261,6 +687,47 @@ void VulkanEngine::init_vulkan() {
     _graphicsQueueFamily =
         vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
     
+    // NOTE(champ): uploads prefer a transfer only queue family (the copy engine
+    // on most discrete GPUs), then any other family that is not the graphics
+    // one, and fall back to the graphics queue if there is none
+    _transferQueue = _graphicsQueue;
+    _transferQueueFamily = _graphicsQueueFamily;
+    if (_useTransferQueue)
+    {
+        auto dedicated = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+        if (dedicated.has_value())
+        {
+            _transferQueue = dedicated.value();
+            _transferQueueFamily = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+        }
+        else
+        {
+            auto separate = vkbDevice.get_queue(vkb::QueueType::transfer);
+            if (separate.has_value())
+            {
+                _transferQueue = separate.value();
+                _transferQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::transfer).value();
+            }
+        }
+    }
+    if (_transferQueueFamily != _graphicsQueueFamily)
+    {
+        spdlog::info("Uploading through transfer queue family {}.", _transferQueueFamily);
+    }
+    else
+    {
+        spdlog::info("No separate transfer queue, uploading through the graphics queue.");
+    }
+    
+    // NOTE(champ): timestamps are only usable if the graphics queue reports
+    // valid bits for them, otherwise the GPU timings stay at zero
+    _gpuProperties = physicalDevice.properties;
+    _timestampValidBits =
+        vkbDevice.queue_families[_graphicsQueueFamily].timestampValidBits;
+    if (_timestampValidBits == 0) {
+        spdlog::warn("Graphics queue does not support timestamps, GPU timings are disabled.");
+    }
+    
     // initialize the memory allocator
     VmaAllocatorCreateInfo allocatorInfo = {};
     allocatorInfo.physicalDevice = _physicalDevice;
@@ -272,18 +739,32 @@ void VulkanEngine::init_vulkan() {
     _mainDeletionQueue.push_function([&]() { vmaDestroyAllocator(_allocator); });
 }
 void VulkanEngine::init_swapchain() {
-    create_swapchain(_windowExtent.width, _windowExtent.height);
-    
-    // draw image size matches monitor size
     VkExtent3D drawImageExtent = {};
-    
-    SDL_Rect rect = {};
-    SDL_GetDisplayBounds(SDL_GetDisplayForWindow(_window), &rect);
-    
-    drawImageExtent.width = rect.w;
-    drawImageExtent.height = rect.h;
     drawImageExtent.depth = 1;
     
+    if (_headless)
+    {
+        // NOTE(champ): there is no display to match, the requested size is
+        // the final resolution of the rendered frames
+        _swapchainExtent = _windowExtent;
+        
+        drawImageExtent.width = _windowExtent.width;
+        drawImageExtent.height = _windowExtent.height;
+    }
+    else
+    {
+        _requestedPresentMode = _presentModeSetting;
+        _requestedImageCount = (u32)_swapchainImageCountSetting;
+        create_swapchain(_windowExtent.width, _windowExtent.height);
+        
+        // draw image size matches monitor size
+        SDL_Rect rect = {};
+        SDL_GetDisplayBounds(SDL_GetDisplayForWindow(_window), &rect);
+        
+        drawImageExtent.width = rect.w;
+        drawImageExtent.height = rect.h;
+    }
+    
     // hard coded 16 bit float image format
     _drawImage.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
     _drawImage.imageExtent = drawImageExtent;
@@ -337,6 +818,34 @@ void VulkanEngine::init_swapchain() {
                                          vkDestroyImageView(_device, _depthImage.imageView, nullptr);
                                          vmaDestroyImage(_allocator, _depthImage.image, _depthImage.allocation);
                                      });
+    
+    if (_headless)
+    {
+        init_headless_target();
+    }
+}
+
+void VulkanEngine::init_headless_target() {
+    // NOTE(champ): the draw image is blitted into an RGBA8 image of the output
+    // size, which is then copied into a host visible buffer per frame
+    VkExtent3D extent = {_windowExtent.width, _windowExtent.height, 1};
+    _readbackImage = create_image(extent, VK_FORMAT_R8G8B8A8_UNORM,
+                                  VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                  VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    
+    const size_t readbackSize = (size_t)extent.width * extent.height * 4;
+    for (FrameData& frame : _frames) {
+        frame._readbackBuffer = create_buffer(readbackSize,
+                                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                              VMA_MEMORY_USAGE_GPU_TO_CPU);
+    }
+    
+    _mainDeletionQueue.push_function([=]() {
+                                         destroy_image(_readbackImage);
+                                         for (FrameData& frame : _frames) {
+                                             destroy_buffer(frame._readbackBuffer);
+                                         }
+                                     });
 }
 void VulkanEngine::init_commands() {
     // create a command pool for commands submitted to the graphics queue.
@@ -344,7 +853,7 @@ void VulkanEngine::init_commands() {
     VkCommandPoolCreateInfo commandPoolInfo = vkinit::command_pool_create_info(
                                                                                _graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
     
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         
         VK_CHECK(vkCreateCommandPool(_device, &commandPoolInfo, nullptr,
                                      &_frames[i]._commandPool));
@@ -355,6 +864,25 @@ void VulkanEngine::init_commands() {
         
         VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo,
                                           &_frames[i]._mainCommandBuffer));
+        
+        // NOTE(champ): one pool per thread that can record in parallel, the
+        // job system workers and the main thread. A pool is reset as a whole
+        // by the job that records into it, so no per buffer reset is needed
+        const u32 recordSlots = _jobSystem.worker_count() + 1;
+        VkCommandPoolCreateInfo recordPoolInfo = vkinit::command_pool_create_info(
+                                                                                  _graphicsQueueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        _frames[i]._recordPools.resize(recordSlots);
+        _frames[i]._recordBuffers.resize(recordSlots);
+        for (u32 slot = 0; slot < recordSlots; slot++) {
+            VK_CHECK(vkCreateCommandPool(_device, &recordPoolInfo, nullptr,
+                                         &_frames[i]._recordPools[slot]));
+            
+            VkCommandBufferAllocateInfo secondaryAllocInfo =
+                vkinit::command_buffer_allocate_info(_frames[i]._recordPools[slot], 1);
+            secondaryAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            VK_CHECK(vkAllocateCommandBuffers(_device, &secondaryAllocInfo,
+                                              &_frames[i]._recordBuffers[slot]));
+        }
     }
     
     VK_CHECK(vkCreateCommandPool(_device, &commandPoolInfo, nullptr,
@@ -371,24 +899,39 @@ void VulkanEngine::init_commands() {
                                      [=]() { vkDestroyCommandPool(_device, _immCommandPool, nullptr); });
 }
 void VulkanEngine::init_sync_structures() {
-    // one fence to control when the GPU has finished rendering the frame
-    // two semaphores to synchronize rendering with swapchain
+    // one timeline semaphore to control when the GPU has finished rendering
+    // a frame, two binary semaphores to synchronize rendering with swapchain
     
     VkFenceCreateInfo fenceCI =
         vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
     VkSemaphoreCreateInfo semaphoreCI = vkinit::semaphore_create_info();
     
+    VkQueryPoolCreateInfo queryPoolCI = {};
+    queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCI.pNext = nullptr;
+    queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCI.queryCount = TIMESTAMP_COUNT;
+    
+    VkSemaphoreTypeCreateInfo timelineCI = {};
+    timelineCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineCI.pNext = nullptr;
+    timelineCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineCI.initialValue = 0;
+    
+    VkSemaphoreCreateInfo frameTimelineCI = vkinit::semaphore_create_info();
+    frameTimelineCI.pNext = &timelineCI;
+    VK_CHECK(vkCreateSemaphore(_device, &frameTimelineCI, nullptr, &_frameTimeline));
+    _frameTimelineValue = 0;
+    _mainDeletionQueue.push_function(
+                                     [=]() { vkDestroySemaphore(_device, _frameTimeline, nullptr); });
+    
     for (auto &frame : _frames) {
-        VK_CHECK(vkCreateFence(_device, &fenceCI, nullptr, &frame._renderFence));
+        frame._timelineValue = 0;
         VK_CHECK(vkCreateSemaphore(_device, &semaphoreCI, nullptr,
                                    &frame._swapchainSemaphore));
-    }
-    
-    _submitSemaphores.reserve(_swapchainImages.size());
-    for (int i = 0; i < _swapchainImages.size(); i++) {
-        VkSemaphore semaphore;
-        VK_CHECK(vkCreateSemaphore(_device, &semaphoreCI, nullptr, &semaphore));
-        _submitSemaphores.push_back(semaphore);
+        VK_CHECK(vkCreateQueryPool(_device, &queryPoolCI, nullptr,
+                                   &frame._timestampPool));
+        frame._timestampsWritten = false;
     }
     
     VK_CHECK(vkCreateFence(_device, &fenceCI, nullptr, &_immFence));
@@ -400,6 +943,7 @@ void VulkanEngine::init_descriptors() {
     std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
         {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
         {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
     };
     
@@ -410,16 +954,6 @@ void VulkanEngine::init_descriptors() {
         _drawImageDescriptorLayout =
             builder.build(_device, VK_SHADER_STAGE_COMPUTE_BIT);
     }
-    {
-		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		_singleImageDescriptorLayout = builder.build(_device, VK_SHADER_STAGE_FRAGMENT_BIT);
-	}
-	{
-		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-		_gpuSceneDataDescriptorLayout = builder.build(_device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-	}
     // allocate a descriptor set for our draw image
     _drawImageDescriptors =
         _globalDescriptorAllocator.allocate(_device, _drawImageDescriptorLayout);
@@ -440,7 +974,7 @@ void VulkanEngine::init_descriptors() {
     
     vkUpdateDescriptorSets(_device, 1, &drawImageWrite, 0, nullptr);
     
-    for (int i = 0; i < FRAME_OVERLAP; i++) {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         // create a descriptor pool
         std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> frame_sizes = {
             {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3},
@@ -457,8 +991,10 @@ void VulkanEngine::init_descriptors() {
     }
     
     {
+        // NOTE(champ): dynamic so every frame can point the same set at its
+        // own slice of the scene data buffer
         DescriptorLayoutBuilder builder;
-        builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+        builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
         _gpuSceneDataDescriptorLayout = builder.build(
                                                       _device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
     }
@@ -469,14 +1005,37 @@ void VulkanEngine::init_descriptors() {
                                                      _device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
     }
     
+    // @SECTION: persistent scene data, one slice per frame in flight
+    // The buffer stays mapped for the lifetime of the engine, so updating the
+    // scene data every frame is only a memcpy into the current frame's slice
+    const size_t minAlignment = _gpuProperties.limits.minUniformBufferOffsetAlignment;
+    _sceneDataStride = sizeof(GPUSceneData);
+    if (minAlignment > 0) {
+        _sceneDataStride = (_sceneDataStride + minAlignment - 1) & ~(minAlignment - 1);
+    }
+    _sceneDataBuffer = create_buffer(_sceneDataStride * MAX_FRAMES_IN_FLIGHT,
+                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                     VMA_MEMORY_USAGE_CPU_TO_GPU);
+    
+    _sceneDataDescriptors =
+        _globalDescriptorAllocator.allocate(_device, _gpuSceneDataDescriptorLayout);
+    {
+        DescriptorWriter writer;
+        writer.write_buffer(0, _sceneDataBuffer.buffer, sizeof(GPUSceneData), 0,
+                            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+        writer.update_set(_device, _sceneDataDescriptors);
+    }
     
     // make sure both the descriptor allocator and the new layout get cleaned up
     // properly
     _mainDeletionQueue.push_function([&]() {
+                                         destroy_buffer(_sceneDataBuffer);
                                          _globalDescriptorAllocator.destroy_pools(_device);
                                          vkDestroyDescriptorSetLayout(_device, _drawImageDescriptorLayout, nullptr);
                                          vkDestroyDescriptorSetLayout(_device, _gpuSceneDataDescriptorLayout,
                                                                       nullptr);
+                                         vkDestroyDescriptorSetLayout(_device, _singleImageDescriptorLayout,
+                                                                      nullptr);
                                      });
 }
 
@@ -487,6 +1046,8 @@ void VulkanEngine::init_pipelines() {
     // Graphics pipelines
     init_mesh_pipeline();
     metalRoughMat.build_pipelines(this);
+    
+    init_cull_pipeline();
 }
 
 void VulkanEngine::init_background_pipeline() {
@@ -638,6 +1199,52 @@ void VulkanEngine::init_mesh_pipeline() {
                                      });
 }
 
+void VulkanEngine::init_cull_pipeline() {
+    // everything goes through buffer device addresses, no descriptor sets
+    VkPushConstantRange pushConstant = {};
+    pushConstant.offset = 0;
+    pushConstant.size = sizeof(GPUCullPushConstants);
+    pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    
+    VkPipelineLayoutCreateInfo computeLayout = vkinit::pipeline_layout_create_info();
+    computeLayout.pPushConstantRanges = &pushConstant;
+    computeLayout.pushConstantRangeCount = 1;
+    
+    VK_CHECK(vkCreatePipelineLayout(_device, &computeLayout, nullptr,
+                                    &_cullPipelineLayout));
+    
+    VkShaderModule cullShader;
+    if (!vkutil::load_shader_module("shaders/cull_objects.comp.spv", _device,
+                                    &cullShader)) {
+        spdlog::error("Failed to build the culling compute shader module!");
+    }
+    
+    VkPipelineShaderStageCreateInfo stageinfo{};
+    stageinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stageinfo.pNext = nullptr;
+    stageinfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stageinfo.module = cullShader;
+    stageinfo.pName = "main";
+    
+    VkComputePipelineCreateInfo computePipelineCreateInfo{};
+    computePipelineCreateInfo.sType =
+        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computePipelineCreateInfo.pNext = nullptr;
+    computePipelineCreateInfo.layout = _cullPipelineLayout;
+    computePipelineCreateInfo.stage = stageinfo;
+    
+    VK_CHECK(vkCreateComputePipelines(_device, VK_NULL_HANDLE, 1,
+                                      &computePipelineCreateInfo, nullptr,
+                                      &_cullPipeline));
+    
+    vkDestroyShaderModule(_device, cullShader, nullptr);
+    
+    _mainDeletionQueue.push_function([=]() {
+                                         vkDestroyPipelineLayout(_device, _cullPipelineLayout, nullptr);
+                                         vkDestroyPipeline(_device, _cullPipeline, nullptr);
+                                     });
+}
+
 void VulkanEngine::init_imgui() {
     
     // 1: create descriptor pool for IMGUI
@@ -682,7 +1289,9 @@ void VulkanEngine::init_imgui() {
     init_info.Queue = _graphicsQueue;
     init_info.DescriptorPool = imguiPool;
     init_info.MinImageCount = 3;
-    init_info.ImageCount = 3;
+    // NOTE(champ): not the swapchain image count, the backend cycles through
+    // this many vertex buffers so it has to cover every frame in flight
+    init_info.ImageCount = MAX_FRAMES_IN_FLIGHT;
     init_info.UseDynamicRendering = true;
     
     // dynamic rendering parameters for imgui to use
@@ -741,6 +1350,15 @@ void VulkanEngine::init_default_data() {
     samplerCI.minFilter = VK_FILTER_LINEAR;
     vkCreateSampler(_device, &samplerCI, nullptr, &_defaultSamplerlinear);
     
+    // the image set of the test mesh pipeline never changes, write it once
+    _defaultImageDescriptors =
+        _globalDescriptorAllocator.allocate(_device, _singleImageDescriptorLayout);
+    {
+        DescriptorWriter writer;
+        writer.write_image(0, _errorCheckboardImage.imageView, _defaulSamplerNearest, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        writer.update_set(_device, _defaultImageDescriptors);
+    }
+    
     // initialize GLTFMaterial data
     GLTFMetallic_Roughness::MaterialResources matResources;
     matResources.colorImage = _whiteImage;
@@ -792,38 +1410,112 @@ void VulkanEngine::init_default_data() {
                                      });
 }
 
-void VulkanEngine::create_swapchain(u32 w, u32 h) {
+//> present_mode
+const char* present_mode_name(VkPresentModeKHR mode) {
+    switch (mode) {
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        default: return "unknown";
+    }
+}
+
+bool parse_present_mode(const char* name, VkPresentModeKHR* mode) {
+    for (VkPresentModeKHR candidate : PRESENT_MODES) {
+        if (strcmp(name, present_mode_name(candidate)) == 0) {
+            *mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// NOTE(champ): falls back to the closest mode that keeps the intent, tearing
+// and non tearing uncapped modes stand in for each other, FIFO is always there
+static VkPresentModeKHR
+choose_present_mode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkPresentModeKHR requested)
+{
+    u32 count = 0;
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &count, nullptr));
+    std::vector<VkPresentModeKHR> available(count);
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &count, available.data()));
+    
+    VkPresentModeKHR fallbacks[3] = { requested, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR };
+    if (requested == VK_PRESENT_MODE_MAILBOX_KHR) {
+        fallbacks[1] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    } else if (requested == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+        fallbacks[1] = VK_PRESENT_MODE_MAILBOX_KHR;
+    }
+    
+    for (VkPresentModeKHR mode : fallbacks) {
+        if (std::find(available.begin(), available.end(), mode) != available.end()) {
+            if (mode != requested) {
+                spdlog::warn("Present mode {} is not supported, using {} instead",
+                             present_mode_name(requested), present_mode_name(mode));
+            }
+            return mode;
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+//< present_mode
+
+void VulkanEngine::create_swapchain(u32 w, u32 h, VkSwapchainKHR oldSwapchain) {
     vkb::SwapchainBuilder swapchainBuilder{_physicalDevice, _device, _surface};
     _swapchainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    _presentMode = choose_present_mode(_physicalDevice, _surface, _requestedPresentMode);
     
     VkSurfaceFormatKHR surfaceFormat{};
     surfaceFormat.format = _swapchainImageFormat;
     surfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
-    vkb::Swapchain vkbSwapchain =
-        swapchainBuilder.set_desired_format(surfaceFormat)
-        .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+    swapchainBuilder.set_desired_format(surfaceFormat)
+        .set_desired_present_mode(_presentMode)
         .set_desired_extent(w, h)
-        .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
-        .build()
-        .value();
+        .set_old_swapchain(oldSwapchain)
+        .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    // NOTE(champ): vkb clamps the count to what the surface allows
+    if (_requestedImageCount > 0) {
+        swapchainBuilder.set_desired_min_image_count(_requestedImageCount);
+    }
+    vkb::Swapchain vkbSwapchain = swapchainBuilder.build().value();
     
     _swapchainExtent = vkbSwapchain.extent;
     _swapchain = vkbSwapchain.swapchain;
     _swapchainImages = vkbSwapchain.get_images().value();
     _swapchainImageViews = vkbSwapchain.get_image_views().value();
+    
+    // one semaphore per image, present waits on the one of the image it shows
+    VkSemaphoreCreateInfo semaphoreCI = vkinit::semaphore_create_info();
+    _submitSemaphores.resize(_swapchainImages.size());
+    for (auto &semaphore : _submitSemaphores) {
+        VK_CHECK(vkCreateSemaphore(_device, &semaphoreCI, nullptr, &semaphore));
+    }
+    
+    spdlog::info("Swapchain created: {}x{}, {} images, {} present mode",
+                 _swapchainExtent.width, _swapchainExtent.height,
+                 _swapchainImages.size(), present_mode_name(_presentMode));
 }
 
-void VulkanEngine::resize_swapchain() {
-    vkDeviceWaitIdle(_device);
-    
-    destroy_swapchain();
-    
-    int width, height;
-    SDL_GetWindowSize(_window, &width, &height);
-    _windowExtent.width = width;
-    _windowExtent.height = height;
-    
-    create_swapchain(_windowExtent.width, _windowExtent.height);
+void VulkanEngine::resize_swapchain(VkExtent2D windowExtent) {
+    // NOTE(champ): frames submitted so far may still present to the old
+    // swapchain, the first frame submitted after this one is done with it
+    RetiredSwapchain retired = {};
+    retired.swapchain = _swapchain;
+    retired.imageViews = std::move(_swapchainImageViews);
+    retired.submitSemaphores = std::move(_submitSemaphores);
+    retired.presentFences = std::move(_presentFences);
+    retired.timelineValue = _frameTimelineValue + 1;
+    _swapchainImageViews.clear();
+    _submitSemaphores.clear();
+    _presentFences.clear();
+    
+    // NOTE(champ): the size comes from the main thread, SDL window queries
+    // are not allowed from the render thread
+    _windowExtent = windowExtent;
+    
+    create_swapchain(_windowExtent.width, _windowExtent.height, retired.swapchain);
+    _retiredSwapchains.push_back(std::move(retired));
     
     _resizeRequested = false;
 }
@@ -834,28 +1526,181 @@ void VulkanEngine::destroy_swapchain() {
     for (auto &imageView : _swapchainImageViews) {
         vkDestroyImageView(_device, imageView, nullptr);
     }
+    _swapchainImageViews.clear();
+    
+    for (auto &semaphore : _submitSemaphores) {
+        vkDestroySemaphore(_device, semaphore, nullptr);
+    }
+    _submitSemaphores.clear();
+}
+
+VkFence VulkanEngine::acquire_present_fence() {
+    if (!_freePresentFences.empty()) {
+        VkFence fence = _freePresentFences.back();
+        _freePresentFences.pop_back();
+        return fence;
+    }
+    VkFenceCreateInfo fenceCI = vkinit::fence_create_info();
+    VkFence fence;
+    VK_CHECK(vkCreateFence(_device, &fenceCI, nullptr, &fence));
+    return fence;
+}
+
+bool VulkanEngine::recycle_present_fences(std::vector<VkFence>& fences) {
+    auto signaled = [&](VkFence fence) {
+        if (vkGetFenceStatus(_device, fence) != VK_SUCCESS) {
+            return false;
+        }
+        VK_CHECK(vkResetFences(_device, 1, &fence));
+        _freePresentFences.push_back(fence);
+        return true;
+    };
+    fences.erase(std::remove_if(fences.begin(), fences.end(), signaled), fences.end());
+    return fences.empty();
+}
+
+void VulkanEngine::destroy_retired_swapchains(u64 completedTimelineValue) {
+    // NOTE(champ): the timeline only says the rendering is done, the present
+    // that waited on it may still hold the images. With present fences the
+    // swapchain waits for those too. Without them this relies on the
+    // presentation engine having released the old swapchain once a later
+    // frame finished on the GPU, which holds on the drivers we run on but is
+    // not promised by the spec
+    auto done = [&](RetiredSwapchain& retired) {
+        bool presented = recycle_present_fences(retired.presentFences);
+        return presented && retired.timelineValue <= completedTimelineValue;
+    };
+    std::vector<RetiredSwapchain> remaining;
+    for (RetiredSwapchain& retired : _retiredSwapchains) {
+        if (!done(retired)) {
+            remaining.push_back(std::move(retired));
+            continue;
+        }
+        vkDestroySwapchainKHR(_device, retired.swapchain, nullptr);
+        for (VkImageView imageView : retired.imageViews) {
+            vkDestroyImageView(_device, imageView, nullptr);
+        }
+        for (VkSemaphore semaphore : retired.submitSemaphores) {
+            vkDestroySemaphore(_device, semaphore, nullptr);
+        }
+    }
+    _retiredSwapchains = std::move(remaining);
+}
+
+void VulkanEngine::wait_present_fences() {
+    // NOTE(champ): vkDeviceWaitIdle does not cover presents, so the
+    // swapchains are only destroyed once every present fence signaled
+    std::vector<VkFence> pending = _presentFences;
+    for (const RetiredSwapchain& retired : _retiredSwapchains) {
+        pending.insert(pending.end(), retired.presentFences.begin(), retired.presentFences.end());
+    }
+    if (!pending.empty()) {
+        VK_CHECK(vkWaitForFences(_device, (u32)pending.size(), pending.data(), true, UINT64_MAX));
+    }
+    recycle_present_fences(_presentFences);
+    for (RetiredSwapchain& retired : _retiredSwapchains) {
+        recycle_present_fences(retired.presentFences);
+    }
+    for (VkFence fence : _freePresentFences) {
+        vkDestroyFence(_device, fence, nullptr);
+    }
+    _freePresentFences.clear();
+}
+
+void VulkanEngine::destroy_retired_scenes(u64 completedTimelineValue) {
+    // the scenes free their GPU resources when the last reference goes away
+    _retiredScenes.erase(std::remove_if(_retiredScenes.begin(), _retiredScenes.end(),
+                                        [&](const RetiredScene& retired) {
+                                            return retired.timelineValue <= completedTimelineValue;
+                                        }),
+                         _retiredScenes.end());
 }
 
 void VulkanEngine::draw() {
+    FramePacket& packet = _framePackets[0];
+    packet.windowExtent = window_extent();
+    packet.inputTicks = SDL_GetTicksNS();
+    packet.frameTime = stats.frame_time;
+    update_scene(packet);
+    packet.imgui.capture(_headless ? nullptr : ImGui::GetDrawData());
+    render_frame(packet);
+}
+
+void VulkanEngine::render_frame(FramePacket& packet) {
+    if (!_headless) {
+        bool settingsChanged = packet.settings.presentMode != _requestedPresentMode
+            || packet.settings.swapchainImageCount != _requestedImageCount;
+        if (_resizeRequested || settingsChanged) {
+            _requestedPresentMode = packet.settings.presentMode;
+            _requestedImageCount = packet.settings.swapchainImageCount;
+            resize_swapchain(packet.windowExtent);
+        }
+    }
+    
+    // NOTE(champ): the packets filled before these scenes were retired have
+    // all been submitted by now, so the last submitted frame is the last one
+    // that may use them
+    for (std::shared_ptr<gltf::LoadedScene>& scene : packet.retiredScenes) {
+        _retiredScenes.push_back({ std::move(scene), _frameTimelineValue.load() });
+    }
+    packet.retiredScenes.clear();
+    
+    u64 completedValue = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(_device, _frameTimeline, &completedValue));
+    destroy_retired_scenes(completedValue);
+    _textureCache.destroy_retired(completedValue);
+    if (!_headless) {
+        recycle_present_fences(_presentFences);
+        destroy_retired_swapchains(completedValue);
+    }
+    
+    stats.frame_time = packet.frameTime;
+    stats.scene_update_time = packet.sceneUpdateTime;
+    stats.bvh_visited_nodes = packet.bvhVisitedNodes;
+    stats.changed_nodes = packet.changedNodes;
+    
+    set_frames_in_flight(packet.settings.framesInFlight);
+    stats.frames_in_flight = (int)_framesInFlight;
+    stats.present_mode = (int)_presentMode;
+    stats.swapchain_image_count = (int)_swapchainImages.size();
+    {
+        std::lock_guard<std::mutex> lock(_latencyMutex);
+        stats.submit_to_gpu_done = _submitToGpuDone;
+    }
+    
     FrameData &currentFrame = get_current_frame();
-    this->update_scene();
     
-    // Wait for the GPU to finish all its work
-    VK_CHECK(vkWaitForFences(_device, 1, &currentFrame._renderFence, true,
-                             1000000000));
+    // Wait for the GPU to finish the last use of this frame, the frames after
+    // it can still be in flight
+    wait_frame_timeline(currentFrame._timelineValue);
     
     currentFrame._deletionQueue.flush();
     currentFrame._frameDescriptors.clear_pools(_device);
     
-    u32 swapchainImageIndex;
-    VkResult res = vkAcquireNextImageKHR(_device, _swapchain, 1000000000,
-                                         currentFrame._swapchainSemaphore,
-                                         nullptr, &swapchainImageIndex);
-    if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) {
-        _resizeRequested = true;
-        return;
+    // the timeline guarantees the timestamps of the last use of this frame are
+    // available, so reading them here never stalls
+    read_gpu_timestamps(currentFrame);
+    read_visible_object_count(currentFrame);
+    
+    u32 swapchainImageIndex = 0;
+    if (!_headless)
+    {
+        VkResult res = vkAcquireNextImageKHR(_device, _swapchain, 1000000000,
+                                             currentFrame._swapchainSemaphore,
+                                             nullptr, &swapchainImageIndex);
+        if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+            _resizeRequested = true;
+            publish_stats();
+            return;
+        }
+        // NOTE(champ): a suboptimal image was still acquired and signals the
+        // semaphore, draw it and recreate the swapchain next frame
+        if (res == VK_SUBOPTIMAL_KHR) {
+            _resizeRequested = true;
+        } else {
+            VK_CHECK(res);
+        }
     }
-    VK_CHECK(vkResetFences(_device, 1, &currentFrame._renderFence));
     
     VkCommandBuffer cmd = currentFrame._mainCommandBuffer;
     // Reset the command buffer to start writing again
@@ -866,18 +1711,33 @@ void VulkanEngine::draw() {
     
     _drawExtent.width =
         std::min(_swapchainExtent.width, _drawImage.imageExtent.width) *
-        _renderScale;
+        packet.settings.renderScale;
     _drawExtent.height =
         std::min(_swapchainExtent.height, _drawImage.imageExtent.height) *
-        _renderScale;
+        packet.settings.renderScale;
     
     VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
     
+    const bool writeTimestamps = _timestampValidBits != 0;
+    if (writeTimestamps) {
+        vkCmdResetQueryPool(cmd, currentFrame._timestampPool, 0, TIMESTAMP_COUNT);
+        vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
+                             currentFrame._timestampPool, TIMESTAMP_FRAME_BEGIN);
+    }
+    auto write_timestamp = [&](GPUTimestamp timestamp) {
+        if (writeTimestamps) {
+            vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                 currentFrame._timestampPool, timestamp);
+        }
+    };
+    currentFrame._timestampsWritten = writeTimestamps;
+    
     // make the swapchain image into a writeable format
     vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED,
                              VK_IMAGE_LAYOUT_GENERAL);
     
-    draw_background(cmd);
+    draw_background(cmd, packet);
+    write_timestamp(TIMESTAMP_BACKGROUND_END);
     
     // trasition the draw image to optimal for mat for graphics pipeline
     vkutil::transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_GENERAL,
@@ -885,7 +1745,49 @@ void VulkanEngine::draw() {
     vkutil::transition_image(cmd, _depthImage.image, VK_IMAGE_LAYOUT_UNDEFINED,
                              VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
     
-    draw_geometry(cmd);
+    draw_geometry(cmd, packet);
+    write_timestamp(TIMESTAMP_GEOMETRY_END);
+    
+    if (_headless)
+    {
+        // NOTE(champ): no swapchain to present to, convert the draw image into
+        // RGBA8 and copy it into this frame's readback buffer instead
+        vkutil::transition_image(cmd, _drawImage.image,
+                                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        vkutil::transition_image(cmd, _readbackImage.image,
+                                 VK_IMAGE_LAYOUT_UNDEFINED,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        vkutil::copy_image_to_image(cmd, _drawImage.image, _readbackImage.image,
+                                    _drawExtent, _swapchainExtent);
+        vkutil::transition_image(cmd, _readbackImage.image,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        vkutil::copy_image_to_buffer(cmd, _readbackImage.image,
+                                     currentFrame._readbackBuffer.buffer,
+                                     _swapchainExtent);
+        write_timestamp(TIMESTAMP_BLIT_END);
+        // no imgui pass when headless
+        write_timestamp(TIMESTAMP_IMGUI_END);
+        
+        VK_CHECK(vkEndCommandBuffer(cmd));
+        
+        VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(cmd);
+        VkSemaphoreSubmitInfo timelineInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                                           _frameTimeline);
+        timelineInfo.value = ++_frameTimelineValue;
+        VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, &timelineInfo, nullptr);
+        {
+            std::lock_guard<std::mutex> queueLock(_queueMutex);
+            VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit, VK_NULL_HANDLE));
+        }
+        currentFrame._timelineValue = timelineInfo.value;
+        track_submit_latency(packet, timelineInfo.value);
+        
+        _frameNumber += 1;
+        publish_stats();
+        return;
+    }
     
     // transition the draw image and the swapchain image into their correct
     // transfer layouts
@@ -899,6 +1801,7 @@ void VulkanEngine::draw() {
     vkutil::copy_image_to_image(cmd, _drawImage.image,
                                 _swapchainImages[swapchainImageIndex],
                                 _drawExtent, _swapchainExtent);
+    write_timestamp(TIMESTAMP_BLIT_END);
     
     // set swapchain image layout to Attachment Optimal so we can draw it
     vkutil::transition_image(cmd, _swapchainImages[swapchainImageIndex],
@@ -906,7 +1809,8 @@ void VulkanEngine::draw() {
                              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
     
     // draw imgui into the swapchain image
-    draw_imgui(cmd, _swapchainImageViews[swapchainImageIndex]);
+    draw_imgui(cmd, _swapchainImageViews[swapchainImageIndex], packet.imgui.drawData);
+    write_timestamp(TIMESTAMP_IMGUI_END);
     
     // make the swapchain image into presentable mode
     vkutil::transition_image(cmd, _swapchainImages[swapchainImageIndex],
@@ -926,16 +1830,29 @@ void VulkanEngine::draw() {
     VkSemaphoreSubmitInfo waitInfo = vkinit::semaphore_submit_info(
                                                                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
                                                                    currentFrame._swapchainSemaphore);
-    VkSemaphoreSubmitInfo signalInfo =
+    // NOTE(champ): present only waits on binary semaphores, the timeline is
+    // signaled next to it for the CPU side
+    VkSemaphoreSubmitInfo signalInfos[2] = {
         vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
-                                      _submitSemaphores.at(swapchainImageIndex));
+                                      _submitSemaphores.at(swapchainImageIndex)),
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                      _frameTimeline),
+    };
+    signalInfos[1].value = ++_frameTimelineValue;
+    
+    VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, signalInfos, &waitInfo);
+    submit.signalSemaphoreInfoCount = 2;
     
-    VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, &signalInfo, &waitInfo);
+    // NOTE(champ): held until after present, the queue is shared with
+    // background scene loads
+    std::unique_lock<std::mutex> queueLock(_queueMutex);
     
     // submit command buffer to the queue and execute it.
-    //  _renderFence will now block until the graphic commands finish execution
-    VK_CHECK(
-             vkQueueSubmit2(_graphicsQueue, 1, &submit, currentFrame._renderFence));
+    //  _frameTimeline will reach the frame's value once the graphic commands
+    //  finish execution
+    VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit, VK_NULL_HANDLE));
+    currentFrame._timelineValue = signalInfos[1].value;
+    track_submit_latency(packet, signalInfos[1].value);
     
     // prepare present
     //  this will put the image we just rendered to into the visible window.
@@ -953,7 +1870,23 @@ void VulkanEngine::draw() {
     
     presentInfo.pImageIndices = &swapchainImageIndex;
     
+    // NOTE(champ): signaled once the presentation engine is done with the
+    // image, see destroy_retired_swapchains
+    VkSwapchainPresentFenceInfoEXT presentFenceInfo = {};
+    presentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+    presentFenceInfo.swapchainCount = 1;
+    VkFence presentFence = VK_NULL_HANDLE;
+    if (_presentFencesSupported) {
+        presentFence = acquire_present_fence();
+        presentFenceInfo.pFences = &presentFence;
+        presentInfo.pNext = &presentFenceInfo;
+    }
+    
     VkResult presentRes = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+    queueLock.unlock();
+    if (presentFence != VK_NULL_HANDLE) {
+        _presentFences.push_back(presentFence);
+    }
     if (presentRes == VK_ERROR_OUT_OF_DATE_KHR ||
         presentRes == VK_SUBOPTIMAL_KHR) {
         _resizeRequested = true;
@@ -961,9 +1894,240 @@ void VulkanEngine::draw() {
     
     // increase the number of frames drawn
     _frameNumber += 1;
+    publish_stats();
+}
+
+void VulkanEngine::read_gpu_timestamps(FrameData& frame) {
+    if (!frame._timestampsWritten) {
+        return;
+    }
+    
+    u64 timestamps[TIMESTAMP_COUNT] = {};
+    VkResult res = vkGetQueryPoolResults(_device, frame._timestampPool, 0,
+                                         TIMESTAMP_COUNT, sizeof(timestamps),
+                                         timestamps, sizeof(u64),
+                                         VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS) {
+        // VK_NOT_READY, keep the previous values instead of waiting
+        return;
+    }
+    
+    const u64 mask = _timestampValidBits >= 64 ? ~0ull
+        : ((1ull << _timestampValidBits) - 1);
+    // timestampPeriod is in nanoseconds per tick
+    const double toMs = (double)_gpuProperties.limits.timestampPeriod / 1000000.0;
+    auto elapsed = [&](GPUTimestamp from, GPUTimestamp to) {
+        u64 ticks = ((timestamps[to] & mask) - (timestamps[from] & mask)) & mask;
+        return (float)(ticks * toMs);
+    };
+    
+    stats.gpu_background_time = elapsed(TIMESTAMP_FRAME_BEGIN, TIMESTAMP_BACKGROUND_END);
+    stats.gpu_geometry_time = elapsed(TIMESTAMP_BACKGROUND_END, TIMESTAMP_GEOMETRY_END);
+    stats.gpu_blit_time = elapsed(TIMESTAMP_GEOMETRY_END, TIMESTAMP_BLIT_END);
+    stats.gpu_imgui_time = elapsed(TIMESTAMP_BLIT_END, TIMESTAMP_IMGUI_END);
+    stats.gpu_frame_time = elapsed(TIMESTAMP_FRAME_BEGIN, TIMESTAMP_IMGUI_END);
+}
+
+void VulkanEngine::read_visible_object_count(FrameData& frame) {
+    if (frame._indirectBatchCount == 0) {
+        return;
+    }
+    
+    // the counts were copied here by the last use of this frame, whose
+    // _timelineValue on _frameTimeline has been waited on
+    VK_CHECK(vmaInvalidateAllocation(_allocator, frame._drawCountReadback.allocation,
+                                     0, (frame._indirectBatchCount + 1) * sizeof(u32)));
+    const u32* counts = (const u32*)frame._drawCountReadback.info.pMappedData;
+    u32 visible = 0;
+    for (u32 i = 0; i < frame._indirectBatchCount; i++) {
+        visible += counts[i];
+    }
+    stats.gpu_visible_objects = (int)visible;
+    stats.gpu_visible_triangles = (int)counts[frame._indirectBatchCount];
+}
+
+//> indirect_buffers
+void VulkanEngine::reserve_indirect_buffers(FrameData& frame, u32 objectCount, u32 batchCount) {
+    // only called after waiting for the frame's _timelineValue, nothing on the
+    // GPU uses them anymore
+    if (objectCount > frame._objectCapacity) {
+        if (frame._objectCapacity > 0) {
+            destroy_buffer(frame._objectBuffer);
+            destroy_buffer(frame._drawCommandBuffer);
+        }
+        frame._objectCapacity = std::max(objectCount, frame._objectCapacity * 2);
+        
+        frame._objectBuffer = create_buffer(frame._objectCapacity * sizeof(GPUObjectData),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                            VMA_MEMORY_USAGE_CPU_TO_GPU);
+        frame._drawCommandBuffer = create_buffer(frame._objectCapacity * sizeof(VkDrawIndexedIndirectCommand),
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                 VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                 VMA_MEMORY_USAGE_GPU_ONLY);
+    }
+    
+    if (batchCount > frame._batchCapacity) {
+        if (frame._batchCapacity > 0) {
+            destroy_buffer(frame._drawCountBuffer);
+            destroy_buffer(frame._drawCountReadback);
+        }
+        frame._batchCapacity = std::max(batchCount, frame._batchCapacity * 2);
+        
+        // one count per batch and the visible triangles after them
+        frame._drawCountBuffer = create_buffer((frame._batchCapacity + 1) * sizeof(u32),
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                               VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                               VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                               VMA_MEMORY_USAGE_GPU_ONLY);
+        frame._drawCountReadback = create_buffer((frame._batchCapacity + 1) * sizeof(u32),
+                                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                 VMA_MEMORY_USAGE_GPU_TO_CPU);
+        // the old counts are gone with the old buffer
+        frame._indirectBatchCount = 0;
+    }
+}
+
+void VulkanEngine::destroy_indirect_buffers(FrameData& frame) {
+    if (frame._objectCapacity > 0) {
+        destroy_buffer(frame._objectBuffer);
+        destroy_buffer(frame._drawCommandBuffer);
+        frame._objectCapacity = 0;
+    }
+    if (frame._batchCapacity > 0) {
+        destroy_buffer(frame._drawCountBuffer);
+        destroy_buffer(frame._drawCountReadback);
+        frame._batchCapacity = 0;
+    }
+    frame._indirectBatchCount = 0;
+}
+//< indirect_buffers
+
+static VkDeviceAddress
+get_buffer_address(VkDevice device, VkBuffer buffer)
+{
+    VkBufferDeviceAddressInfo deviceAdressInfo = {};
+    deviceAdressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    deviceAdressInfo.buffer = buffer;
+    return vkGetBufferDeviceAddress(device, &deviceAdressInfo);
 }
 
-void VulkanEngine::draw_background(VkCommandBuffer cmd) {
+static void
+memory_barrier(VkCommandBuffer cmd,
+               VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+               VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+    VkMemoryBarrier2 memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcStageMask = srcStage;
+    memoryBarrier.srcAccessMask = srcAccess;
+    memoryBarrier.dstStageMask = dstStage;
+    memoryBarrier.dstAccessMask = dstAccess;
+    
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.pNext = nullptr;
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &memoryBarrier;
+    
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
+// NOTE(champ): writes the sorted opaque objects into this frame's object
+// buffer, grouped in one batch per material, and records the culling dispatch
+// that fills the indirect commands. Has to be recorded outside of rendering.
+void VulkanEngine::cull_objects(VkCommandBuffer cmd, const FramePacket& packet, const std::vector<u32>& opaqueDraws) {
+    FrameData& frame = get_current_frame();
+    const VisibleSnapshot& visible = *packet.visible;
+    _indirectBatches.clear();
+    stats.gpu_culled_input = (int)opaqueDraws.size();
+    if (opaqueDraws.empty()) {
+        frame._indirectBatchCount = 0;
+        stats.gpu_visible_objects = 0;
+        stats.gpu_visible_triangles = 0;
+        return;
+    }
+    
+    for (u32 i = 0; i < opaqueDraws.size(); i++) {
+        const RenderObject& obj = visible.objects[opaqueDraws[i]];
+        if (_indirectBatches.empty() || _indirectBatches.back().material != obj.material) {
+            _indirectBatches.push_back({ obj.material, i, 0 });
+        }
+        _indirectBatches.back().objectCount += 1;
+    }
+    
+    const u32 objectCount = (u32)opaqueDraws.size();
+    const u32 batchCount = (u32)_indirectBatches.size();
+    reserve_indirect_buffers(frame, objectCount, batchCount);
+    
+    GPUObjectData* objects = (GPUObjectData*)frame._objectBuffer.info.pMappedData;
+    u32 batchIndex = 0;
+    for (u32 i = 0; i < objectCount; i++) {
+        if (i >= _indirectBatches[batchIndex].commandOffset + _indirectBatches[batchIndex].objectCount) {
+            batchIndex += 1;
+        }
+        const RenderObject& obj = visible.objects[opaqueDraws[i]];
+        GPUObjectData& gpuObj = objects[i];
+        gpuObj.transform = obj.transform;
+        gpuObj.boundsOrigin = glm::vec4(obj.bounds.origin, obj.bounds.sphere_radius);
+        gpuObj.boundsExtents = glm::vec4(obj.bounds.extents, 0.f);
+        gpuObj.positionOrigin = obj.positionOrigin;
+        gpuObj.positionExtents = obj.positionExtents;
+        gpuObj.vertexBuffer = obj.vertexBufferAddr;
+        gpuObj.firstIndex = obj.firstIndex;
+        gpuObj.indexCount = obj.indexCount;
+        gpuObj.vertexOffset = obj.vertexOffset;
+        gpuObj.batchIndex = batchIndex;
+        gpuObj.commandOffset = _indirectBatches[batchIndex].commandOffset;
+        gpuObj.pad = 0;
+    }
+    VK_CHECK(vmaFlushAllocation(_allocator, frame._objectBuffer.allocation,
+                                0, objectCount * sizeof(GPUObjectData)));
+    
+    vkCmdFillBuffer(cmd, frame._drawCountBuffer.buffer, 0, (batchCount + 1) * sizeof(u32), 0);
+    memory_barrier(cmd,
+                   VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    
+    GPUCullPushConstants pushConstants;
+    pushConstants.viewproj = packet.sceneData.viewproj;
+    pushConstants.objectBuffer = get_buffer_address(_device, frame._objectBuffer.buffer);
+    pushConstants.commandBuffer = get_buffer_address(_device, frame._drawCommandBuffer.buffer);
+    pushConstants.countBuffer = get_buffer_address(_device, frame._drawCountBuffer.buffer);
+    pushConstants.objectCount = objectCount;
+    pushConstants.batchCount = batchCount;
+    
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+    vkCmdPushConstants(cmd, _cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(GPUCullPushConstants), &pushConstants);
+    // 64 objects per workgroup
+    vkCmdDispatch(cmd, (objectCount + 63) / 64, 1, 1);
+    
+    memory_barrier(cmd,
+                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                   VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COPY_BIT,
+                   VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+    
+    // keep the counts around for the stats, read once _frameTimeline reaches
+    // this frame's value
+    VkBufferCopy countCopy = {};
+    countCopy.srcOffset = 0;
+    countCopy.dstOffset = 0;
+    countCopy.size = (batchCount + 1) * sizeof(u32);
+    vkCmdCopyBuffer(cmd, frame._drawCountBuffer.buffer, frame._drawCountReadback.buffer, 1, &countCopy);
+    memory_barrier(cmd,
+                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+    
+    frame._indirectBatchCount = batchCount;
+}
+
+void VulkanEngine::draw_background(VkCommandBuffer cmd, const FramePacket& packet) {
     // // make a clear-color from frame number. This will flash with a 120 frame
     // // period.
     // VkClearColorValue clearValue;
@@ -973,10 +2137,8 @@ void VulkanEngine::draw_background(VkCommandBuffer cmd) {
     // VkImageSubresourceRange clearRange =
     //     vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
     
-    ComputeEffect &effect = backgroundEffects[currentBackgroundEffect];
-    
     // bind the gradient drawing compute pipeline
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, effect.pipeline);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, packet.settings.backgroundPipeline);
     
     // bind the descriptor set containing the draw image for the compute pipeline
     vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
@@ -984,122 +2146,187 @@ void VulkanEngine::draw_background(VkCommandBuffer cmd) {
                             0, nullptr);
     
     vkCmdPushConstants(cmd, _gradientPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
-                       0, sizeof(ComputePushConstancts), &effect.data);
+                       0, sizeof(ComputePushConstancts), &packet.settings.backgroundData);
     // execute the compute pipeline dispatch. We are using 16x16 workgroup size so
     // we need to divide by it
     vkCmdDispatch(cmd, std::ceil(_drawExtent.width / 16.0),
                   std::ceil(_drawExtent.height / 16.0), 1);
 }
 
-void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
-    stats.drawcall_count = 0;
-    stats.triangle_count = 0;
-    SDL_Time start_ticks = 0;
-    SDL_GetCurrentTime(&start_ticks);
-    
-    std::vector<u32> opaque_draws;
-    opaque_draws.reserve(_mainDrawContext.opaqueSurfaces.size());
-    
-    for (u32 i = 0; i < _mainDrawContext.opaqueSurfaces.size(); i++)
+// keeps the entries of draws whose object is inside the frustum, in order
+static void
+cull_draw_list(const std::vector<RenderObject>& objects,
+               const Frustum& frustum,
+               CullingBounds& bounds,
+               std::vector<u32>& draws)
+{
+    bounds.clear();
+    bounds.reserve((u32)draws.size());
+    for (u32 i : draws)
     {
-        // NOTE(champ): this method of frustum culling ended up not really being useful
-        // on my machine. At most it saves a couple of ms, but also adds some especially
-        // when almost all meshes are inside the frustum
-        
-        //if (is_renderobj_visible(_mainDrawContext.opaqueSurfaces[i], _sceneData.viewproj))
-        {
-            opaque_draws.push_back(i);
-        }
+        const RenderObject& obj = objects[i];
+        bounds.push(obj.bounds.origin, obj.bounds.extents, obj.bounds.sphere_radius, obj.transform);
     }
+    bounds.finish();
     
-    // sort the opaque surfaces by material and mesh
-    std::sort(opaque_draws.begin(), opaque_draws.end(),
-              [&](const auto& iA, const auto& iB)
-              {
-                  const RenderObject& A = _mainDrawContext.opaqueSurfaces[iA];
-                  const RenderObject& B = _mainDrawContext.opaqueSurfaces[iB];
-                  if (A.material == B.material)
-                  {
-                      return A.indexBuffer < B.indexBuffer;
-                  }
-                  return A.material < B.material;
-              });
-    
-    
-    VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(
-                                                                        _drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-    VkRenderingAttachmentInfo depthAttachment = vkinit::depth_attachment_info(
-                                                                              _depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
-    
-    VkRenderingInfo renderInfo =
-        vkinit::rendering_info(_drawExtent, &colorAttachment, &depthAttachment);
-    vkCmdBeginRendering(cmd, &renderInfo);
-    
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipeline);
-    // set dynamic viewport and scissor
-    VkViewport viewport = {};
-    viewport.x = 0;
-    viewport.y = 0;
-    viewport.width = _drawExtent.width;
-    viewport.height = _drawExtent.height;
-    viewport.minDepth = 0.f;
-    viewport.maxDepth = 1.f;
-    vkCmdSetViewport(cmd, 0, 1, &viewport);
-    
-    VkRect2D scissor = {};
-    scissor.offset.x = 0;
-    scissor.offset.y = 0;
-    scissor.extent.width = _drawExtent.width;
-    scissor.extent.height = _drawExtent.height;
-    vkCmdSetScissor(cmd, 0, 1, &scissor);
-    
-    VkDescriptorSet image_set = get_current_frame()._frameDescriptors.allocate(_device, _singleImageDescriptorLayout);
+    std::vector<u32> visible;
+    visible.reserve(draws.size());
+    cull_frustum_simd(bounds, frustum, visible);
+    for (u32& v : visible)
     {
-        DescriptorWriter writer;
-        writer.write_image(0, _errorCheckboardImage.imageView, _defaulSamplerNearest, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-        writer.update_set(_device, image_set);
+        v = draws[v];
+    }
+    draws.swap(visible);
+}
+
+// the far plane of the projection built in update_scene
+constexpr float SORT_MAX_DEPTH = 1000.0f;
+// fewest draws worth handing to another thread when recording in parallel
+constexpr u32 MIN_DRAWS_PER_CHUNK = 256;
+
+static void
+sort_draw_list(const std::vector<RenderObject>& objects,
+               const std::vector<u64>& stateKeys,
+               const glm::mat4& viewproj,
+               bool backToFront,
+               std::vector<DrawKey>& keys,
+               std::vector<DrawKey>& scratch,
+               std::vector<u32>& draws)
+{
+    keys.clear();
+    keys.reserve(draws.size());
+    for (u32 index : draws)
+    {
+        const RenderObject& obj = objects[index];
+        glm::vec3 center = glm::vec3(obj.transform * glm::vec4(obj.bounds.origin, 1.0f));
+        // the clip space w of the center is its view space depth
+        float depth = viewproj[0][3] * center.x + viewproj[1][3] * center.y
+            + viewproj[2][3] * center.z + viewproj[3][3];
+        u32 quantized = quantize_depth(depth, SORT_MAX_DEPTH);
+        u64 stateKey = stateKeys[index];
+        u64 key = backToFront ? transparent_sort_key(stateKey, quantized) : opaque_sort_key(stateKey, quantized);
+        keys.push_back({ key, index });
     }
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipelineLayout, 0, 1, &image_set, 0, nullptr);
-    
-    AllocatedBuffer gpuSceneDataBuffer =
-        create_buffer(sizeof(GPUSceneData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU);
-    
-    // add it to the deletion queue of this frame
-    get_current_frame()._deletionQueue.push_function(
-                                                     [=]() { destroy_buffer(gpuSceneDataBuffer); });
     
-    // write the buffer
-    GPUSceneData *sceneUniformData =
-    (GPUSceneData *)gpuSceneDataBuffer.allocation->GetMappedData();
-    *sceneUniformData = _sceneData;
+    radix_sort(keys, scratch);
+    for (u32 i = 0; i < keys.size(); i++)
+    {
+        draws[i] = keys[i].handle;
+    }
+}
+
+void VulkanEngine::draw_geometry(VkCommandBuffer cmd, const FramePacket& packet) {
+    stats.drawcall_count = 0;
+    stats.triangle_count = 0;
+    stats.pipeline_binds = 0;
+    stats.material_binds = 0;
+    stats.index_buffer_binds = 0;
+    u64 start_ticks = SDL_GetTicksNS();
+    
+    const VisibleSnapshot& visible = *packet.visible;
+    // NOTE(champ): update_scene already dropped what its BVH found invisible
+    std::vector<u32> opaque_draws = visible.opaqueDraws;
+    std::vector<u32> transparent_draws = visible.transparentDraws;
+    
+    // NOTE(champ): only meshes living in the geometry arena share the index
+    // buffer the indirect draws use, the others keep going through the CPU path
+    std::vector<u32> gpu_draws;
+    if (packet.settings.gpuDrivenRendering)
+    {
+        const VkBuffer arenaIndexBuffer = _geometryArena.indexBuffer.buffer;
+        auto cpu_end = std::stable_partition(opaque_draws.begin(), opaque_draws.end(),
+                                             [&](u32 i) {
+                                                 return visible.objects[i].indexBuffer != arenaIndexBuffer;
+                                             });
+        gpu_draws.assign(cpu_end, opaque_draws.end());
+        opaque_draws.erase(cpu_end, opaque_draws.end());
+    }
     
-    // create a descriptor set that binds that buffer and update it
-    VkDescriptorSet globalDescriptor =
-        get_current_frame()._frameDescriptors.allocate(
-                                                       _device, _gpuSceneDataDescriptorLayout);
+    // NOTE(champ): the old per object test projected 8 corners per object and
+    // cost about as much as it saved. The SIMD version tests 4-8 objects at once
+    // against the frustum planes. Objects on the GPU path get culled there.
+    if (packet.settings.cpuFrustumCulling)
+    {
+        u64 cull_start = SDL_GetTicksNS();
+        Frustum frustum = extract_frustum(packet.sceneData.viewproj);
+        cull_draw_list(visible.objects, frustum, _cullingBounds, opaque_draws);
+        cull_draw_list(visible.objects, frustum, _cullingBounds, transparent_draws);
+        stats.culling_time = (float)(SDL_GetTicksNS() - cull_start) / 1000000.0f;
+    }
+    else
+    {
+        stats.culling_time = 0.0f;
+    }
     
+    // NOTE(champ): opaque draws are grouped by pipeline, material and mesh and
+    // go front to back inside a group, transparent ones go back to front
+    u64 sort_start = SDL_GetTicksNS();
+    sort_draw_list(visible.objects, visible.stateKeys, packet.sceneData.viewproj, false, _sortKeys, _sortScratch, opaque_draws);
+    sort_draw_list(visible.objects, visible.stateKeys, packet.sceneData.viewproj, false, _sortKeys, _sortScratch, gpu_draws);
+    sort_draw_list(visible.objects, visible.stateKeys, packet.sceneData.viewproj, true, _sortKeys, _sortScratch, transparent_draws);
+    stats.sort_time = (float)(SDL_GetTicksNS() - sort_start) / 1000000.0f;
+    
+    cull_objects(cmd, packet, gpu_draws);
+    
+    // write this frame's slice of the persistent scene data buffer, the GPU is
+    // done with it since we waited for this frame's _timelineValue
+    const u32 sceneDataOffset = (u32)((_frameNumber % _framesInFlight) * _sceneDataStride);
+    memcpy((u8*)_sceneDataBuffer.info.pMappedData + sceneDataOffset, &packet.sceneData, sizeof(GPUSceneData));
+    VK_CHECK(vmaFlushAllocation(_allocator, _sceneDataBuffer.allocation,
+                                sceneDataOffset, sizeof(GPUSceneData)));
+    
+    // NOTE(champ): everything one command buffer needs to skip redundant
+    // binds. Each chunk of draws gets its own and starts with nothing bound,
+    // so it can be recorded on any thread
+    struct DrawRecorder {
+        VkCommandBuffer cmd;
+        MaterialPipeline* lastPipeline = nullptr;
+        MaterialInstance* lastMaterial = nullptr;
+        VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+        int drawcalls = 0;
+        int triangles = 0;
+        int pipelineBinds = 0;
+        int materialBinds = 0;
+        int indexBufferBinds = 0;
+    };
     
-    DescriptorWriter writer;
-    writer.write_buffer(0, gpuSceneDataBuffer.buffer, sizeof(GPUSceneData), 0,
-                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-    writer.update_set(_device, globalDescriptor);
+    auto begin_recording = [&](DrawRecorder& rec)
+    {
+        vkCmdBindPipeline(rec.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipeline);
+        // set dynamic viewport and scissor
+        VkViewport viewport = {};
+        viewport.x = 0;
+        viewport.y = 0;
+        viewport.width = _drawExtent.width;
+        viewport.height = _drawExtent.height;
+        viewport.minDepth = 0.f;
+        viewport.maxDepth = 1.f;
+        vkCmdSetViewport(rec.cmd, 0, 1, &viewport);
+        
+        VkRect2D scissor = {};
+        scissor.offset.x = 0;
+        scissor.offset.y = 0;
+        scissor.extent.width = _drawExtent.width;
+        scissor.extent.height = _drawExtent.height;
+        vkCmdSetScissor(rec.cmd, 0, 1, &scissor);
+        
+        vkCmdBindDescriptorSets(rec.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipelineLayout, 0, 1, &_defaultImageDescriptors, 0, nullptr);
+    };
     
     // @SECTION: Faster drawing by skipping binding the pipeline if it is already binded
-    MaterialPipeline* last_pipeline = nullptr;
-    MaterialInstance* last_material = nullptr;
-    VkBuffer last_index_buffer = VK_NULL_HANDLE;
-    auto draw_render_object = [&](const RenderObject& obj)
+    auto draw_render_object = [&](DrawRecorder& rec, const RenderObject& obj)
     {
-        if (obj.material != last_material)
+        VkCommandBuffer cmd = rec.cmd;
+        if (obj.material != rec.lastMaterial)
         {
-            last_material = obj.material;
+            rec.lastMaterial = obj.material;
             // rebind pipeline if material has changed
-            if (obj.material->pipeline != last_pipeline)
+            if (obj.material->pipeline != rec.lastPipeline)
             {
-                last_pipeline = obj.material->pipeline;
+                rec.lastPipeline = obj.material->pipeline;
                 vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, obj.material->pipeline->pipeline);
-                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, obj.material->pipeline->pipelineLayout, 0, 1, &globalDescriptor, 0, nullptr);
+                rec.pipelineBinds += 1;
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, obj.material->pipeline->pipelineLayout, 0, 1, &_sceneDataDescriptors, 1, &sceneDataOffset);
                 VkViewport viewport = {0};
                 viewport.x = 0;
                 viewport.y = 0;
@@ -1117,38 +2344,171 @@ void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
                 vkCmdSetScissor(cmd, 0, 1, &scissor);
             }
             vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, obj.material->pipeline->pipelineLayout, 1, 1, &obj.material->materialSet, 0, nullptr);
+            rec.materialBinds += 1;
         }
         
         // rebind index buffer
-        if (obj.indexBuffer != last_index_buffer)
+        if (obj.indexBuffer != rec.lastIndexBuffer)
         {
-            last_index_buffer = obj.indexBuffer;
+            rec.lastIndexBuffer = obj.indexBuffer;
             vkCmdBindIndexBuffer(cmd, obj.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            rec.indexBufferBinds += 1;
         }
         
         GPUDrawPushConstants pushConstants;
         pushConstants.vertexBuffer = obj.vertexBufferAddr;
         pushConstants.worldMatrix = obj.transform;
+        pushConstants.positionOrigin = obj.positionOrigin;
+        pushConstants.positionExtents = obj.positionExtents;
         vkCmdPushConstants(cmd, obj.material->pipeline->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &pushConstants);
         
-        vkCmdDrawIndexed(cmd, obj.indexCount, 1, obj.firstIndex, 0,0);
+        // NOTE(champ): gl_VertexIndex includes vertexOffset, so the shader pulls
+        // from the right place in the shared vertex buffer
+        vkCmdDrawIndexed(cmd, obj.indexCount, 1, obj.firstIndex, obj.vertexOffset, 0);
+        
+        rec.drawcalls += 1;
+        rec.triangles += obj.indexCount / 3;
+    };
+    
+    auto draw_indirect_batches = [&](DrawRecorder& rec)
+    {
+        VkCommandBuffer cmd = rec.cmd;
+        FrameData& frame = get_current_frame();
+        MaterialPipeline& indirectPipeline = metalRoughMat._opaqueIndirectPipeline;
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectPipeline.pipeline);
+        rec.pipelineBinds += 1;
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectPipeline.pipelineLayout, 0, 1, &_sceneDataDescriptors, 1, &sceneDataOffset);
+        
+        GPUIndirectPushConstants pushConstants;
+        pushConstants.objectBuffer = get_buffer_address(_device, frame._objectBuffer.buffer);
+        vkCmdPushConstants(cmd, indirectPipeline.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUIndirectPushConstants), &pushConstants);
         
-        stats.drawcall_count += 1;
-        stats.triangle_count += obj.indexCount / 3;
+        vkCmdBindIndexBuffer(cmd, _geometryArena.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+        rec.indexBufferBinds += 1;
+        
+        // one call per material, the GPU decides how many of its commands run
+        for (u32 i = 0; i < _indirectBatches.size(); i++)
+        {
+            const IndirectBatch& batch = _indirectBatches[i];
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectPipeline.pipelineLayout, 1, 1, &batch.material->materialSet, 0, nullptr);
+            rec.materialBinds += 1;
+            
+            vkCmdDrawIndexedIndirectCount(cmd,
+                                          frame._drawCommandBuffer.buffer,
+                                          batch.commandOffset * sizeof(VkDrawIndexedIndirectCommand),
+                                          frame._drawCountBuffer.buffer,
+                                          i * sizeof(u32),
+                                          batch.objectCount,
+                                          sizeof(VkDrawIndexedIndirectCommand));
+            rec.drawcalls += 1;
+        }
+        // NOTE(champ): only the culling shader knows what it kept, this is
+        // what it drew frames in flight frames ago
+        rec.triangles += stats.gpu_visible_triangles;
     };
     
-    for (auto& obj_index: opaque_draws) {
-        draw_render_object(_mainDrawContext.opaqueSurfaces[obj_index]);
+    // the order the sort gave: indirect batches, opaque draws, transparent draws
+    std::vector<u32> cpu_draws;
+    cpu_draws.reserve(opaque_draws.size() + transparent_draws.size());
+    cpu_draws.insert(cpu_draws.end(), opaque_draws.begin(), opaque_draws.end());
+    cpu_draws.insert(cpu_draws.end(), transparent_draws.begin(), transparent_draws.end());
+    
+    // NOTE(champ): below a few hundred draws a thread costs more to wake up
+    // than it saves, those frames are recorded inline
+    FrameData& frame = get_current_frame();
+    u32 chunkCount = 1;
+    if (packet.settings.parallelRecording)
+    {
+        chunkCount = std::clamp((u32)cpu_draws.size() / MIN_DRAWS_PER_CHUNK, 1u, (u32)frame._recordBuffers.size());
     }
-    for (const RenderObject& obj: _mainDrawContext.transparentSurfaces) {
-        draw_render_object(obj);
+    std::vector<DrawRecorder> recorders(chunkCount);
+    
+    u64 record_start = SDL_GetTicksNS();
+    
+    VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(
+                                                                        _drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    VkRenderingAttachmentInfo depthAttachment = vkinit::depth_attachment_info(
+                                                                              _depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+    
+    VkRenderingInfo renderInfo =
+        vkinit::rendering_info(_drawExtent, &colorAttachment, &depthAttachment);
+    
+    if (chunkCount == 1)
+    {
+        vkCmdBeginRendering(cmd, &renderInfo);
+        DrawRecorder& rec = recorders[0];
+        rec.cmd = cmd;
+        begin_recording(rec);
+        if (!_indirectBatches.empty())
+        {
+            draw_indirect_batches(rec);
+        }
+        for (u32 obj_index: cpu_draws) {
+            draw_render_object(rec, visible.objects[obj_index]);
+        }
+    }
+    else
+    {
+        // NOTE(champ): every chunk is a contiguous range of the sorted draws
+        // recorded into the secondary buffer of its slot, executing them in
+        // slot order keeps the order of the sort
+        VkFormat colorFormat = _drawImage.imageFormat;
+        VkCommandBufferInheritanceRenderingInfo renderingInheritance = {};
+        renderingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+        renderingInheritance.colorAttachmentCount = 1;
+        renderingInheritance.pColorAttachmentFormats = &colorFormat;
+        renderingInheritance.depthAttachmentFormat = _depthImage.imageFormat;
+        renderingInheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        
+        VkCommandBufferInheritanceInfo inheritance = {};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.pNext = &renderingInheritance;
+        
+        const u32 drawCount = (u32)cpu_draws.size();
+        // NOTE(champ): ahead of whatever a background load queued
+        _jobSystem.parallel_for(chunkCount, [&](u32 chunk) {
+            // the pool of a slot is only ever used by the job recording it
+            VK_CHECK(vkResetCommandPool(_device, frame._recordPools[chunk], 0));
+            
+            DrawRecorder& rec = recorders[chunk];
+            rec.cmd = frame._recordBuffers[chunk];
+            VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(
+                                                                                   VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+            beginInfo.pInheritanceInfo = &inheritance;
+            VK_CHECK(vkBeginCommandBuffer(rec.cmd, &beginInfo));
+            
+            begin_recording(rec);
+            if (chunk == 0 && !_indirectBatches.empty())
+            {
+                draw_indirect_batches(rec);
+            }
+            u32 first = (u32)((u64)drawCount * chunk / chunkCount);
+            u32 last = (u32)((u64)drawCount * (chunk + 1) / chunkCount);
+            for (u32 i = first; i < last; i++) {
+                draw_render_object(rec, visible.objects[cpu_draws[i]]);
+            }
+            
+            VK_CHECK(vkEndCommandBuffer(rec.cmd));
+        }, JobPriority::HIGH);
+        
+        renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+        vkCmdBeginRendering(cmd, &renderInfo);
+        vkCmdExecuteCommands(cmd, chunkCount, frame._recordBuffers.data());
     }
     
-    SDL_Time end_ticks = 0;
-    SDL_GetCurrentTime(&end_ticks);
+    stats.record_time = (float)(SDL_GetTicksNS() - record_start) / 1000000.0f;
+    stats.record_chunks = (int)chunkCount;
+    for (const DrawRecorder& rec : recorders)
+    {
+        stats.drawcall_count += rec.drawcalls;
+        stats.triangle_count += rec.triangles;
+        stats.pipeline_binds += rec.pipelineBinds;
+        stats.material_binds += rec.materialBinds;
+        stats.index_buffer_binds += rec.indexBufferBinds;
+    }
     
-    SDL_Time diff = (float)(end_ticks - start_ticks);
-    stats.mesh_draw_time = diff / 1000000.0f;
+    u64 end_ticks = SDL_GetTicksNS();
+    stats.mesh_draw_time = (float)(end_ticks - start_ticks) / 1000000.0f;
     
     // auto currentMesh = _testMeshes[_currentTestMesh];
     // GPUDrawPushConstants push_constants;
@@ -1189,8 +2549,38 @@ void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
     vkCmdEndRendering(cmd);
 }
 
+ImGuiFrameSnapshot::~ImGuiFrameSnapshot() {
+    clear();
+}
+
+void ImGuiFrameSnapshot::capture(const ImDrawData* source) {
+    clear();
+    if (source == nullptr || !source->Valid) {
+        return;
+    }
+    
+    // the copy shares the source's lists, each one is swapped for a clone
+    drawData = new ImDrawData(*source);
+    lists.reserve(drawData->CmdLists.Size);
+    for (int i = 0; i < drawData->CmdLists.Size; i++) {
+        ImDrawList* list = source->CmdLists[i]->CloneOutput();
+        drawData->CmdLists[i] = list;
+        lists.push_back(list);
+    }
+}
+
+void ImGuiFrameSnapshot::clear() {
+    for (ImDrawList* list : lists) {
+        IM_DELETE(list);
+    }
+    lists.clear();
+    delete drawData;
+    drawData = nullptr;
+}
+
 void VulkanEngine::draw_imgui(VkCommandBuffer cmd,
-                              VkImageView targetImageView) {
+                              VkImageView targetImageView,
+                              ImDrawData* drawData) {
     
     VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(
                                                                         targetImageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
@@ -1199,18 +2589,19 @@ void VulkanEngine::draw_imgui(VkCommandBuffer cmd,
     
     vkCmdBeginRendering(cmd, &renderInfo);
     
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+    if (drawData) {
+        ImGui_ImplVulkan_RenderDrawData(drawData, cmd);
+    }
     
     vkCmdEndRendering(cmd);
 }
 
-void VulkanEngine::update_scene()
+void VulkanEngine::update_scene(FramePacket& packet)
 {
-    SDL_Time start_ticks = 0;
-    SDL_GetCurrentTime(&start_ticks);
+    u64 start_ticks = SDL_GetTicksNS();
     
-    this->_mainDrawContext.opaqueSurfaces.clear();
-    this->_mainDrawContext.transparentSurfaces.clear();
+    packet.bvhVisitedNodes = 0;
+    packet.changedNodes = 0;
     
     camera::update(&this->mainCamera);
     glm::mat4 view = camera::getViewMatrix(&this->mainCamera);
@@ -1219,7 +2610,7 @@ void VulkanEngine::update_scene()
     
     this->_sceneData.view = view;
     this->_sceneData.projection = glm::perspective(glm::radians(70.0f),
-                                                   (float)this->_windowExtent.width / (float)this->_windowExtent.height,
+                                                   (float)packet.windowExtent.width / (float)std::max(packet.windowExtent.height, 1u),
                                                    1000.0f,
                                                    0.1f);
     // invert the projection matrix for Vulkan
@@ -1242,31 +2633,200 @@ void VulkanEngine::update_scene()
         }
     }*/
     
-    // NOTE(champ): add all loaded scenes to be drawn
-    // maybe we dont want to draw all scenes we have loaded?
+    // NOTE(champ): scenes push the surfaces that moved into the render list,
+    // nothing is emitted again. Visibility is only recomputed when the list
+    // or the camera changed, otherwise last frame's is still right
+    // NOTE(champ): make sure this only happens to the player's car!
+    //glm::vec3 camera_offset = this->mainCamera.position + glm::vec3(0.0f,-5.0f, 5.0f);
+    glm::vec3 camera_offset = {0, 0, 0};
+    glm::mat4 top_matrix = glm::translate(glm::mat4(1.0f),camera_offset);
+    
     for (const auto& pair: loadedScenes)
     {
+        gltf::LoadedScene* scene = pair.second.get();
+        if (scene && scene->update(top_matrix))
+        {
+            packet.changedNodes += (int)scene->graph.changedNodes.size();
+        }
+    }
+    
+    bool visibilityValid = _visibilityValid
+        && _visibleViewproj == this->_sceneData.viewproj
+        && _visibleWithBvh == _bvhCulling
+        && _visibleVersion == _renderList.version;
+    if (!visibilityValid)
+    {
+        _previousVisibleObjects.swap(_visibleObjects);
+        if (_bvhCulling)
+        {
+            _visibleObjects.assign(_renderList.size(), 0);
+            // NOTE(champ): the BVH lives in the scene's space, so the frustum
+            // is brought into it instead of moving every box
+            Frustum frustum = extract_frustum(this->_sceneData.viewproj * top_matrix);
+            for (const auto& pair: loadedScenes)
+            {
+                if (pair.second)
+                {
+                    packet.bvhVisitedNodes += (int)pair.second->mark_visible(frustum, _visibleObjects);
+                }
+            }
+        }
+        else
+        {
+            _visibleObjects = _renderList.alive;
+        }
         
-        if (pair.second)
+        _visibleViewproj = this->_sceneData.viewproj;
+        _visibleWithBvh = _bvhCulling;
+        _visibleVersion = _renderList.version;
+        _visibilityValid = true;
+        
+        if (_visibleObjects != _previousVisibleObjects)
         {
-            // NOTE(champ): make sure this only happens to the player's car!
-            //glm::vec3 camera_offset = this->mainCamera.position + glm::vec3(0.0f,-5.0f, 5.0f);
-            glm::vec3 camera_offset = {0, 0, 0};
-            pair.second->draw(glm::translate(glm::mat4(1.0f),camera_offset),
-                              this->_mainDrawContext);
+            _snapshotLayoutValid = false;
+        }
+    }
+    else if (_bvhCulling && !_renderList.movedHandles.empty())
+    {
+        // NOTE(champ): objects that only moved are tested on their own, the
+        // BVH query is not run again for them. Same test as the BVH leaves,
+        // their transform already has the top matrix in it
+        Frustum frustum = extract_frustum(this->_sceneData.viewproj);
+        for (u32 handle: _renderList.movedHandles)
+        {
+            const RenderObject& obj = _renderList.objects[handle];
+            AABB box = transform_box(obj.bounds.origin, obj.bounds.extents, obj.transform);
+            u8 visible = test_frustum(box, frustum) != FrustumTest::OUTSIDE ? 1 : 0;
+            if (_visibleObjects[handle] != visible)
+            {
+                _visibleObjects[handle] = visible;
+                _snapshotLayoutValid = false;
+            }
         }
     }
     //loadedScenes["structure"]->draw(glm::mat4(1.0f), _mainDrawContext);
     
-    SDL_Time end_ticks = 0;
-    SDL_GetCurrentTime(&end_ticks);
-    
-    float diff = (float)(end_ticks - start_ticks);
-    stats.scene_update_time = diff / 1000000.0f;
+    // NOTE(champ): the render thread only sees copies of the visible objects,
+    // the render list keeps changing for the next frame while it records
+    if (!_snapshotLayoutValid || _snapshotVersion != _renderList.version)
+    {
+        _snapshotLayoutValid = false;
+        for (SnapshotBuffer& buffer: _snapshotBuffers)
+        {
+            buffer.stale = true;
+            buffer.moved.clear();
+        }
+    }
+    else if (_snapshotTransformVersion != _renderList.transformVersion)
+    {
+        for (SnapshotBuffer& buffer: _snapshotBuffers)
+        {
+            // a buffer left alone for long enough is cheaper to copy again
+            if (buffer.moved.size() + _renderList.movedHandles.size() > _renderList.size())
+            {
+                buffer.stale = true;
+                buffer.moved.clear();
+            }
+            else if (!buffer.stale)
+            {
+                buffer.moved.insert(buffer.moved.end(), _renderList.movedHandles.begin(), _renderList.movedHandles.end());
+            }
+        }
+    }
+    _renderList.movedHandles.clear();
+    _snapshotVersion = _renderList.version;
+    _snapshotTransformVersion = _renderList.transformVersion;
+    
+    // this packet is ours until it is submitted, what it held is done with
+    packet.visible.reset();
+    bool publishedCurrent = _publishedSnapshot < _snapshotBuffers.size()
+        && !_snapshotBuffers[_publishedSnapshot].stale
+        && _snapshotBuffers[_publishedSnapshot].moved.empty();
+    if (!publishedCurrent)
+    {
+        // NOTE(champ): packets are only filled and reset on this thread, so a
+        // buffer nobody else holds stays that way while it is written
+        u32 target = 0;
+        while (target < _snapshotBuffers.size() && _snapshotBuffers[target].snapshot.use_count() > 1)
+        {
+            target++;
+        }
+        if (target == _snapshotBuffers.size())
+        {
+            _snapshotBuffers.push_back({ std::make_shared<VisibleSnapshot>() });
+        }
+        SnapshotBuffer& buffer = _snapshotBuffers[target];
+        VisibleSnapshot& snapshot = *buffer.snapshot;
+        
+        if (buffer.stale)
+        {
+            snapshot.objects.clear();
+            snapshot.stateKeys.clear();
+            snapshot.opaqueDraws.clear();
+            snapshot.transparentDraws.clear();
+            bool rebuildSlots = !_snapshotLayoutValid;
+            if (rebuildSlots)
+            {
+                _snapshotSlots.assign(_renderList.objects.size(), INVALID_SNAPSHOT_SLOT);
+            }
+            auto copy_visible = [&](const std::vector<u32>& order, std::vector<u32>& draws)
+            {
+                for (u32 handle: order)
+                {
+                    if (_visibleObjects[handle])
+                    {
+                        if (rebuildSlots)
+                        {
+                            _snapshotSlots[handle] = (u32)snapshot.objects.size();
+                        }
+                        draws.push_back((u32)snapshot.objects.size());
+                        snapshot.objects.push_back(_renderList.objects[handle]);
+                        snapshot.stateKeys.push_back(_renderList.stateKeys[handle]);
+                    }
+                }
+            };
+            copy_visible(_renderList.opaqueOrder, snapshot.opaqueDraws);
+            copy_visible(_renderList.transparentOrder, snapshot.transparentDraws);
+            _snapshotLayoutValid = true;
+        }
+        else
+        {
+            for (u32 handle: buffer.moved)
+            {
+                u32 slot = _snapshotSlots[handle];
+                if (slot != INVALID_SNAPSHOT_SLOT)
+                {
+                    snapshot.objects[slot].transform = _renderList.objects[handle].transform;
+                }
+            }
+        }
+        buffer.moved.clear();
+        buffer.stale = false;
+        _publishedSnapshot = target;
+    }
+    packet.visible = _snapshotBuffers[_publishedSnapshot].snapshot;
+    
+    packet.retiredScenes = std::move(_scenesToRetire);
+    _scenesToRetire.clear();
+    
+    packet.sceneData = this->_sceneData;
+    packet.settings.renderScale = _renderScale;
+    packet.settings.gpuDrivenRendering = _gpuDrivenRendering;
+    packet.settings.cpuFrustumCulling = _cpuFrustumCulling;
+    packet.settings.parallelRecording = _parallelRecording;
+    packet.settings.framesInFlight = (u32)_framesInFlightSetting;
+    packet.settings.presentMode = _presentModeSetting;
+    packet.settings.swapchainImageCount = (u32)_swapchainImageCountSetting;
+    packet.settings.backgroundPipeline = backgroundEffects[currentBackgroundEffect].pipeline;
+    packet.settings.backgroundData = backgroundEffects[currentBackgroundEffect].data;
+    
+    u64 end_ticks = SDL_GetTicksNS();
+    packet.sceneUpdateTime = (float)(end_ticks - start_ticks) / 1000000.0f;
 }
 
 void VulkanEngine::immediate_submit(
                                     std::function<void(VkCommandBuffer cmd)> &&function) {
+    std::lock_guard<std::mutex> immLock(_immMutex);
     
     VK_CHECK(vkResetFences(_device, 1, &_immFence));
     VK_CHECK(vkResetCommandBuffer(_immCommandBuffer, 0));
@@ -1286,8 +2846,11 @@ void VulkanEngine::immediate_submit(
     VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, nullptr, nullptr);
     
     // submit command buffer to the queue and execute it.
-    //  _renderFence will now block until the graphic commands finish execution
-    VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit, _immFence));
+    //  _immFence will now block until the graphic commands finish execution
+    {
+        std::lock_guard<std::mutex> queueLock(_queueMutex);
+        VK_CHECK(vkQueueSubmit2(_graphicsQueue, 1, &submit, _immFence));
+    }
     
     VK_CHECK(vkWaitForFences(_device, 1, &_immFence, true, 9999999999));
 }
@@ -1316,12 +2879,21 @@ void VulkanEngine::destroy_buffer(const AllocatedBuffer &buffer) {
     vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
 }
 
-GPUMeshBuffers VulkanEngine::upload_mesh(const std::vector<u32> &indices,
-                                         std::vector<Vertex> &vertices) {
-    const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
-    const size_t indexBufferSize = indices.size() * sizeof(u32);
+size_t VulkanEngine::vertex_size() const {
+    return _compactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+GPUMeshBuffers VulkanEngine::create_mesh_buffers(u32 vertexCount, u32 indexCount) {
+    GPUMeshBuffers newSurface = {};
+    if (_geometryArena.allocate(vertexCount, indexCount, newSurface)) {
+        return newSurface;
+    }
     
-    GPUMeshBuffers newSurface;
+    // NOTE(champ): the arena is full, this mesh gets its own buffers and will
+    // need its own index buffer bind
+    spdlog::warn("Geometry arena is full, allocating dedicated buffers for a mesh.");
+    const size_t vertexBufferSize = vertexCount * vertex_size();
+    const size_t indexBufferSize = indexCount * sizeof(u32);
     newSurface.vertexBuffer = create_buffer(
                                             vertexBufferSize,
                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
@@ -1339,46 +2911,115 @@ GPUMeshBuffers VulkanEngine::upload_mesh(const std::vector<u32> &indices,
                                            VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                                            VMA_MEMORY_USAGE_GPU_ONLY);
+    newSurface.vertexCount = vertexCount;
+    newSurface.indexCount = indexCount;
+    _dedicatedMeshBuffers += 1;
+    return newSurface;
+}
+
+void VulkanEngine::destroy_mesh_buffers(const GPUMeshBuffers& mesh) {
+    if (mesh.vertexAllocation != VK_NULL_HANDLE) {
+        _geometryArena.free(mesh);
+        return;
+    }
+    destroy_buffer(mesh.indexBuffer);
+    destroy_buffer(mesh.vertexBuffer);
+    _dedicatedMeshBuffers -= 1;
+}
+
+GPUMeshBuffers VulkanEngine::upload_mesh(const std::vector<u32> &indices,
+                                         std::vector<Vertex> &vertices) {
+    const size_t indexBufferSize = indices.size() * sizeof(u32);
+    
+    GPUMeshBuffers newSurface = create_mesh_buffers((u32)vertices.size(), (u32)indices.size());
     
-    // staging buffer to copy contents to GPU only memory
-    AllocatedBuffer staging = create_buffer(vertexBufferSize + indexBufferSize,
-                                            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                            VMA_MEMORY_USAGE_CPU_ONLY);
-    
-    void *data = staging.allocation->GetMappedData();
-    
-    // copy vertex buffer
-    memcpy(data, vertices.data(), vertexBufferSize);
-    // copy index buffer
-    memcpy((char *)data + vertexBufferSize, indices.data(), indexBufferSize);
-    
-    immediate_submit([&](VkCommandBuffer cmd) {
-                         VkBufferCopy vertexCopy{0};
-                         vertexCopy.dstOffset = 0;
-                         vertexCopy.srcOffset = 0;
-                         vertexCopy.size = vertexBufferSize;
-                         
-                         vkCmdCopyBuffer(cmd, staging.buffer, newSurface.vertexBuffer.buffer, 1,
-                                         &vertexCopy);
-                         
-                         VkBufferCopy indexCopy{0};
-                         indexCopy.dstOffset = 0;
-                         indexCopy.srcOffset = vertexBufferSize;
-                         indexCopy.size = indexBufferSize;
-                         
-                         vkCmdCopyBuffer(cmd, staging.buffer, newSurface.indexBuffer.buffer, 1,
-                                         &indexCopy);
-                     });
-    
-    destroy_buffer(staging);
+    std::vector<CompactVertex> compactVertices;
+    _uploader.begin();
+    upload_vertices(newSurface, vertices.data(), (u32)vertices.size(), compactVertices);
+    _uploader.upload_buffer(newSurface.indexBuffer.buffer, newSurface.firstIndex * sizeof(u32),
+                            indices.data(), indexBufferSize);
+    _uploader.wait(_uploader.submit());
     
     return newSurface;
 }
 
+void VulkanEngine::upload_batch(const std::vector<MeshUploadRequest>& meshes,
+                                const std::vector<ImageUploadRequest>& images)
+{
+    // NOTE(champ): everything is recorded into the same upload batch, so a whole
+    // file costs a single wait instead of one GPU round trip per mesh and texture
+    std::vector<CompactVertex> compactVertices;
+    _uploader.begin();
+    for (const MeshUploadRequest& mesh : meshes) {
+        const size_t indexBufferSize = mesh.indexCount * sizeof(u32);
+        *mesh.result = create_mesh_buffers(mesh.vertexCount, mesh.indexCount);
+        
+        upload_vertices(*mesh.result, mesh.vertices, mesh.vertexCount, compactVertices);
+        _uploader.upload_buffer(mesh.result->indexBuffer.buffer, mesh.result->firstIndex * sizeof(u32),
+                                mesh.indices, indexBufferSize);
+    }
+    for (const ImageUploadRequest& image : images) {
+        if (image.mipLevels > 0) {
+            // prebuilt levels, nothing gets blitted so no TRANSFER_SRC (which
+            // BCn formats usually do not support anyway)
+            const size_t imageSize = vkutil::mip_chain_size(image.format, image.size.width,
+                                                            image.size.height, image.mipLevels);
+            *image.result = create_image(image.size, image.format,
+                                         image.usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                         true, image.mipLevels);
+            _uploader.upload_image_levels(*image.result, image.data, imageSize, image.mipLevels);
+            continue;
+        }
+        
+        const size_t imageSize = (size_t)image.size.width * image.size.height * image.size.depth * 4;
+        *image.result = create_image(image.size, image.format,
+                                     image.usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                     image.mipmapped);
+        
+        _uploader.upload_image(*image.result, image.data, imageSize, image.mipmapped);
+    }
+    _uploader.wait(_uploader.submit());
+}
+
+void VulkanEngine::upload_vertices(GPUMeshBuffers& mesh,
+                                   const Vertex* vertices,
+                                   u32 vertexCount,
+                                   std::vector<CompactVertex>& scratch)
+{
+    if (!_compactVertices) {
+        _uploader.upload_buffer(mesh.vertexBuffer.buffer, mesh.vertexOffset * sizeof(Vertex),
+                                vertices, vertexCount * sizeof(Vertex));
+        return;
+    }
+    
+    // NOTE(champ): the staging copy happens right away, so one scratch
+    // buffer serves every mesh of a batch
+    vertex_format::position_bounds(vertices, vertexCount, mesh.positionOrigin, mesh.positionExtents);
+    scratch.resize(vertexCount);
+    vertex_format::compress(vertices, vertexCount, mesh.positionOrigin, mesh.positionExtents, scratch.data());
+#ifndef NDEBUG
+    // NOTE(champ): 16 bit positions are off by at most half a step of the
+    // box, 8 bit octahedral normals by about a degree. Anything past that
+    // means compress and the compact shaders no longer agree
+    float positionError = 0.0f;
+    float normalError = 0.0f;
+    vertex_format::round_trip_error(vertices, scratch.data(), vertexCount,
+                                    mesh.positionOrigin, mesh.positionExtents,
+                                    positionError, normalError);
+    if (positionError > 1.0f / 32767.0f || normalError > 0.03f) {
+        spdlog::warn("Compact vertices lose too much precision: position error {}, normal error {}",
+                     positionError, normalError);
+    }
+#endif
+    _uploader.upload_buffer(mesh.vertexBuffer.buffer, mesh.vertexOffset * sizeof(CompactVertex),
+                            scratch.data(), vertexCount * sizeof(CompactVertex));
+}
+
 AllocatedImage VulkanEngine::create_image(VkExtent3D size,
                                           VkFormat format,
                                           VkImageUsageFlags usage,
-                                          bool mipmapped)
+                                          bool mipmapped,
+                                          u32 mipLevels)
 {
     AllocatedImage newImage = {};
     newImage.imageFormat = format;
@@ -1386,7 +3027,8 @@ AllocatedImage VulkanEngine::create_image(VkExtent3D size,
     
     VkImageCreateInfo imageCI = vkinit::image_create_info(format, usage, size);
     if (mipmapped) {
-        imageCI.mipLevels = static_cast<u32>(std::floor(std::log2(std::max(size.height, size.width)))) + 1;
+        u32 fullChain = static_cast<u32>(std::floor(std::log2(std::max(size.height, size.width)))) + 1;
+        imageCI.mipLevels = mipLevels > 0 ? std::min(mipLevels, fullChain) : fullChain;
     }
     
     VmaAllocationCreateInfo allocationCI = {};
@@ -1415,40 +3057,13 @@ AllocatedImage VulkanEngine::create_image(void* data,
                                           bool mipmapped)
 {
     size_t dataSize = size.depth * size.width * size.height * 4;
-    AllocatedBuffer stagingBuffer = create_buffer(dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-    
-    memcpy(stagingBuffer.info.pMappedData, data, dataSize);
     
     AllocatedImage newImage = create_image(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, mipmapped);
     
-    immediate_submit([&](VkCommandBuffer cmd)
-                     {
-                         vkutil::transition_image(cmd, newImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-                         
-                         VkBufferImageCopy copyRegion = {};
-                         copyRegion.bufferOffset = 0;
-                         copyRegion.bufferRowLength = 0;
-                         copyRegion.bufferImageHeight = 0;
-                         copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                         copyRegion.imageSubresource.mipLevel = 0;
-                         copyRegion.imageSubresource.baseArrayLayer = 0;
-                         copyRegion.imageSubresource.layerCount = 1;
-                         copyRegion.imageExtent = size;
-                         
-                         vkCmdCopyBufferToImage(cmd, stagingBuffer.buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-                         
-                         if (mipmapped)
-                         {
-                             vkutil::generate_mipmaps(cmd, newImage.image,
-                                                      VkExtent2D{newImage.imageExtent.width, newImage.imageExtent.height});
-                         }
-                         else
-                         {
-                             vkutil::transition_image(cmd, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-                         }
-                     });
-    
-    destroy_buffer(stagingBuffer);
+    _uploader.begin();
+    _uploader.upload_image(newImage, data, dataSize, mipmapped);
+    _uploader.wait(_uploader.submit());
+    
     return newImage;
 }
 
@@ -1458,58 +3073,135 @@ void VulkanEngine::destroy_image(const AllocatedImage& image)
     vmaDestroyImage(_allocator, image.image, image.allocation);
 }
 
+bool VulkanEngine::read_back_frame(std::vector<u8>& pixels)
+{
+    if (!_headless || _frameNumber == 0)
+    {
+        spdlog::error("There is no headless frame to read back!");
+        return false;
+    }
+    
+    // NOTE(champ): the last submitted frame, wait for it to be finished on
+    // the GPU so its readback buffer holds the final image
+    FrameData& lastFrame = _frames[(_frameNumber - 1) % _framesInFlight];
+    wait_frame_timeline(lastFrame._timelineValue);
+    
+    const size_t size = (size_t)_swapchainExtent.width * _swapchainExtent.height * 4;
+    VK_CHECK(vmaInvalidateAllocation(_allocator, lastFrame._readbackBuffer.allocation,
+                                     0, VK_WHOLE_SIZE));
+    pixels.resize(size);
+    memcpy(pixels.data(), lastFrame._readbackBuffer.info.pMappedData, size);
+    return true;
+}
+
+bool VulkanEngine::save_frame_ppm(const char* path)
+{
+    std::vector<u8> pixels;
+    if (!read_back_frame(pixels))
+    {
+        return false;
+    }
+    
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr)
+    {
+        spdlog::error("Failed to open {} for writing!", path);
+        return false;
+    }
+    
+    // NOTE(champ): binary PPM is trivial to write and every image diff tool
+    // can read it, good enough for golden image comparisons
+    fprintf(file, "P6\n%u %u\n255\n", _swapchainExtent.width, _swapchainExtent.height);
+    const size_t pixelCount = (size_t)_swapchainExtent.width * _swapchainExtent.height;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        fwrite(&pixels[i * 4], 1, 3, file);
+    }
+    fclose(file);
+    
+    spdlog::info("Saved frame to {}", path);
+    return true;
+}
+
 void VulkanEngine::cleanup()
 {
     if (_isInitialized) {
+        // background loads still use the device, let them finish first
+        for (auto& load : _pendingSceneLoads) {
+            load->result.wait();
+        }
+        _pendingSceneLoads.clear();
+        
         // make sure the GPU has stopped doing its work
         vkDeviceWaitIdle(_device);
+        stop_latency_thread();
         
+        // the device is idle, every retired scene can go
+        for (FramePacket& packet : _framePackets) {
+            packet.retiredScenes.clear();
+        }
+        _scenesToRetire.clear();
+        destroy_retired_scenes(UINT64_MAX);
         loadedScenes.clear();
         
         spdlog::info("Destroying the application!");
         
         for (auto &frame : _frames) {
             vkDestroyCommandPool(_device, frame._commandPool, nullptr);
-            vkDestroyFence(_device, frame._renderFence, nullptr);
+            for (VkCommandPool pool : frame._recordPools) {
+                vkDestroyCommandPool(_device, pool, nullptr);
+            }
             vkDestroySemaphore(_device, frame._swapchainSemaphore, nullptr);
+            vkDestroyQueryPool(_device, frame._timestampPool, nullptr);
+            destroy_indirect_buffers(frame);
             
             frame._deletionQueue.flush();
         }
         
         for (auto &mesh : _testMeshes) {
-            destroy_buffer(mesh->meshBuffers.indexBuffer);
-            destroy_buffer(mesh->meshBuffers.vertexBuffer);
+            destroy_mesh_buffers(mesh->meshBuffers);
         }
         
         _mainDeletionQueue.flush();
         
-        for (auto &semaphore : _submitSemaphores) {
-            vkDestroySemaphore(_device, semaphore, nullptr);
+        if (!_headless)
+        {
+            wait_present_fences();
+            destroy_retired_swapchains(UINT64_MAX);
+            destroy_swapchain();
+            vkDestroySurfaceKHR(_instance, _surface, nullptr);
         }
-        _submitSemaphores.clear();
-        
-        destroy_swapchain();
-        vkDestroySurfaceKHR(_instance, _surface, nullptr);
         vkDestroyDevice(_device, nullptr);
         
         vkb::destroy_debug_utils_messenger(_instance, _debugMessenger);
         
         vkDestroyInstance(_instance, nullptr);
-        SDL_DestroyWindow(_window);
+        if (_window)
+        {
+            SDL_DestroyWindow(_window);
+        }
     }
     
+    _jobSystem.shutdown();
+    
     // clear engine pointer
     loadedEngine = nullptr;
 }
 
 FrameData &VulkanEngine::get_current_frame() {
-    return _frames[_frameNumber % FRAME_OVERLAP];
+    return _frames[_frameNumber % _framesInFlight];
 }
 
 void GLTFMetallic_Roughness::build_pipelines(VulkanEngine* engine)
 {
+    // NOTE(champ): the compact variants only differ in how they fetch and
+    // unpack the vertices, the rest of the pipelines is shared
+    const char* meshVertPath = engine->_compactVertices ? "shaders/mesh_compact.vert.spv" : "shaders/mesh.vert.spv";
+    const char* meshIndirectVertPath = engine->_compactVertices
+        ? "shaders/mesh_indirect_compact.vert.spv" : "shaders/mesh_indirect.vert.spv";
+    
     VkShaderModule meshVertShader;
-    if (!vkutil::load_shader_module("shaders/mesh.vert.spv", engine->_device, &meshVertShader)){
+    if (!vkutil::load_shader_module(meshVertPath, engine->_device, &meshVertShader)){
         spdlog::error("Failed to build the mesh vertex shader module!");
     }
     VkShaderModule meshFragShader;
@@ -1565,9 +3257,42 @@ void GLTFMetallic_Roughness::build_pipelines(VulkanEngine* engine)
     
     _transparentPipeline.pipeline = pipelineBuilder.build_pipeline(engine->_device);
     
+    // @SECTION: GPU driven variant, opaque only
+    VkShaderModule meshIndirectVertShader;
+    if (!vkutil::load_shader_module(meshIndirectVertPath, engine->_device, &meshIndirectVertShader)){
+        spdlog::error("Failed to build the indirect mesh vertex shader module!");
+    }
+    
+    VkPushConstantRange objectRange = {};
+    objectRange.offset = 0;
+    objectRange.size = sizeof(GPUIndirectPushConstants);
+    objectRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    
+    VkPipelineLayoutCreateInfo indirectLayoutCI = meshLayoutCI;
+    indirectLayoutCI.pPushConstantRanges = &objectRange;
+    
+    VkPipelineLayout indirectLayout;
+    VK_CHECK(vkCreatePipelineLayout(engine->_device, &indirectLayoutCI, nullptr, &indirectLayout));
+    _opaqueIndirectPipeline.pipelineLayout = indirectLayout;
+    
+    pipelineBuilder.set_shaders(meshIndirectVertShader, meshFragShader);
+    pipelineBuilder.disable_blending();
+    pipelineBuilder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+    pipelineBuilder._pipelineLayout = indirectLayout;
+    
+    _opaqueIndirectPipeline.pipeline = pipelineBuilder.build_pipeline(engine->_device);
+    
+    VkDevice device = engine->_device;
+    VkPipeline indirectPipeline = _opaqueIndirectPipeline.pipeline;
+    engine->_mainDeletionQueue.push_function([=]() {
+                                                 vkDestroyPipelineLayout(device, indirectLayout, nullptr);
+                                                 vkDestroyPipeline(device, indirectPipeline, nullptr);
+                                             });
+    
     // cleanup
     vkDestroyShaderModule(engine->_device, meshVertShader, nullptr);
     vkDestroyShaderModule(engine->_device, meshFragShader, nullptr);
+    vkDestroyShaderModule(engine->_device, meshIndirectVertShader, nullptr);
 }
 
 MaterialInstance GLTFMetallic_Roughness::write_material(VkDevice device,
@@ -1584,11 +3309,12 @@ MaterialInstance GLTFMetallic_Roughness::write_material(VkDevice device,
     }
     matData.materialSet = desciptorAllocator.allocate(device, _materialLayout);
     
-    _writer.clear();
-    _writer.write_buffer(0, resources.dataBuffer, sizeof(MaterialConstants), resources.dataBufferOffset, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-    _writer.write_image(1, resources.colorImage.imageView, resources.colorSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-    _writer.write_image(2, resources.metalRoughImage.imageView, resources.metalRoughSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-    _writer.update_set(device, matData.materialSet);
+    // NOTE(champ): local writer, materials get written from the loading threads
+    DescriptorWriter writer;
+    writer.write_buffer(0, resources.dataBuffer, sizeof(MaterialConstants), resources.dataBufferOffset, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    writer.write_image(1, resources.colorImage.imageView, resources.colorSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    writer.write_image(2, resources.metalRoughImage.imageView, resources.metalRoughSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    writer.update_set(device, matData.materialSet);
     
     return matData;
 }
@@ -1596,72 +3322,111 @@ MaterialInstance GLTFMetallic_Roughness::write_material(VkDevice device,
 void MeshNode::draw(const glm::mat4& topMatrix,
                     DrawContext& context)
 {
-    glm::mat4 nodeMatrix = topMatrix * this->worldTransform;
-    
-    for (auto s: this->mesh->surfaces) {
-        RenderObject obj;
-        obj.firstIndex = s.startIndex;
-        obj.indexCount = s.count;
-        obj.indexBuffer = this->mesh->meshBuffers.indexBuffer.buffer;
-        obj.material = &s.material->data;
-        obj.transform = nodeMatrix;
-        obj.vertexBufferAddr = this->mesh->meshBuffers.vertexBufferAddress;
-        obj.bounds = s.bounds;
-        
-        if (s.material->data.passType == MaterialPass::GLTF_PBR_TRANSPARENT)
-        {
-            context.transparentSurfaces.push_back(obj);
-        }
-        else
-        {
-            context.opaqueSurfaces.push_back(obj);
-        }
+    glm::mat4 nodeMatrix = topMatrix * this->world_transform();
+    
+    for (u32 i = 0; i < this->mesh->surfaces.size(); i++) {
+        draw_mesh_surface(*this->mesh, i, nodeMatrix, context);
     }
     
     Node::draw(topMatrix,context);
 }
 
-static bool
-is_renderobj_visible(const RenderObject& obj,glm::mat4& viewproj)
+RenderObject make_render_object(const MeshAsset& mesh,
+                                u32 surface,
+                                const glm::mat4& transform)
 {
-    glm::vec3 corners[] = {
-        glm::vec3 { 1, 1, 1 },
-        glm::vec3 { 1, 1, -1 },
-        glm::vec3 { 1, -1, 1 },
-        glm::vec3 { 1, -1, -1 },
-        glm::vec3 { -1, 1, 1 },
-        glm::vec3 { -1, 1, -1 },
-        glm::vec3 { -1, -1, 1 },
-        glm::vec3 { -1, -1, -1 },
-    };
-    
-    glm::mat4 matrix = viewproj * obj.transform;
-    glm::vec3 min = {1.5, 1.5, 1.5};
-    glm::vec3 max = {-1.5, -1.5, -1.5};
-    
-    // NOTE(champ): project each corner of the view frustum into clip space
-    for (int i = 0; i < 8; i++)
+    const GeoSurface& s = mesh.surfaces[surface];
+    
+    RenderObject obj;
+    obj.firstIndex = mesh.meshBuffers.firstIndex + s.startIndex;
+    obj.indexCount = s.count;
+    obj.vertexOffset = mesh.meshBuffers.vertexOffset;
+    obj.indexBuffer = mesh.meshBuffers.indexBuffer.buffer;
+    obj.material = &s.material->data;
+    obj.transform = transform;
+    obj.vertexBufferAddr = mesh.meshBuffers.vertexBufferAddress;
+    obj.positionOrigin = mesh.meshBuffers.positionOrigin;
+    obj.positionExtents = mesh.meshBuffers.positionExtents;
+    obj.bounds = s.bounds;
+    return obj;
+}
+
+void emit_render_object(const RenderObject& obj,
+                        DrawContext& context)
+{
+    if (obj.material->passType == MaterialPass::GLTF_PBR_TRANSPARENT)
     {
-        glm::vec4 v = matrix * glm::vec4(obj.bounds.origin + (corners[i] * obj.bounds.extents), 1.0f);
-        
-        // perspective correction using the w component
-        v.x /= v.w;
-        v.y /= v.w;
-        v.z /= v.w;
-        
-        min = glm::min(min, glm::vec3{v});
-        max = glm::max(max, glm::vec3{v});
+        context.transparentSurfaces.push_back(obj);
     }
-    
-    // NOTE(champ): check if the clip space box is within the view
-    if (min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f)
+    else
     {
-        return false;
+        context.opaqueSurfaces.push_back(obj);
     }
-    else
+}
+
+void draw_mesh_surface(const MeshAsset& mesh,
+                       u32 surface,
+                       const glm::mat4& transform,
+                       DrawContext& context)
+{
+    emit_render_object(make_render_object(mesh, surface, transform), context);
+}
+
+std::shared_ptr<gltf::AsyncSceneLoad>
+VulkanEngine::load_scene_async(const std::string& name,
+                               const std::string& path)
+{
+    for (const auto& load : _pendingSceneLoads)
     {
-        return true;
+        if (load->name == name)
+        {
+            return load;
+        }
     }
+    
+    spdlog::info("Started loading {} in the background.", path);
+    std::shared_ptr<gltf::AsyncSceneLoad> load = gltf::load_scene_async(this, name, path);
+    _pendingSceneLoads.push_back(load);
+    return load;
+}
+
+void
+VulkanEngine::finish_scene_loads()
+{
+    for (size_t i = 0; i < _pendingSceneLoads.size();)
+    {
+        std::shared_ptr<gltf::AsyncSceneLoad> load = _pendingSceneLoads[i];
+        if (!load->is_ready())
+        {
+            i++;
+            continue;
+        }
+        
+        auto scene = load->result.get();
+        if (scene.has_value())
+        {
+            // NOTE(champ): a scene with the same name may still be used by
+            // frames in flight, only happens when reloading a model
+            auto existing = loadedScenes.find(load->name);
+            if (existing != loadedScenes.end() && existing->second)
+            {
+                retire_scene(existing->second);
+            }
+            loadedScenes[load->name] = *scene;
+        }
+        else
+        {
+            spdlog::warn("Failed to load GLTF file at: {}!", load->path);
+        }
+        _pendingSceneLoads.erase(_pendingSceneLoads.begin() + i);
+    }
+}
+
+void
+VulkanEngine::retire_scene(const std::shared_ptr<gltf::LoadedScene>& scene)
+{
+    scene->unregister();
+    _scenesToRetire.push_back(scene);
 }
 
 void
@@ -4,8 +4,47 @@
 #include "core/types.h"
 #include "vk_descriptors.h"
 #include "core/camera.h"
+#include "core/benchmark.h"
+#include "core/job_system.h"
+#include "core/vk_upload.h"
+#include "core/geometry_arena.h"
+#include "core/texture_cache.h"
+#include "core/culling.h"
+#include "core/render_list.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
-constexpr u32 FRAME_OVERLAP = 2;
+struct ImDrawData;
+struct ImDrawList;
+
+// NOTE(champ): upper bound of the frames in flight setting, the per frame
+// resources are created for all of them so the setting can change at runtime
+constexpr u32 MAX_FRAMES_IN_FLIGHT = 4;
+
+// NOTE(champ): present modes that can be picked at runtime, in the order the
+// UI lists them. FIFO is the only one every device supports, the others fall
+// back to the closest supported one, see choose_present_mode
+constexpr VkPresentModeKHR PRESENT_MODES[] = {
+    VK_PRESENT_MODE_FIFO_KHR,
+    VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+    VK_PRESENT_MODE_MAILBOX_KHR,
+    VK_PRESENT_MODE_IMMEDIATE_KHR,
+};
+constexpr u32 PRESENT_MODE_COUNT = sizeof(PRESENT_MODES) / sizeof(PRESENT_MODES[0]);
+// short names used by the UI and --present-mode, "fifo", "mailbox", ...
+const char* present_mode_name(VkPresentModeKHR mode);
+bool parse_present_mode(const char* name, VkPresentModeKHR* mode);
+
+// NOTE(champ): GPU timestamps written around each pass of a frame
+enum GPUTimestamp : u32 {
+    TIMESTAMP_FRAME_BEGIN = 0,
+    TIMESTAMP_BACKGROUND_END,
+    TIMESTAMP_GEOMETRY_END,
+    TIMESTAMP_BLIT_END,
+    TIMESTAMP_IMGUI_END,
+    TIMESTAMP_COUNT,
+};
 
 struct EngineStats
 {
@@ -13,18 +52,87 @@ struct EngineStats
     int   triangle_count;
     int   drawcall_count;
     float scene_update_time;
+    // BVH nodes tested by update_scene over all the scenes, 0 when last
+    // frame's visibility was reused
+    int   bvh_visited_nodes;
+    // scene graph nodes whose world transform was recomputed
+    int   changed_nodes;
     float mesh_draw_time;
+    // CPU frustum culling, part of mesh_draw_time
+    float culling_time;
+    // building and radix sorting the draw keys, part of mesh_draw_time
+    float sort_time;
+    // recording the draws of the geometry pass, part of mesh_draw_time, and
+    // how many secondary command buffers it was split over (1 when inline)
+    float record_time;
+    int   record_chunks;
+    
+    // binds recorded by draw_geometry in the last frame
+    int   pipeline_binds;
+    int   material_binds;
+    int   index_buffer_binds;
+    
+    // GPU times in miliseconds, these lag frames in flight frames behind since
+    // they are only read once the frame's timeline value has been waited on
+    float gpu_frame_time;
+    float gpu_background_time;
+    float gpu_geometry_time;
+    float gpu_blit_time;
+    float gpu_imgui_time;
+    
+    // opaque objects handed to the culling shader and how many of them it
+    // kept, and their triangles. The last two are read back frames in
+    // flight frames late, triangle_count adds that triangle count
+    int   gpu_culled_input;
+    int   gpu_visible_objects;
+    int   gpu_visible_triangles;
+    
+    // latency in miliseconds, from the oldest input event of a frame to its
+    // queue submit, and from that submit to the GPU finishing the frame, the
+    // second one lags a few frames behind
+    float input_to_submit;
+    float submit_to_gpu_done;
+    int   frames_in_flight;
+    // VkPresentModeKHR the swapchain actually uses, 0 images when headless
+    int   present_mode;
+    int   swapchain_image_count;
 };
 
 struct FrameData {
     VkCommandPool _commandPool;
     VkCommandBuffer _mainCommandBuffer;
     
+    // NOTE(champ): one pool and secondary command buffer per recording
+    // thread, draw_geometry records chunks of the draw list into them
+    std::vector<VkCommandPool> _recordPools;
+    std::vector<VkCommandBuffer> _recordBuffers;
+    
     VkSemaphore _swapchainSemaphore;
-    VkFence _renderFence;
+    // value of the engine's frame timeline signaled by the last submit of this
+    // frame, 0 before the first one
+    u64 _timelineValue = 0;
+    
+    VkQueryPool _timestampPool;
+    bool _timestampsWritten;
     
     DeletionQueue _deletionQueue;
     DescriptorAllocatorGrowable _frameDescriptors;
+    
+    // NOTE(champ): only used when running headless, the draw image is copied
+    // here at the end of the frame so it can be read by the CPU
+    AllocatedBuffer _readbackBuffer;
+    
+    // NOTE(champ): GPU driven path, grown at the start of the frame when the
+    // scene does not fit anymore. The object buffer is persistently mapped,
+    // the command and count buffers are only written by cull_objects.comp
+    AllocatedBuffer _objectBuffer;
+    AllocatedBuffer _drawCommandBuffer;
+    AllocatedBuffer _drawCountBuffer;
+    AllocatedBuffer _drawCountReadback;
+    u32 _objectCapacity = 0;
+    u32 _batchCapacity = 0;
+    // batches recorded by the last use of this frame, 0 when nothing was culled
+    u32 _indirectBatchCount = 0;
 };
 
 struct ComputePushConstancts {
@@ -44,6 +152,9 @@ struct ComputeEffect {
 struct GLTFMetallic_Roughness {
     MaterialPipeline _opaquePipeline;
     MaterialPipeline _transparentPipeline;
+    // same sets as the opaque pipeline, but the vertex shader reads the
+    // object buffer instead of per draw push constants
+    MaterialPipeline _opaqueIndirectPipeline;
     VkDescriptorSetLayout _materialLayout;
     
     struct MaterialConstants {
@@ -61,8 +172,6 @@ struct GLTFMetallic_Roughness {
         u32 dataBufferOffset;
     };
     
-    DescriptorWriter _writer;
-    
     void build_pipelines(VulkanEngine* engine);
     void clear_resources(VkDevice device);
     MaterialInstance write_material(VkDevice device,
@@ -74,13 +183,25 @@ struct GLTFMetallic_Roughness {
 struct RenderObject {
     u32 indexCount;
     u32 firstIndex;
+    i32 vertexOffset;
     VkBuffer indexBuffer;
     MaterialInstance* material;
     glm::mat4 transform;
     VkDeviceAddress vertexBufferAddr;
+    glm::vec4 positionOrigin;
+    glm::vec4 positionExtents;
     Bounds bounds;
 };
 
+// NOTE(champ): consecutive opaque objects sharing a material. Each one owns
+// objectCount commands starting at commandOffset, the culling shader packs the
+// visible ones at the start and writes how many there are in the count buffer
+struct IndirectBatch {
+    MaterialInstance* material;
+    u32 commandOffset;
+    u32 objectCount;
+};
+
 struct DrawContext {
     std::vector<RenderObject> opaqueSurfaces;
     std::vector<RenderObject> transparentSurfaces;
@@ -92,17 +213,143 @@ struct MeshNode : public Node {
     virtual void draw(const glm::mat4& topMatrix, DrawContext& context) override;
 };
 
-static bool is_renderobj_visible(const RenderObject& obj,glm::mat4& viewproj);
+RenderObject make_render_object(const MeshAsset& mesh, u32 surface, const glm::mat4& transform);
+// adds obj to the opaque or transparent list depending on its material
+void emit_render_object(const RenderObject& obj, DrawContext& context);
+// adds one RenderObject for a surface of mesh to the opaque or transparent list
+void draw_mesh_surface(const MeshAsset& mesh, u32 surface, const glm::mat4& transform, DrawContext& context);
+
+// NOTE(champ): CPU side data gathered by the loaders so all of it can be
+// uploaded with a single submit, see VulkanEngine::upload_batch. The data is
+// only read while recording, it can point straight into a mapped file
+struct MeshUploadRequest {
+    const u32* indices;
+    u32 indexCount;
+    const Vertex* vertices;
+    u32 vertexCount;
+    GPUMeshBuffers* result;
+};
+
+// NOTE(champ): with mipLevels at 0 data is the base level and mipmapped
+// builds the other levels on the GPU. Otherwise data holds mipLevels levels
+// packed largest first, like compressed textures come prebuilt
+struct ImageUploadRequest {
+    const void* data;
+    VkExtent3D size;
+    VkFormat format;
+    VkImageUsageFlags usage;
+    bool mipmapped;
+    u32 mipLevels;
+    AllocatedImage* result;
+};
+
+// NOTE(champ): deep copy of the ImGui draw data of a frame. The main thread
+// starts building the next UI while the render thread still draws this one,
+// so the render thread can not use ImGui::GetDrawData
+struct ImGuiFrameSnapshot {
+    ImGuiFrameSnapshot() = default;
+    ImGuiFrameSnapshot(const ImGuiFrameSnapshot&) = delete;
+    ImGuiFrameSnapshot& operator=(const ImGuiFrameSnapshot&) = delete;
+    ~ImGuiFrameSnapshot();
+    
+    // null or invalid source leaves the snapshot empty
+    void capture(const ImDrawData* source);
+    void clear();
+    
+    // null when there is nothing to draw
+    ImDrawData* drawData = nullptr;
+    
+    private:
+    std::vector<ImDrawList*> lists;
+};
+
+// the values the UI can change that the render thread reads
+struct FrameSettings {
+    float renderScale;
+    bool gpuDrivenRendering;
+    bool cpuFrustumCulling;
+    bool parallelRecording;
+    u32 framesInFlight;
+    // the swapchain is recreated when these differ from what it was built with
+    VkPresentModeKHR presentMode;
+    u32 swapchainImageCount;
+    VkPipeline backgroundPipeline;
+    ComputePushConstancts backgroundData;
+};
+
+// NOTE(champ): everything the render thread needs to record a frame. The
+// main thread fills one with update_scene while the render thread draws the
+// other, and never touches a packet again once it was handed over until the
+// render thread is done with it.
+constexpr u32 FRAME_PACKET_COUNT = 2;
+
+// NOTE(champ): the visible objects copied out of the render list, opaqueDraws
+// and transparentDraws index objects and keep the render list order. Never
+// changed while a packet holds it, packets share the same one for as long as
+// nothing in it changed
+struct VisibleSnapshot {
+    std::vector<RenderObject> objects;
+    std::vector<u64> stateKeys;
+    std::vector<u32> opaqueDraws;
+    std::vector<u32> transparentDraws;
+};
+
+struct FramePacket {
+    GPUSceneData sceneData;
+    FrameSettings settings;
+    VkExtent2D windowExtent;
+    
+    std::shared_ptr<const VisibleSnapshot> visible;
+    // scenes the main thread took out of loadedScenes since the last packet,
+    // the render thread keeps them until the frames already submitted are done
+    std::vector<std::shared_ptr<gltf::LoadedScene>> retiredScenes;
+    
+    // SDL_GetTicksNS of the oldest input event handled for this packet, or of
+    // the event poll when there was none
+    u64 inputTicks;
+    
+    // main thread timings, copied into the stats when the packet is drawn
+    float frameTime;
+    float sceneUpdateTime;
+    int bvhVisitedNodes;
+    int changedNodes;
+    
+    ImGuiFrameSnapshot imgui;
+};
 
 struct VulkanEngine {
     static VulkanEngine &Get();
-    void init(int w, int h, const char *title, bool useValidationLayers);
-    void update_scene();
+    void init(int w, int h, const char *title, bool useValidationLayers,
+              bool headless = false);
+    void update_scene(FramePacket& packet);
     void run();
+    void run_headless(u32 frameCount);
+    // updates the scene and renders it on the calling thread, used by the
+    // headless and benchmark modes
     void draw();
-    void draw_background(VkCommandBuffer cmd);
-    void draw_geometry(VkCommandBuffer cmd);
-    void draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView);
+    void render_frame(FramePacket& packet);
+    void draw_background(VkCommandBuffer cmd, const FramePacket& packet);
+    void draw_geometry(VkCommandBuffer cmd, const FramePacket& packet);
+    void cull_objects(VkCommandBuffer cmd, const FramePacket& packet, const std::vector<u32>& opaqueDraws);
+    void draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView, ImDrawData* drawData);
+    
+    // NOTE(champ): run() pipelines frames over two threads, the main thread
+    // handles events, the UI and update_scene for frame N+1 while the render
+    // thread records and submits frame N
+    void start_render_thread();
+    void stop_render_thread();
+    void render_thread_loop();
+    // waits until the render thread is done with the next packet to fill
+    FramePacket& begin_frame_packet();
+    // hands the packet returned by begin_frame_packet to the render thread
+    void submit_frame_packet();
+    // copies stats for published_stats, called by the thread rendering at
+    // the end of a frame
+    void publish_stats();
+    // the stats of the last rendered frame, safe to call from any thread
+    EngineStats published_stats();
+    // size of the window, only call it from the main thread
+    VkExtent2D window_extent();
     void cleanup();
     
     // Vulkan resources initialization
@@ -114,25 +361,63 @@ struct VulkanEngine {
     void init_pipelines();
     void init_background_pipeline();
     void init_mesh_pipeline();
+    void init_cull_pipeline();
     void init_imgui();
     void init_default_data();
-    void create_swapchain(u32 w, u32 h);
-    void resize_swapchain();
+    void init_headless_target();
+    void create_swapchain(u32 w, u32 h, VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+    void resize_swapchain(VkExtent2D windowExtent);
     
     void destroy_swapchain();
+    // destroys the retired swapchains the GPU and the presents are done with
+    void destroy_retired_swapchains(u64 completedTimelineValue);
+    VkFence acquire_present_fence();
+    // puts the signaled fences back in the free list, true once none is left
+    bool recycle_present_fences(std::vector<VkFence>& fences);
+    // blocks until every present fence signaled, then destroys the free ones
+    void wait_present_fences();
+    // drops the retired scenes the GPU is done with
+    void destroy_retired_scenes(u64 completedTimelineValue);
+    void read_gpu_timestamps(FrameData& frame);
+    void read_visible_object_count(FrameData& frame);
+    void reserve_indirect_buffers(FrameData& frame, u32 objectCount, u32 batchCount);
+    void destroy_indirect_buffers(FrameData& frame);
     FrameData &get_current_frame();
+    // blocks until the GPU reached value on the frame timeline
+    void wait_frame_timeline(u64 value);
+    // waits for every frame in flight and switches to count of them
+    void set_frames_in_flight(u32 count);
+    // NOTE(champ): times when each submitted frame finishes on the GPU
+    // without holding up the render thread
+    void start_latency_thread();
+    void stop_latency_thread();
+    void latency_thread_loop();
+    // measures input to submit and queues the frame for the latency thread
+    void track_submit_latency(const FramePacket& packet, u64 timelineValue);
     void immediate_submit(std::function<void(VkCommandBuffer cmd)> &&function);
     AllocatedBuffer create_buffer(size_t allocSize, 
                                   VkBufferUsageFlags usage,
                                   VmaMemoryUsage memoryUsage);
     void destroy_buffer(const AllocatedBuffer &buffer);
+    // sizeof(Vertex) or sizeof(CompactVertex)
+    size_t vertex_size() const;
+    GPUMeshBuffers create_mesh_buffers(u32 vertexCount, u32 indexCount);
+    void destroy_mesh_buffers(const GPUMeshBuffers& mesh);
     GPUMeshBuffers upload_mesh(const std::vector<u32> &indices,
                                std::vector<Vertex> &vertices);
+    void upload_batch(const std::vector<MeshUploadRequest>& meshes,
+                      const std::vector<ImageUploadRequest>& images);
+    // records the copy of the vertices of mesh, compressed first when
+    // _compactVertices is set
+    void upload_vertices(GPUMeshBuffers& mesh, const Vertex* vertices, u32 vertexCount,
+                         std::vector<CompactVertex>& scratch);
     
+    // mipLevels overrides the full chain of a mipmapped image when not 0
     AllocatedImage create_image(VkExtent3D size,
                                 VkFormat format,
                                 VkImageUsageFlags usage,
-                                bool mipmapped = false);
+                                bool mipmapped = false,
+                                u32 mipLevels = 0);
     AllocatedImage create_image(void* data,
                                 VkExtent3D size,
                                 VkFormat format,
@@ -140,9 +425,18 @@ struct VulkanEngine {
                                 bool mipmapped = false);
     void destroy_image(const AllocatedImage& image);
     void load_gltf_filepaths_in_folder(const std::string& directory);
+    std::shared_ptr<gltf::AsyncSceneLoad> load_scene_async(const std::string& name,
+                                                           const std::string& path);
+    void finish_scene_loads();
+    // takes the scene out of the render list now and hands it to the render
+    // thread with the next packet, see FramePacket::retiredScenes
+    void retire_scene(const std::shared_ptr<gltf::LoadedScene>& scene);
+    bool read_back_frame(std::vector<u8>& pixels);
+    bool save_frame_ppm(const char* path);
     
     
     bool _useValidationLayers = false;
+    bool _headless = false;
     bool _isInitialized = false;
     bool _resizeRequested = false;
     int _frameNumber = 0;
@@ -154,22 +448,79 @@ struct VulkanEngine {
     VkInstance _instance;
     VkDebugUtilsMessengerEXT _debugMessenger;
     VkPhysicalDevice _physicalDevice;
+    VkPhysicalDeviceProperties _gpuProperties;
     VkDevice _device;
-    VkSurfaceKHR _surface;
+    VkSurfaceKHR _surface = VK_NULL_HANDLE;
     VkSwapchainKHR _swapchain;
     VkFormat _swapchainImageFormat;
     std::vector<VkImage> _swapchainImages;
     std::vector<VkImageView> _swapchainImageViews;
     VkExtent2D _swapchainExtent;
+    // what the swapchain was built with, the present mode may be a fallback
+    // of the requested one and the image count is clamped by the surface
+    VkPresentModeKHR _requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    u32 _requestedImageCount = 0;
+    VkPresentModeKHR _presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    // NOTE(champ): a recreated swapchain is built from the old one, which
+    // is kept with its views and semaphores until the frames that presented
+    // to it are done instead of idling the whole device
+    struct RetiredSwapchain {
+        VkSwapchainKHR swapchain;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkSemaphore> submitSemaphores;
+        std::vector<VkFence> presentFences;
+        u64 timelineValue;
+    };
+    std::vector<RetiredSwapchain> _retiredSwapchains;
+    // NOTE(champ): only with VK_EXT_swapchain_maintenance1, one fence per
+    // present to the current swapchain that is not known to be done yet
+    bool _presentFencesSupported = false;
+    std::vector<VkFence> _presentFences;
+    std::vector<VkFence> _freePresentFences;
+    // NOTE(champ): same idea for scenes, the frames up to timelineValue may
+    // still read their buffers, images and descriptor sets
+    struct RetiredScene {
+        std::shared_ptr<gltf::LoadedScene> scene;
+        u64 timelineValue;
+    };
+    std::vector<RetiredScene> _retiredScenes;
     VkQueue _graphicsQueue;
     u32 _graphicsQueueFamily;
+    // same as the graphics queue when no separate transfer family exists
+    VkQueue _transferQueue;
+    u32 _transferQueueFamily;
+    bool _useTransferQueue = true;
+    // NOTE(champ): enabled when the device has it, compressed textures are
+    // only used if so and loads fall back to decoding the source images
+    bool _textureCompressionBC = false;
+    // NOTE(champ): meshes are stored as CompactVertex and drawn with the
+    // compact shader variants. Has to be set before init, the arena and the
+    // pipelines are built for one layout
+    bool _compactVertices = false;
+    // size of the geometry arena in vertices and indices, set before init
+    u32 _arenaVertexCount = ARENA_DEFAULT_VERTICES;
+    u32 _arenaIndexCount = ARENA_DEFAULT_INDICES;
+    u32 _timestampValidBits = 0;
     
-    FrameData _frames[FRAME_OVERLAP];
+    FrameData _frames[MAX_FRAMES_IN_FLIGHT];
+    // NOTE(champ): how many frames the CPU records ahead of the GPU, 1 has the
+    // lowest latency and more keep both busy. Every submit signals the next
+    // value of _frameTimeline, a frame waits for the value of its last use
+    // before it is recorded again.
+    u32 _framesInFlight = 2;
+    // what the UI and the command line ask for, applied by the render thread
+    int _framesInFlightSetting = 2;
+    VkSemaphore _frameTimeline;
+    // atomic so other threads can tag resources with the next frame
+    std::atomic<u64> _frameTimelineValue{0};
     // NOTE: This is clearly overkill and lowkey "wrong"
     // Could probably just use a normal array?
     std::vector<VkSemaphore> _submitSemaphores;
     AllocatedImage _drawImage;
     AllocatedImage _depthImage;
+    // NOTE(champ): RGBA8 copy of the draw image used instead of the swapchain
+    // when running headless
+    AllocatedImage _readbackImage;
     VkExtent2D _drawExtent;
     float _renderScale = 1.0f;
     
@@ -182,10 +533,78 @@ struct VulkanEngine {
     VkPipelineLayout _gradientPipelineLayout;
     VkPipeline _meshPipeline;
     VkPipelineLayout _meshPipelineLayout;
+    VkPipeline _cullPipeline;
+    VkPipelineLayout _cullPipelineLayout;
+    
+    // NOTE(champ): opaque surfaces get culled on the GPU and drawn with one
+    // indirect draw per material, transparent ones stay on the CPU path
+    bool _gpuDrivenRendering = true;
+    // cleared in init_vulkan when the indirect draw features are missing
+    bool _gpuDrivenSupported = true;
+    std::vector<IndirectBatch> _indirectBatches;
+    
+    bool _cpuFrustumCulling = true;
+    // records large draw lists into secondary command buffers on the job
+    // system instead of the main command buffer
+    bool _parallelRecording = true;
+    // what the UI and the command line ask for, 0 images lets the driver
+    // pick one more than its minimum
+    VkPresentModeKHR _presentModeSetting = VK_PRESENT_MODE_FIFO_KHR;
+    int _swapchainImageCountSetting = 0;
+    // NOTE(champ): scenes only mark the surfaces their BVH finds in the
+    // frustum, whole subtrees are rejected without touching their objects
+    bool _bvhCulling = true;
+    
+    // NOTE(champ): every surface of every loaded scene, registered once by
+    // the scene and then only patched. _visibleObjects is indexed by handle.
+    RenderList _renderList;
+    std::vector<u8> _visibleObjects;
+    // what _visibleObjects was computed from, update_scene keeps it as long
+    // as none of these changed
+    bool _visibilityValid = false;
+    bool _visibleWithBvh = false;
+    glm::mat4 _visibleViewproj;
+    u64 _visibleVersion = 0;
+    // NOTE(champ): a published snapshot is never written while a packet still
+    // holds it. update_scene keeps a few and brings one no packet uses up to
+    // date, objects that only moved get their transform copied over, the
+    // whole copy is only made again when the list or the visible set changed.
+    // All of them share one layout, _snapshotSlots maps a handle to its
+    // object in them or to INVALID_SNAPSHOT_SLOT
+    struct SnapshotBuffer {
+        std::shared_ptr<VisibleSnapshot> snapshot;
+        // handles moved since this one was last brought up to date
+        std::vector<u32> moved;
+        bool stale = true;
+    };
+    static constexpr u32 INVALID_SNAPSHOT_SLOT = ~0u;
+    std::vector<SnapshotBuffer> _snapshotBuffers;
+    std::vector<u32> _snapshotSlots;
+    u32 _publishedSnapshot = 0;
+    bool _snapshotLayoutValid = false;
+    u64 _snapshotVersion = 0;
+    u64 _snapshotTransformVersion = 0;
+    // the previous visible set is kept to tell whether a recomputed one changed
+    std::vector<u8> _previousVisibleObjects;
+    // reused every frame by the CPU culling
+    CullingBounds _cullingBounds;
+    // reused every frame to sort the draws
+    std::vector<DrawKey> _sortKeys;
+    std::vector<DrawKey> _sortScratch;
     
     VkFence _immFence;
     VkCommandBuffer _immCommandBuffer;
     VkCommandPool _immCommandPool;
+    // NOTE(champ): scenes can be loaded from other threads, which record into
+    // the immediate command buffer and submit to the graphics queue
+    std::mutex _immMutex;
+    std::mutex _queueMutex;
+    
+    UploadBatcher _uploader;
+    GeometryArena _geometryArena;
+    // meshes that did not fit in the arena and got buffers of their own
+    std::atomic<u32> _dedicatedMeshBuffers{0};
+    TextureCache _textureCache;
     
     std::vector<ComputeEffect> backgroundEffects;
     int currentBackgroundEffect = 0;
@@ -196,6 +615,11 @@ struct VulkanEngine {
     
     GPUSceneData _sceneData;
     VkDescriptorSetLayout _gpuSceneDataDescriptorLayout;
+    // persistently mapped, MAX_FRAMES_IN_FLIGHT slices of _sceneDataStride bytes
+    AllocatedBuffer _sceneDataBuffer;
+    size_t _sceneDataStride;
+    VkDescriptorSet _sceneDataDescriptors;
+    VkDescriptorSet _defaultImageDescriptors;
     AllocatedImage _whiteImage;
     AllocatedImage _blackImage;
     AllocatedImage _greyImage;
@@ -206,13 +630,50 @@ struct VulkanEngine {
     MaterialInstance _defaulMatData;
     GLTFMetallic_Roughness metalRoughMat;
     
-    DrawContext _mainDrawContext;
     std::unordered_map<std::string, std::shared_ptr<Node>> loadedNodes;
     std::unordered_map<std::string, std::shared_ptr<gltf::LoadedScene>> loadedScenes;
     std::vector<std::string> gltfFilesPath;
+    // loads still running in the background, moved into loadedScenes by
+    // finish_scene_loads at the start of a frame
+    std::vector<std::shared_ptr<gltf::AsyncSceneLoad>> _pendingSceneLoads;
+    // retired by the main thread, not yet handed to the render thread
+    std::vector<std::shared_ptr<gltf::LoadedScene>> _scenesToRetire;
     Camera mainCamera;
+    // NOTE(champ): F5 toggles recording the camera into a path that can be
+    // replayed by the benchmark mode
+    bool _recordingCameraPath = false;
+    CameraPath _recordedCameraPath;
+    
+    // NOTE(champ): written by the thread rendering, the UI reads
+    // _publishedStats through published_stats() instead
+    EngineStats stats = {};
+    EngineStats _publishedStats = {};
+    std::mutex _statsMutex;
+    
+    FramePacket _framePackets[FRAME_PACKET_COUNT];
+    std::thread _renderThread;
+    std::mutex _packetMutex;
+    std::condition_variable _packetCondition;
+    // the packet the main thread fills next, the one waiting for the render
+    // thread and the one being rendered, INVALID_PACKET when there is none
+    static constexpr u32 INVALID_PACKET = ~0u;
+    u32 _fillingPacket = 0;
+    u32 _readyPacket = INVALID_PACKET;
+    u32 _renderingPacket = INVALID_PACKET;
+    bool _stopRenderThread = false;
+    // duration of the last main thread frame
+    float _mainFrameTime = 0.0f;
+    
+    // frame timeline values and the SDL_GetTicksNS they were submitted at,
+    // waited on in order by the latency thread
+    std::thread _latencyThread;
+    std::mutex _latencyMutex;
+    std::condition_variable _latencyCondition;
+    std::deque<std::pair<u64, u64>> _pendingSubmits;
+    bool _stopLatencyThread = false;
+    float _submitToGpuDone = 0.0f;
     
-    EngineStats stats;
+    JobSystem _jobSystem;
     
     DeletionQueue _mainDeletionQueue;
 };
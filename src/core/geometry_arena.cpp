@@ -0,0 +1,104 @@
+#include "core/geometry_arena.h"
+
+#include "core/engine.h"
+
+#include <algorithm>
+
+void
+GeometryArena::init(VulkanEngine* engine,
+                    u32 maxVertices,
+                    u32 maxIndices,
+                    size_t vertexSize)
+{
+    this->engine = engine;
+    this->maxVertices = maxVertices;
+    this->maxIndices = maxIndices;
+
+    vertexBuffer = engine->create_buffer((size_t)maxVertices * vertexSize,
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                         VMA_MEMORY_USAGE_GPU_ONLY);
+
+    VkBufferDeviceAddressInfo deviceAdressInfo = {};
+    deviceAdressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    deviceAdressInfo.buffer = vertexBuffer.buffer;
+    vertexBufferAddress = vkGetBufferDeviceAddress(engine->_device, &deviceAdressInfo);
+
+    indexBuffer = engine->create_buffer((size_t)maxIndices * sizeof(u32),
+                                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                        VMA_MEMORY_USAGE_GPU_ONLY);
+
+    // the virtual blocks count elements instead of bytes, so every offset
+    // they return is directly a vertexOffset or a firstIndex
+    VmaVirtualBlockCreateInfo blockCI = {};
+    blockCI.size = maxVertices;
+    VK_CHECK(vmaCreateVirtualBlock(&blockCI, &vertexBlock));
+    blockCI.size = maxIndices;
+    VK_CHECK(vmaCreateVirtualBlock(&blockCI, &indexBlock));
+}
+
+void
+GeometryArena::destroy()
+{
+    if (allocationCount > 0) {
+        spdlog::warn("Destroying the geometry arena with {} meshes still allocated.", allocationCount.load());
+    }
+    vmaClearVirtualBlock(vertexBlock);
+    vmaClearVirtualBlock(indexBlock);
+    vmaDestroyVirtualBlock(vertexBlock);
+    vmaDestroyVirtualBlock(indexBlock);
+
+    engine->destroy_buffer(vertexBuffer);
+    engine->destroy_buffer(indexBuffer);
+}
+
+bool
+GeometryArena::allocate(u32 vertexCount,
+                        u32 indexCount,
+                        GPUMeshBuffers& mesh)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    VmaVirtualAllocationCreateInfo allocCI = {};
+    VkDeviceSize vertexOffset = 0;
+    VkDeviceSize firstIndex = 0;
+
+    // VMA does not hand out empty ranges
+    allocCI.size = std::max(vertexCount, 1u);
+    if (vmaVirtualAllocate(vertexBlock, &allocCI, &mesh.vertexAllocation, &vertexOffset) != VK_SUCCESS) {
+        return false;
+    }
+    allocCI.size = std::max(indexCount, 1u);
+    if (vmaVirtualAllocate(indexBlock, &allocCI, &mesh.indexAllocation, &firstIndex) != VK_SUCCESS) {
+        vmaVirtualFree(vertexBlock, mesh.vertexAllocation);
+        mesh.vertexAllocation = VK_NULL_HANDLE;
+        return false;
+    }
+
+    mesh.vertexBuffer = vertexBuffer;
+    mesh.indexBuffer = indexBuffer;
+    mesh.vertexBufferAddress = vertexBufferAddress;
+    mesh.vertexOffset = (i32)vertexOffset;
+    mesh.firstIndex = (u32)firstIndex;
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
+
+    allocationCount += 1;
+    usedVertices += vertexCount;
+    usedIndices += indexCount;
+    return true;
+}
+
+void
+GeometryArena::free(const GPUMeshBuffers& mesh)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    vmaVirtualFree(vertexBlock, mesh.vertexAllocation);
+    vmaVirtualFree(indexBlock, mesh.indexAllocation);
+
+    allocationCount -= 1;
+    usedVertices -= mesh.vertexCount;
+    usedIndices -= mesh.indexCount;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "core/types.h"
+#include <atomic>
+#include <mutex>
+
+struct VulkanEngine;
+
+// NOTE(champ): the arena is committed up front, so the default stays small,
+// about 64MB with Vertex and 32MB with CompactVertex. Meshes that no longer
+// fit get dedicated buffers, bigger scenes pass --arena-vertices and
+// --arena-indices
+constexpr u32 ARENA_DEFAULT_VERTICES = 1024 * 1024;
+constexpr u32 ARENA_DEFAULT_INDICES = 4 * 1024 * 1024;
+
+// NOTE(champ): one vertex buffer and one index buffer shared by every mesh.
+// Ranges are handed out by VMA virtual blocks counted in vertices and indices,
+// so a mesh only keeps its firstIndex and vertexOffset into the shared buffers
+// and the whole scene draws with a single index buffer bind.
+struct GeometryArena {
+    // vertexSize is the size of Vertex or CompactVertex, see VulkanEngine::vertex_size
+    void init(VulkanEngine* engine, u32 maxVertices, u32 maxIndices, size_t vertexSize);
+    void destroy();
+
+    // fills the buffers and offsets of mesh, returns false when the arena is full
+    bool allocate(u32 vertexCount, u32 indexCount, GPUMeshBuffers& mesh);
+    void free(const GPUMeshBuffers& mesh);
+
+    AllocatedBuffer vertexBuffer;
+    AllocatedBuffer indexBuffer;
+    VkDeviceAddress vertexBufferAddress;
+
+    // stats, read from the UI
+    // written under the mutex, atomic so the UI can read them without it
+    std::atomic<u32> allocationCount{0};
+    std::atomic<u32> usedVertices{0};
+    std::atomic<u32> usedIndices{0};
+    u32 maxVertices;
+    u32 maxIndices;
+
+    private:
+    VulkanEngine* engine;
+    VmaVirtualBlock vertexBlock;
+    VmaVirtualBlock indexBlock;
+    std::mutex mutex;
+};
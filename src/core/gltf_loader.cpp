@@ -1,5 +1,8 @@
 #include "core/gltf_loader.h"
 
+#include "core/scene_bake.h"
+#include "core/texture_file.h"
+#include "core/vk_images.h"
 #include "engine.h"
 #include "stb_image.h"
 #include "types.h"
@@ -10,54 +13,295 @@
 
 #define CGLTF_IMPLEMENTATION
 #include <cgltf.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <glm/gtx/quaternion.hpp>
 
 static VkFilter extract_filter(cgltf_filter_type filter);
 static VkSamplerMipmapMode extract_mipmap_mode(cgltf_filter_type filter);
-static std::optional<AllocatedImage> gltf_load_image(VulkanEngine* engine, cgltf_image* image);
 
-std::optional<std::shared_ptr<gltf::LoadedScene>>
-gltf::load_scene_from_file(VulkanEngine* engine, 
-                           std::string_view path)
-{
-    spdlog::info("Loading GLTF file at: {}", path);
+// NOTE(champ): RGBA8 pixels decoded by stb_image, pixels is null when decoding
+// failed. compressed is set instead when the image has a KTX2/DDS sidecar,
+// and neither when the texture cache already had content_key
+struct DecodedImage {
+    u8* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    std::unique_ptr<TextureFile> compressed;
+    u64 content_key = 0;
+    bool cached = false;
+};
+
+// NOTE(champ): a mesh converted to the engine vertex format, still on the CPU
+struct ConvertedMesh {
+    std::vector<u32> indices;
+    std::vector<Vertex> vertices;
+    std::vector<GeoSurface> surfaces;
+    // index into the file materials for every surface
+    std::vector<cgltf_size> material_indices;
+};
+
+static DecodedImage gltf_decode_image(std::string_view path, const cgltf_image* image);
+static DecodedImage gltf_load_texture(std::string_view path, const cgltf_data* data, const cgltf_image* image,
+                                      bool compressed_textures, TextureCache* cache);
+static DecodedImage load_texture_data(std::string_view path, const cgltf_data* data, const cgltf_image* image,
+                                      bool compressed_textures);
+// NOTE(champ): bulk reads packed float and index accessors straight from
+// their buffers, the slow path is kept for the vertex benchmark
+static void gltf_convert_mesh(const cgltf_data* data, const cgltf_mesh* mesh, ConvertedMesh& out, bool bulk);
+static std::vector<std::string> bake_dependencies(std::string_view path, const cgltf_data* data);
+
+// NOTE(champ): a parsed glTF file and what was converted from it, the
+// description points into the decoded images and converted meshes
+struct GltfScene {
+    GltfScene() = default;
+    GltfScene(const GltfScene&) = delete;
+    GltfScene& operator=(const GltfScene&) = delete;
+    ~GltfScene()
+    {
+        for (DecodedImage& decoded : decoded_images) {
+            if (decoded.pixels) {
+                stbi_image_free(decoded.pixels);
+            }
+            // the scene holds its own references by now
+            if (decoded.cached) {
+                cache->release(decoded.content_key);
+            }
+        }
+        if (data) {
+            cgltf_free(data);
+        }
+    }
 
-    std::shared_ptr<LoadedScene> scene = std::make_shared<LoadedScene>();
-    scene->creator = engine;
-    LoadedScene& file = *scene.get();
+    cgltf_data* data = nullptr;
+    // set when images can be skipped because they are cached
+    TextureCache* cache = nullptr;
+    std::vector<DecodedImage> decoded_images;
+    std::vector<ConvertedMesh> converted_meshes;
+    gltf::SceneDescription description;
+};
+
+static std::string
+name_or_empty(const char* name)
+{
+    return name ? std::string(name) : std::string();
+}
 
+// parses the file and converts it to a scene description, jobs may be null.
+// compressed_textures uses the KTX2/DDS sidecars of the images when found.
+// Images already in out.cache are not decoded, they stay referenced until
+// out is destroyed
+static bool
+read_gltf(std::string_view path,
+          JobSystem* jobs,
+          gltf::LoadProgress* progress,
+          bool compressed_textures,
+          GltfScene& out)
+{
     cgltf_options opts = {};
-    cgltf_data* data = NULL;
-    cgltf_result result = cgltf_parse_file(&opts, path.data(), &data);
+    cgltf_result result = cgltf_parse_file(&opts, path.data(), &out.data);
     if (result != cgltf_result_success) {
         spdlog::error("Failed to load GTLF file at: {}!", path);
-        return {};
+        out.data = nullptr;
+        return false;
     }
-    result = cgltf_load_buffers(&opts, data, path.data());
+    result = cgltf_load_buffers(&opts, out.data, path.data());
     if (result != cgltf_result_success) {
         spdlog::error("Failed to load buffers!");
-        cgltf_free(data);
-        return {};
+        return false;
+    }
+
+    const cgltf_data* data = out.data;
+    gltf::SceneDescription& description = out.description;
+
+    for (cgltf_size i = 0; i < data->samplers_count; i++) {
+        const cgltf_sampler& sampler = data->samplers[i];
+        description.samplers.push_back({ extract_filter(sampler.mag_filter),
+                                         extract_filter(sampler.min_filter),
+                                         extract_mipmap_mode(sampler.min_filter) });
+    }
+
+    // @SECTION: decode textures and convert meshes
+    // NOTE(champ): this is pure CPU work that only reads from the parsed file,
+    // so every texture and mesh gets its own job. The Vulkan objects are created
+    // afterwards by create_scene and uploaded in one batch.
+    const u32 texture_count = (u32)data->textures_count;
+    const u32 mesh_count = (u32)data->meshes_count;
+    out.decoded_images.resize(texture_count);
+    out.converted_meshes.resize(mesh_count);
+
+    // one step per decode job, plus the upload and the rest of the scene setup
+    if (progress) {
+        progress->total = texture_count + mesh_count + 2;
+    }
+
+    auto decode_job = [&](u32 job_index) {
+        if (job_index < texture_count) {
+            out.decoded_images[job_index] = gltf_load_texture(path, data, data->textures[job_index].image,
+                                                              compressed_textures, out.cache);
+        } else {
+            u32 mesh_index = job_index - texture_count;
+            gltf_convert_mesh(data, &data->meshes[mesh_index], out.converted_meshes[mesh_index], true);
+        }
+        if (progress) {
+            progress->completed += 1;
+        }
+    };
+    if (jobs) {
+        jobs->parallel_for(texture_count + mesh_count, decode_job);
+    } else {
+        for (u32 i = 0; i < texture_count + mesh_count; i++) {
+            decode_job(i);
+        }
+    }
+
+    u32 unnamed_image_count = 0;
+    for (u32 i = 0; i < texture_count; i++) {
+        const DecodedImage& decoded = out.decoded_images[i];
+        const cgltf_image* image = data->textures[i].image;
+
+        gltf::SceneImage scene_image = {};
+        if (image && image->name) {
+            scene_image.name = image->name;
+        } else {
+            char str[20];
+            snprintf(str, sizeof(str), "unnamed_%d", unnamed_image_count);
+            scene_image.name = str;
+            unnamed_image_count += 1;
+        }
+        scene_image.content_key = decoded.content_key;
+        if (decoded.cached)
+        {
+            scene_image.pixels = nullptr;
+            scene_image.size = 0;
+            scene_image.width = 0;
+            scene_image.height = 0;
+            scene_image.format = VK_FORMAT_UNDEFINED;
+            scene_image.mip_levels = 0;
+        }
+        else if (decoded.compressed)
+        {
+            const TextureFile& texture = *decoded.compressed;
+            scene_image.pixels = texture.data;
+            scene_image.size = texture.size;
+            scene_image.width = texture.width;
+            scene_image.height = texture.height;
+            scene_image.format = texture.format;
+            scene_image.mip_levels = texture.mipLevels;
+        }
+        else
+        {
+            scene_image.pixels = decoded.pixels;
+            scene_image.size = (size_t)decoded.width * decoded.height * 4;
+            scene_image.width = (u32)decoded.width;
+            scene_image.height = (u32)decoded.height;
+            scene_image.format = VK_FORMAT_R8G8B8A8_UNORM;
+            scene_image.mip_levels = 0;
+        }
+        description.images.push_back(scene_image);
+    }
+
+    for (cgltf_size i = 0; i < data->materials_count; i++) {
+        const cgltf_material& material = data->materials[i];
+        const float* color = material.pbr_metallic_roughness.base_color_factor;
+
+        gltf::SceneMaterial scene_material = {};
+        scene_material.name = name_or_empty(material.name);
+        scene_material.color_factors = glm::vec4(color[0], color[1], color[2], color[3]);
+        scene_material.metal_rough_factors = glm::vec4(material.pbr_metallic_roughness.metallic_factor,
+                                                       material.pbr_metallic_roughness.roughness_factor,
+                                                       0.0f, 0.0f);
+        scene_material.pass = MaterialPass::GLTF_PBR_OPAQUE;
+        if (material.alpha_mode == cgltf_alpha_mode_blend)
+        {
+            if (material.name)
+                scene_material.pass = MaterialPass::GLTF_PBR_TRANSPARENT;
+        }
+
+        const cgltf_texture* texture = material.pbr_metallic_roughness.base_color_texture.texture;
+        scene_material.color_image = texture ? (i32)(texture - data->textures) : -1;
+        scene_material.color_sampler = texture && texture->sampler ? (i32)(texture->sampler - data->samplers) : -1;
+        description.materials.push_back(scene_material);
+    }
+
+    for (u32 i = 0; i < mesh_count; i++) {
+        const ConvertedMesh& converted = out.converted_meshes[i];
+
+        gltf::SceneMesh scene_mesh = {};
+        scene_mesh.name = name_or_empty(data->meshes[i].name);
+        scene_mesh.vertices = converted.vertices.data();
+        scene_mesh.vertex_count = (u32)converted.vertices.size();
+        scene_mesh.indices = converted.indices.data();
+        scene_mesh.index_count = (u32)converted.indices.size();
+        scene_mesh.surfaces = converted.surfaces;
+        for (cgltf_size material_index : converted.material_indices) {
+            scene_mesh.surface_materials.push_back((u32)material_index);
+        }
+        description.meshes.push_back(std::move(scene_mesh));
+    }
+
+    for (cgltf_size i = 0; i < data->nodes_count; i++) {
+        const cgltf_node* node = &data->nodes[i];
+
+        gltf::SceneNode scene_node = {};
+        scene_node.name = name_or_empty(node->name);
+        scene_node.parent = node->parent ? (i32)(node->parent - data->nodes) : -1;
+        scene_node.mesh = node->mesh ? (i32)(node->mesh - data->meshes) : -1;
+
+        // NOTE(champ): check if node transform is defined as a single matrix emcompassing
+        // transformation + rotation + scaling
+        // or if these components are separated
+        if (node->has_matrix)
+        {
+            memcpy(&scene_node.local_transform, node->matrix, sizeof(node->matrix));
+        }
+        else
+        {
+            glm::vec3 tl(node->translation[0], node->translation[1], node->translation[2]);
+            glm::quat rot(node->rotation[3], node->rotation[0], node->rotation[1], node->rotation[2]);
+            glm::vec3 sc(node->scale[0], node->scale[1], node->scale[2]);
+
+            glm::mat4 tm = glm::translate(glm::mat4(1.0f), tl);
+            glm::mat4 rm = glm::toMat4(rot);
+            glm::mat4 sm = glm::scale(glm::mat4(1.0f), sc);
+
+            scene_node.local_transform = tm * rm * sm;
+        }
+        description.nodes.push_back(scene_node);
     }
 
+    return true;
+}
+
+std::shared_ptr<gltf::LoadedScene>
+gltf::create_scene(VulkanEngine* engine,
+                   const SceneDescription& description,
+                   LoadProgress* progress)
+{
+    std::shared_ptr<LoadedScene> scene = std::make_shared<LoadedScene>();
+    scene->creator = engine;
+    LoadedScene& file = *scene.get();
+
+    const u32 material_count = (u32)description.materials.size();
     std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
         {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3},
         {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
         {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3}
     };
-    file.descriptor_pool.init(engine->_device, data->materials_count, sizes);
-
-    for (int i = 0; i < data->samplers_count; i++) {
-        auto sampler = data->samplers[i];
+    file.descriptor_pool.init(engine->_device, material_count, sizes);
 
+    for (const SceneSampler& sampler : description.samplers) {
         VkSamplerCreateInfo sampler_CI = {};
         sampler_CI.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         sampler_CI.pNext = nullptr;
         sampler_CI.maxLod = VK_LOD_CLAMP_NONE;
         sampler_CI.minLod = 0;
-        sampler_CI.magFilter = extract_filter(sampler.mag_filter);
-        sampler_CI.minFilter = extract_filter(sampler.min_filter);
-        sampler_CI.mipmapMode = extract_mipmap_mode(sampler.min_filter);
+        sampler_CI.magFilter = sampler.mag_filter;
+        sampler_CI.minFilter = sampler.min_filter;
+        sampler_CI.mipmapMode = sampler.mipmap_mode;
 
         VkSampler new_sampler = {0};
         vkCreateSampler(engine->_device, &sampler_CI, nullptr, &new_sampler);
@@ -65,74 +309,136 @@ gltf::load_scene_from_file(VulkanEngine* engine,
         file.samplers.push_back(new_sampler);
     }
 
-    // temporal arrays for all the objects to use while creating the GLTF data
+    // temporal arrays for all the objects to use while creating the scene
     std::vector<std::shared_ptr<MeshAsset>> meshes;
     std::vector<std::shared_ptr<Node>> nodes;
     std::vector<AllocatedImage> images;
     std::vector<std::shared_ptr<GLTFMaterial>> materials;
 
     // @SECTION: load all textures
-    u32 unnamed_image_count = 0;
-    for (int i = 0; i < data->textures_count; i++)
+    // NOTE(champ): textures another scene (or this one) already uploaded come
+    // from the engine texture cache, only the others go into the upload batch
+    TextureCache& texture_cache = engine->_textureCache;
+    const u32 image_count = (u32)description.images.size();
+    std::vector<ImageUploadRequest> image_uploads;
+    std::vector<u64> image_keys(image_count, 0);
+    // index of the image uploading the same key, for duplicates in this scene
+    std::vector<u32> uploaded_by(image_count, UINT32_MAX);
+    std::unordered_map<u64, u32> uploading;
+    u32 shared_count = 0;
+    images.resize(image_count, engine->_errorCheckboardImage);
+    for (u32 i = 0; i < image_count; i++)
     {
-        const cgltf_texture* texture = &data->textures[i];
-        cgltf_image* image = texture->image;
-        std::optional<AllocatedImage> new_image = gltf_load_image(engine, image);
+        const SceneImage& image = description.images[i];
+        u64 key = image.content_key;
+        if (key == 0 && image.pixels != nullptr)
+        {
+            key = TextureCache::hash(image.pixels, image.size, image.format);
+        }
+        if (key == 0)
+        {
+            continue;
+        }
 
-        if (new_image.has_value())
+        if (texture_cache.acquire(key, &images[i]))
         {
-            images.push_back(*new_image);
-            if (image->name)
-            {
-                file.images[image->name] = *new_image;
-            }
-            else
-            {
-                char str[20];
-                snprintf(str, sizeof(str), "unnamed_%d", unnamed_image_count);
-                file.images[str] = *new_image;
-                unnamed_image_count += 1;
-            }
+            image_keys[i] = key;
+            file.texture_keys.push_back(key);
+            shared_count += 1;
+            continue;
         }
-        else
+        if (image.pixels == nullptr)
+        {
+            continue;
+        }
+        auto it = uploading.find(key);
+        if (it != uploading.end())
         {
-            images.push_back(engine->_errorCheckboardImage);
+            uploaded_by[i] = it->second;
+            continue;
         }
+        uploading[key] = i;
+        image_keys[i] = key;
+
+        ImageUploadRequest upload = {};
+        upload.data = image.pixels;
+        upload.size = VkExtent3D{image.width, image.height, 1};
+        upload.format = image.format;
+        upload.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+        upload.mipmapped = true;
+        upload.mipLevels = image.mip_levels;
+        upload.result = &images[i];
+        image_uploads.push_back(upload);
+    }
+
+    // @SECTION: create all meshes
+    std::vector<MeshUploadRequest> mesh_uploads;
+    for (const SceneMesh& mesh : description.meshes) {
+        std::shared_ptr<MeshAsset> new_mesh = std::make_shared<MeshAsset>();
+        meshes.push_back(new_mesh);
+        file.meshes[mesh.name] = new_mesh;
+        new_mesh->name = mesh.name;
+        new_mesh->surfaces = mesh.surfaces;
+
+        MeshUploadRequest upload = {};
+        upload.indices = mesh.indices;
+        upload.indexCount = mesh.index_count;
+        upload.vertices = mesh.vertices;
+        upload.vertexCount = mesh.vertex_count;
+        upload.result = &new_mesh->meshBuffers;
+        mesh_uploads.push_back(upload);
+    }
 
+    // all textures and meshes go to the GPU in one upload batch
+    engine->upload_batch(mesh_uploads, image_uploads);
+    if (progress) {
+        progress->completed += 1;
+    }
+
+    for (const ImageUploadRequest& upload : image_uploads)
+    {
+        u32 i = (u32)(upload.result - images.data());
+        texture_cache.insert(image_keys[i], &images[i]);
+        file.texture_keys.push_back(image_keys[i]);
+    }
+    for (u32 i = 0; i < image_count; i++)
+    {
+        if (uploaded_by[i] != UINT32_MAX)
+        {
+            image_keys[i] = image_keys[uploaded_by[i]];
+            texture_cache.acquire(image_keys[i], &images[i]);
+            file.texture_keys.push_back(image_keys[i]);
+        }
+        if (image_keys[i] != 0)
+        {
+            file.images[description.images[i].name] = images[i];
+        }
+    }
+    if (shared_count > 0)
+    {
+        spdlog::info("{} of {} textures were already loaded.", shared_count, image_count);
     }
 
     // @SECTION: load all materials
-    file.material_data_buffer = engine->create_buffer(sizeof(GLTFMetallic_Roughness::MaterialConstants) * data->materials_count,
+    file.material_data_buffer = engine->create_buffer(sizeof(GLTFMetallic_Roughness::MaterialConstants) * material_count,
                                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                                                       VMA_MEMORY_USAGE_CPU_TO_GPU);
     int data_index = 0;
     GLTFMetallic_Roughness::MaterialConstants* scene_material_constants = (GLTFMetallic_Roughness::MaterialConstants*)file.material_data_buffer.info.pMappedData;
 
-    for (int i = 0; i < data->materials_count; i++)
+    for (const SceneMaterial& material : description.materials)
     {
-        cgltf_material material = data->materials[i];
-
         std::shared_ptr<GLTFMaterial> new_material = std::make_shared<GLTFMaterial>();
         materials.push_back(new_material);
         file.materials[material.name] = new_material;
 
-        GLTFMetallic_Roughness::MaterialConstants constants;
-        constants.colorFactors.x = material.pbr_metallic_roughness.base_color_factor[0];
-        constants.colorFactors.y = material.pbr_metallic_roughness.base_color_factor[1];
-        constants.colorFactors.z = material.pbr_metallic_roughness.base_color_factor[2];
-        constants.colorFactors.w = material.pbr_metallic_roughness.base_color_factor[3];
-        constants.metal_rough_factors.x = material.pbr_metallic_roughness.metallic_factor;
-        constants.metal_rough_factors.y = material.pbr_metallic_roughness.roughness_factor;
+        GLTFMetallic_Roughness::MaterialConstants constants = {};
+        constants.colorFactors = material.color_factors;
+        constants.metal_rough_factors = material.metal_rough_factors;
 
         // write constants to buffer
         scene_material_constants[data_index] = constants;
 
-        MaterialPass pass_type = MaterialPass::GLTF_PBR_OPAQUE;
-        if (material.alpha_mode == cgltf_alpha_mode_blend)
-        {
-            if (material.name)
-                pass_type = MaterialPass::GLTF_PBR_TRANSPARENT;
-        }
         GLTFMetallic_Roughness::MaterialResources resources = {0};
         resources.colorImage = engine->_whiteImage;
         resources.colorSampler = engine->_defaultSamplerlinear;
@@ -143,226 +449,198 @@ gltf::load_scene_from_file(VulkanEngine* engine,
         resources.dataBufferOffset = data_index * sizeof(GLTFMetallic_Roughness::MaterialConstants);
 
         // grab textures from file
-        auto texture = material.pbr_metallic_roughness.base_color_texture.texture;
-        if (texture) {
-            cgltf_size texture_index = (cgltf_size)(texture - data->textures);
-            cgltf_size sampler_index = (cgltf_size)(texture->sampler - data->samplers);
-            resources.colorImage = images[texture_index];
-            resources.colorSampler = file.samplers[sampler_index];
+        if (material.color_image >= 0) {
+            resources.colorImage = images[material.color_image];
+        }
+        if (material.color_sampler >= 0) {
+            resources.colorSampler = file.samplers[material.color_sampler];
         }
 
-        new_material->data = engine->metalRoughMat.write_material(engine->_device, pass_type, resources, file.descriptor_pool);
+        new_material->data = engine->metalRoughMat.write_material(engine->_device, material.pass, resources, file.descriptor_pool);
 
         data_index += 1;
     }
 
-    // @SECTION: load all meshes
-    std::vector<u32> indices;
-    std::vector<Vertex> vertices;
-
-    for (cgltf_size i = 0; i < data->meshes_count; i++) {
-        const cgltf_mesh *mesh = &data->meshes[i];
-        std::shared_ptr<MeshAsset> new_mesh = std::make_shared<MeshAsset>();
-        meshes.push_back(new_mesh);
-        file.meshes[mesh->name] = new_mesh;
-        new_mesh->name = mesh->name;
-
-        // clear the mesh arrays for each mesh
-        indices.clear();
-        vertices.clear();
-
-        for (cgltf_size prim_idx = 0; prim_idx < mesh->primitives_count;
-             prim_idx++) {
-            const cgltf_primitive *prim = &mesh->primitives[prim_idx];
-            GeoSurface newSurface = {0};
-            newSurface.startIndex = (u32)indices.size();
-            newSurface.count = (u32)prim->indices->count;
-
-            size_t initial_vtx = vertices.size();
-
-            // load indicies
-            indices.reserve(newSurface.startIndex + newSurface.count);
-            for (cgltf_size index_idx = 0; index_idx < newSurface.count;
-                 index_idx++) {
-                const u32 idx =
-                (u32)cgltf_accessor_read_index(prim->indices, index_idx);
-                indices.push_back(idx + initial_vtx);
-            }
-
-            cgltf_accessor* position_accessor = {};
-            cgltf_accessor* normal_accessor = {};
-            cgltf_accessor* uv_accessor = {};
-            cgltf_accessor* color_accessor = {};
-
-            for (cgltf_size i = 0; i < prim->attributes_count; i++) {
-                const cgltf_attribute att = prim->attributes[i];
-                switch (att.type) {
-                    case cgltf_attribute_type_position: {
-                        position_accessor = att.data;
-                    } break;
-                    case cgltf_attribute_type_normal: {
-                        normal_accessor = att.data;
-                    } break;
-
-                    case cgltf_attribute_type_texcoord: {
-                        uv_accessor = att.data;
-                    } break;
-                    case cgltf_attribute_type_color: {
-                        color_accessor = att.data;
-                    } break;
-                    default: {
-                    }
-                }
-            }
-            vertices.resize(vertices.size() + position_accessor->count);
-
-            for (cgltf_size i = 0; i < position_accessor->count; i++) {
-                Vertex newVertex = {};
-                newVertex.normal = {1, 0, 0};
-                newVertex.color = glm::vec4{1.0f};
-                newVertex.uv_x = 0;
-                newVertex.uv_y = 0;
-
-                // load vertex positions
-                cgltf_float pos[3] = {};
-                cgltf_accessor_read_float(position_accessor, i, pos, 3);
-                newVertex.position.x = pos[0];
-                newVertex.position.y = pos[1];
-                newVertex.position.z = pos[2];
-
-                // load vertex normals
-                if (normal_accessor != nullptr) {
-                    cgltf_float normal[3] = {};
-                    cgltf_accessor_read_float(normal_accessor, i, normal, 3);
-                    newVertex.normal.x = normal[0];
-                    newVertex.normal.y = normal[1];
-                    newVertex.normal.z = normal[2];
-                }
-
-                // load vertex uvs
-                if (uv_accessor != nullptr) {
-                    cgltf_float uvs[2] = {};
-                    cgltf_accessor_read_float(uv_accessor, i, uvs, 2);
-                    newVertex.uv_x = uvs[0];
-                    newVertex.uv_y = uvs[1];
-                }
-
-                // load vertex colors;
-                if (color_accessor != nullptr) {
-                    cgltf_float colors[4] = {};
-                    cgltf_accessor_read_float(color_accessor, i, colors, 4);
-                    newVertex.color.x = colors[0];
-                    newVertex.color.y = colors[1];
-                    newVertex.color.z = colors[2];
-                    newVertex.color.w = colors[3];
-                }
-
-                // vertices.push_back(newVertex);
-
-                vertices[initial_vtx + i] = newVertex;
-            }
-
-            if (prim->material)
-            {
-                cgltf_size material_index = (cgltf_size)(prim->material - data->materials);
-                newSurface.material = materials[material_index];
-            }
-            else
-            {
-                newSurface.material = materials[0];
-            }
-            // NOTE(champ): min and max vertex for bounds
-            glm::vec3 min_pos = vertices[initial_vtx].position;
-            glm::vec3 max_pos = vertices[initial_vtx].position;
-            // NOTE(champ): this seems ineficient to loop through the vertices array again
-            for (int i = 0; i < vertices.size(); i ++ )
-            {
-                min_pos = glm::min(min_pos, vertices[i].position);
-                max_pos = glm::max(max_pos, vertices[i].position);
-            }
-
-            // calculate origin and extents from the min/max
-            newSurface.bounds.origin =  (max_pos + min_pos) / 2.0f;
-            newSurface.bounds.extents = (max_pos - min_pos) / 2.0f;
-            newSurface.bounds.sphere_radius = glm::length(newSurface.bounds.extents);
-
-            new_mesh->surfaces.push_back(newSurface);
+    // surfaces point to the materials, which only exist now
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const SceneMesh& mesh = description.meshes[i];
+        for (size_t surface_idx = 0; surface_idx < meshes[i]->surfaces.size(); surface_idx++)
+        {
+            meshes[i]->surfaces[surface_idx].material = materials[mesh.surface_materials[surface_idx]];
         }
-        new_mesh->meshBuffers = engine->upload_mesh(indices, vertices);
     }
 
-
-
-
     // @SECTION: load all nodes
-    for (int i = 0; i < data->nodes_count; i++)
+    for (const SceneNode& node : description.nodes)
     {
-        const cgltf_node* node = &data->nodes[i];
         std::shared_ptr<Node> new_node;
-        if (node->mesh)
+        if (node.mesh >= 0)
         {
             new_node = std::make_shared<MeshNode>();
-            cgltf_size mesh_index = (cgltf_size)(node->mesh - data->meshes);
-            assert((mesh_index < data->meshes_count) && (mesh_index < meshes.size()));
-            static_cast<MeshNode*>(new_node.get())->mesh = meshes[mesh_index];
+            assert((size_t)node.mesh < meshes.size());
+            static_cast<MeshNode*>(new_node.get())->mesh = meshes[node.mesh];
         }
         else
         {
             new_node = std::make_shared<Node>();
         }
+        new_node->localTransform = node.local_transform;
 
         nodes.push_back(new_node);
-        file.nodes[node->name];
+        file.nodes[node.name] = new_node;
+    }
 
-        // NOTE(champ): check if node transform is defined as a single matrix emcompassing
-        // transformation + rotation + scaling
-        // or if these components are separated
-        if (node->has_matrix)
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        i32 parent = description.nodes[i].parent;
+        if (parent >= 0)
         {
-            memcpy(&new_node->localTransform, node->matrix, sizeof(node->matrix));
+            assert((size_t)parent < nodes.size());
+            nodes[parent]->children.push_back(nodes[i]);
+            nodes[i]->parent = nodes[parent];
         }
-        else
-        {
-            glm::vec3 tl(node->translation[0], node->translation[1], node->translation[2]);
-            glm::quat rot(node->rotation[3], node->rotation[0], node->rotation[1], node->rotation[2]);
-            glm::vec3 sc(node->scale[0], node->scale[1], node->scale[2]);
-
-            glm::mat4 tm = glm::translate(glm::mat4(1.0f), tl);
-            glm::mat4 rm = glm::toMat4(rot);
-            glm::mat4 sm = glm::scale(glm::mat4(1.0f), sc);
+    }
 
-            new_node->localTransform = tm * rm * sm;
+    for (auto& node: nodes)
+    {
+        if (node->parent.lock() == nullptr)
+        {
+            file.top_nodes.push_back(node);
+            node->refresh_transform(glm::mat4(1.0f));
         }
     }
 
-    for (int i = 0; i < data->nodes_count; i++)
+    file.graph.add_trees(file.top_nodes);
+    for (u32 i = 0; i < file.graph.size(); i++)
     {
-        cgltf_node& node = data->nodes[i];
-        std::shared_ptr<Node>& scene_node = nodes[i];
+        file.node_surfaces.push_back((u32)file.surfaces.size());
+        const MeshAsset* mesh = file.graph.mesh_of(i);
+        for (u32 s = 0; mesh && s < mesh->surfaces.size(); s++)
+        {
+            file.surfaces.push_back({ i, s });
+        }
+    }
+    file.node_surfaces.push_back((u32)file.surfaces.size());
+    file.build_bvh();
+
+    if (progress) {
+        progress->completed = progress->total.load();
+    }
+    return scene;
+}
 
-        for (int j = 0; j < node.children_count; j++)
+std::optional<std::shared_ptr<gltf::LoadedScene>>
+gltf::load_scene_from_file(VulkanEngine* engine, 
+                           std::string_view path,
+                           bool parallel,
+                           LoadProgress* progress,
+                           bool use_bake)
+{
+    if (use_bake && bake::is_up_to_date(path))
+    {
+        auto baked = load_scene_from_bake(engine, bake::bake_path(path), progress);
+        if (baked.has_value())
         {
-            auto c = node.children[j];
-            cgltf_size children_index = (cgltf_size)(c - data->nodes);
-            assert((children_index < data->nodes_count) && (children_index < nodes.size()));
-            scene_node->children.push_back(nodes[children_index]);
-            nodes[children_index]->parent = scene_node;
+            return baked;
         }
+        spdlog::warn("Falling back to loading {}", path);
     }
 
-    for (auto& node: nodes)
+    spdlog::info("Loading GLTF file at: {}", path);
+    auto load_start = std::chrono::high_resolution_clock::now();
+
+    GltfScene gltf_scene;
+    gltf_scene.cache = &engine->_textureCache;
+    if (!read_gltf(path, parallel ? &engine->_jobSystem : nullptr, progress, engine->_textureCompressionBC, gltf_scene))
     {
-        if (node->parent.lock() == nullptr)
+        return {};
+    }
+    std::shared_ptr<LoadedScene> scene = create_scene(engine, gltf_scene.description, progress);
+
+    auto load_end = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start);
+    spdlog::info("Loaded {} in {:.2f} ms ({}).", path, elapsed.count() / 1000.f,
+                 parallel ? "parallel" : "serial");
+    return scene;
+}
+
+std::optional<std::shared_ptr<gltf::LoadedScene>>
+gltf::load_scene_from_bake(VulkanEngine* engine,
+                           std::string_view bake_path,
+                           LoadProgress* progress)
+{
+    auto load_start = std::chrono::high_resolution_clock::now();
+    // mapping and parsing the tables, then the upload and the scene setup
+    if (progress) {
+        progress->total = 2;
+    }
+
+    // NOTE(champ): the description points into the mapping, which stays
+    // alive until create_scene has copied everything to the GPU
+    MappedFile file;
+    SceneDescription description;
+    if (!bake::read(std::string(bake_path), file, description))
+    {
+        return {};
+    }
+    for (const SceneImage& image : description.images)
+    {
+        if (!engine->_textureCompressionBC && vkutil::is_block_compressed(image.format))
         {
-            file.top_nodes.push_back(node);
-            node->refresh_transform(glm::mat4(1.0f));
+            spdlog::warn("{} has compressed textures the device can not sample.", bake_path);
+            return {};
         }
     }
+    std::shared_ptr<LoadedScene> scene = create_scene(engine, description, progress);
 
-    cgltf_free(data);
+    auto load_end = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start);
+    spdlog::info("Loaded {} in {:.2f} ms (baked).", bake_path, elapsed.count() / 1000.f);
     return scene;
 }
 
+bool
+gltf::bake_scene(std::string_view path, JobSystem* jobs)
+{
+    auto bake_start = std::chrono::high_resolution_clock::now();
+
+    // NOTE(champ): compressed sidecars go into the bake as they are, devices
+    // without BC support fall back to the glTF file
+    GltfScene gltf_scene;
+    if (!read_gltf(path, jobs, nullptr, true, gltf_scene))
+    {
+        return false;
+    }
+    if (!bake::write(path, gltf_scene.description, bake_dependencies(path, gltf_scene.data)))
+    {
+        return false;
+    }
+
+    auto bake_end = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(bake_end - bake_start);
+    spdlog::info("Baked {} in {:.2f} ms.", path, elapsed.count() / 1000.f);
+    return true;
+}
+
+std::shared_ptr<gltf::AsyncSceneLoad>
+gltf::load_scene_async(VulkanEngine* engine,
+                       const std::string& name,
+                       const std::string& path)
+{
+    std::shared_ptr<AsyncSceneLoad> load = std::make_shared<AsyncSceneLoad>();
+    load->name = name;
+    load->path = path;
+
+    // NOTE(champ): the future blocks in its destructor until the thread is done,
+    // so the raw pointer outlives the load
+    AsyncSceneLoad* raw_load = load.get();
+    load->result = std::async(std::launch::async, [engine, raw_load]() {
+        return load_scene_from_file(engine, raw_load->path, true, &raw_load->progress);
+    });
+    return load;
+}
+
 static VkFilter
 extract_filter(cgltf_filter_type filter)
 {
@@ -401,14 +679,121 @@ extract_mipmap_mode(cgltf_filter_type filter)
     }
 }
 
+gltf::LoadedScene::~LoadedScene()
+{
+    clear_all();
+}
+
+bool
+gltf::LoadedScene::update(const glm::mat4& top_matrix)
+{
+    u32 changed = graph.update_transforms();
+    if (changed > 0)
+    {
+        refit_bvh();
+    }
+
+    RenderList& render_list = creator->_renderList;
+    if (!registered)
+    {
+        std::vector<RenderObject> objects;
+        objects.reserve(surfaces.size());
+        for (const SceneSurface& s : surfaces)
+        {
+            objects.push_back(make_render_object(*graph.mesh_of(s.node), s.surface,
+                                                 top_matrix * graph.worldTransforms[s.node]));
+        }
+        render_handles.clear();
+        render_list.add(objects, render_handles);
+        registered_top_matrix = top_matrix;
+        registered = true;
+        return true;
+    }
+
+    bool top_changed = top_matrix != registered_top_matrix;
+    if (changed == 0 && !top_changed)
+    {
+        return false;
+    }
+
+    auto move_surface = [&](u32 i) {
+        render_list.set_transform(render_handles[i], top_matrix * graph.worldTransforms[surfaces[i].node]);
+    };
+
+    if (top_changed)
+    {
+        for (u32 i = 0; i < surfaces.size(); i++)
+        {
+            move_surface(i);
+        }
+        registered_top_matrix = top_matrix;
+    }
+    else
+    {
+        // only the surfaces below the nodes that moved
+        for (u32 node : graph.changedNodes)
+        {
+            for (u32 i = node_surfaces[node]; i < node_surfaces[node + 1]; i++)
+            {
+                move_surface(i);
+            }
+        }
+    }
+    return true;
+}
+
 void
 gltf::LoadedScene::draw(const glm::mat4& top_matrix,
                         DrawContext& ctx)
 {
-    for (std::shared_ptr<Node>& node: top_nodes)
+    update(top_matrix);
+    graph.draw(top_matrix, ctx);
+}
+
+u32
+gltf::LoadedScene::mark_visible(const Frustum& frustum,
+                                std::vector<u8>& visible) const
+{
+    return bvh.query(frustum, [&](u32 item) {
+        visible[render_handles[item]] = 1;
+    });
+}
+
+static std::vector<AABB>
+surface_boxes(const SceneGraph& graph, const std::vector<gltf::SceneSurface>& surfaces)
+{
+    std::vector<AABB> boxes;
+    boxes.reserve(surfaces.size());
+    for (const gltf::SceneSurface& s : surfaces)
+    {
+        const Bounds& bounds = graph.mesh_of(s.node)->surfaces[s.surface].bounds;
+        boxes.push_back(transform_box(bounds.origin, bounds.extents, graph.worldTransforms[s.node]));
+    }
+    return boxes;
+}
+
+void
+gltf::LoadedScene::build_bvh()
+{
+    bvh.build(surface_boxes(graph, surfaces));
+}
+
+void
+gltf::LoadedScene::refit_bvh()
+{
+    bvh.refit(surface_boxes(graph, surfaces));
+}
+
+void
+gltf::LoadedScene::unregister()
+{
+    if (!registered)
     {
-        node->draw(top_matrix, ctx);
+        return;
     }
+    creator->_renderList.remove(render_handles);
+    render_handles.clear();
+    registered = false;
 }
 
 void
@@ -416,52 +801,88 @@ gltf::LoadedScene::clear_all()
 {
     VkDevice device = creator->_device;
 
+    // NOTE(champ): the render list still points at the buffers freed below.
+    // Retired scenes were unregistered already, which keeps this off the
+    // render list when the render thread drops them
+    unregister();
+
     descriptor_pool.destroy_pools(device);
     creator->destroy_buffer(material_data_buffer);
 
     for (auto& [k,v]: meshes)
     {
-        creator->destroy_buffer(v->meshBuffers.indexBuffer);
-        creator->destroy_buffer(v->meshBuffers.vertexBuffer);
+        creator->destroy_mesh_buffers(v->meshBuffers);
     }
 
-    for (auto& [k, v] : images) {
-
-        if (v.image == creator->_errorCheckboardImage.image) {
-            //dont destroy the default images
-            continue;
-        }
-        creator->destroy_image(v);
+    // NOTE(champ): other scenes may still use the images, the cache destroys
+    // them with their last reference
+    for (u64 key : texture_keys) {
+        creator->_textureCache.release(key);
     }
+    texture_keys.clear();
+    images.clear();
 
 	for (auto& sampler : samplers) {
 		vkDestroySampler(device, sampler, nullptr);
     }
 }
 
-static std::optional<AllocatedImage>
-gltf_load_image(VulkanEngine* engine,
-                cgltf_image* image)
+// NOTE(champ): the file an image uri points to, resolved against the glTF
+// directory and percent decoded the way cgltf opens buffers. Loading, the
+// texture cache key, sidecar names and bake stamps all go through this one,
+// empty for images embedded in a buffer or a data URI
+static std::string
+image_file_path(std::string_view path, const cgltf_image* image)
+{
+    if (image->uri == nullptr || strncmp(image->uri, "data:", 5) == 0)
+    {
+        return {};
+    }
+    std::string decoded = image->uri;
+    cgltf_decode_uri(decoded.data());
+    decoded.resize(strlen(decoded.c_str()));
+    return (std::filesystem::path(path).parent_path() / decoded).lexically_normal().string();
+}
+
+static DecodedImage
+gltf_decode_image(std::string_view path, const cgltf_image* image)
 {
-    AllocatedImage new_image = {0};
-    int w, h, nr_channels;
+    DecodedImage decoded = {};
+    int nr_channels;
 
-    if (image->uri)
+    if (image == nullptr)
+    {
+        return decoded;
+    }
+    if (image->uri && strncmp(image->uri, "data:", 5) == 0)
     {
-        unsigned char* data = stbi_load(image->uri, &w, &h, &nr_channels, 4);
-        if (data)
+        // only base64 data URIs, same as cgltf_load_buffers
+        const char* comma = strchr(image->uri, ',');
+        if (comma && comma - image->uri >= 7 && strncmp(comma - 7, ";base64", 7) == 0)
         {
-            VkExtent3D image_size = {0};
-            image_size.width = w;
-            image_size.height = h;
-            image_size.depth = 1;
-
-            new_image = engine->create_image(data, image_size,
-                                             VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT,
-                                             true);
-            stbi_image_free(data);
+            const char* base64 = comma + 1;
+            size_t length = strlen(base64);
+            while (length > 0 && base64[length - 1] == '=')
+            {
+                length--;
+            }
+            cgltf_options opts = {};
+            cgltf_size size = length * 3 / 4;
+            void* bytes = nullptr;
+            if (size > 0 && cgltf_load_buffer_base64(&opts, size, base64, &bytes) == cgltf_result_success)
+            {
+                decoded.pixels = stbi_load_from_memory((const unsigned char*)bytes, (int)size,
+                                                       &decoded.width, &decoded.height, &nr_channels, 4);
+                // allocated by the default cgltf allocator
+                free(bytes);
+            }
         }
     }
+    else if (image->uri)
+    {
+        decoded.pixels = stbi_load(image_file_path(path, image).c_str(),
+                                   &decoded.width, &decoded.height, &nr_channels, 4);
+    }
     else if (image->buffer_view)
     {
         cgltf_buffer_view* buffer_view = image->buffer_view;
@@ -469,29 +890,374 @@ gltf_load_image(VulkanEngine* engine,
 
         if (buffer)
         {
-            unsigned char* data = stbi_load_from_memory((unsigned char*)buffer->data + buffer_view->offset,
-                                                        (int)buffer_view->size,
-                                                        &w, &h, &nr_channels,4);
-            if (data)
+            decoded.pixels = stbi_load_from_memory((unsigned char*)buffer->data + buffer_view->offset,
+                                                   (int)buffer_view->size,
+                                                   &decoded.width, &decoded.height, &nr_channels, 4);
+        }
+    }
+
+    return decoded;
+}
+
+// NOTE(champ): compressed versions of an image live next to the glTF file,
+// named after the image file, or after the glTF file and the image index for
+// images embedded in a buffer or a data URI
+static std::string
+image_sidecar_base(std::string_view path, const cgltf_data* data, const cgltf_image* image)
+{
+    std::string image_path = image_file_path(path, image);
+    if (!image_path.empty())
+    {
+        return std::filesystem::path(image_path).replace_extension().string();
+    }
+    return std::string(path) + ".image" + std::to_string(image - data->images);
+}
+
+// NOTE(champ): the files besides the glTF one that a bake is made from,
+// relative to the glTF directory. Sidecars are listed whether they exist
+// or not, creating one changes what the bake would hold
+static std::vector<std::string>
+bake_dependencies(std::string_view path, const cgltf_data* data)
+{
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    std::filesystem::path base = directory.lexically_normal();
+    std::vector<std::string> dependencies;
+    // image paths come normalized, the glTF path may not be
+    auto add = [&](const std::filesystem::path& file) {
+        dependencies.push_back(directory.empty() ? file.string() : file.lexically_normal().lexically_relative(base).string());
+    };
+    for (cgltf_size i = 0; i < data->buffers_count; i++)
+    {
+        const char* uri = data->buffers[i].uri;
+        if (uri && strncmp(uri, "data:", 5) != 0)
+        {
+            // cgltf_load_buffers opens the percent decoded uri
+            std::string decoded = uri;
+            cgltf_decode_uri(decoded.data());
+            decoded.resize(strlen(decoded.c_str()));
+            add(directory / decoded);
+        }
+    }
+    for (cgltf_size i = 0; i < data->images_count; i++)
+    {
+        const cgltf_image* image = &data->images[i];
+        std::string image_path = image_file_path(path, image);
+        if (!image_path.empty())
+        {
+            add(image_path);
+        }
+        for (const std::string& sidecar : texfile::sidecar_candidates(image_sidecar_base(path, data, image)))
+        {
+            add(sidecar);
+        }
+    }
+    return dependencies;
+}
+
+// NOTE(champ): image files are keyed by their resolved path and embedded
+// images by a hash of their bytes, so the same texture is shared across
+// files and loads. Whether sidecars are used changes what gets uploaded, so
+// it is part of the key
+static u64
+image_content_key(std::string_view path, const cgltf_image* image, bool compressed_textures)
+{
+    u64 seed = compressed_textures ? 1 : 2;
+    std::string image_path = image_file_path(path, image);
+    if (!image_path.empty())
+    {
+        return TextureCache::hash(image_path.data(), image_path.size(), seed);
+    }
+    if (image->uri)
+    {
+        return TextureCache::hash(image->uri, strlen(image->uri), seed);
+    }
+    if (image->buffer_view && image->buffer_view->buffer && image->buffer_view->buffer->data)
+    {
+        const cgltf_buffer_view* view = image->buffer_view;
+        return TextureCache::hash((const u8*)view->buffer->data + view->offset, view->size, seed);
+    }
+    return 0;
+}
+
+static DecodedImage
+gltf_load_texture(std::string_view path,
+                  const cgltf_data* data,
+                  const cgltf_image* image,
+                  bool compressed_textures,
+                  TextureCache* cache)
+{
+    u64 content_key = image ? image_content_key(path, image, compressed_textures) : 0;
+    if (cache && content_key != 0 && cache->acquire(content_key, nullptr))
+    {
+        DecodedImage decoded = {};
+        decoded.content_key = content_key;
+        decoded.cached = true;
+        return decoded;
+    }
+
+    DecodedImage decoded = load_texture_data(path, data, image, compressed_textures);
+    decoded.content_key = content_key;
+    return decoded;
+}
+
+static DecodedImage
+load_texture_data(std::string_view path,
+                  const cgltf_data* data,
+                  const cgltf_image* image,
+                  bool compressed_textures)
+{
+    if (image && compressed_textures)
+    {
+        std::string sidecar = texfile::find_sidecar(image_sidecar_base(path, data, image));
+        if (!sidecar.empty())
+        {
+            DecodedImage decoded = {};
+            decoded.compressed = std::make_unique<TextureFile>();
+            if (texfile::load(sidecar, *decoded.compressed))
             {
-                VkExtent3D image_size = {0};
-                image_size.width = w;
-                image_size.height = h;
-                image_size.depth = 1;
-
-                new_image = engine->create_image(data, image_size,
-                                                 VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT,
-                                                 true);
-                stbi_image_free(data);
+                decoded.width = (int)decoded.compressed->width;
+                decoded.height = (int)decoded.compressed->height;
+                return decoded;
             }
+            spdlog::warn("Failed to load {}, decoding the source image instead.", sidecar);
         }
     }
+    return gltf_decode_image(path, image);
+}
 
-    if (new_image.image == VK_NULL_HANDLE)
+// NOTE(champ): start of the elements of an accessor that can be read straight
+// from its buffer, null when it has to go through cgltf_accessor_read_*
+static const u8*
+accessor_bulk_data(const cgltf_accessor* accessor)
+{
+    if (accessor->is_sparse || accessor->buffer_view == nullptr)
     {
-        return {};
+        return nullptr;
+    }
+    const u8* view_data = (const u8*)cgltf_buffer_view_data(accessor->buffer_view);
+    return view_data ? view_data + accessor->offset : nullptr;
+}
+
+static const u8*
+float_accessor_bulk_data(const cgltf_accessor* accessor, cgltf_type type)
+{
+    if (accessor->component_type != cgltf_component_type_r_32f || accessor->type != type
+        || accessor->normalized)
+    {
+        return nullptr;
+    }
+    return accessor_bulk_data(accessor);
+}
+
+// NOTE(champ): copies count elements of size bytes spaced stride bytes apart
+// to the given offset of consecutive vertices
+static void
+copy_strided_to_vertices(Vertex* vertices,
+                         size_t member_offset,
+                         const u8* src,
+                         cgltf_size stride,
+                         cgltf_size size,
+                         cgltf_size count)
+{
+    u8* dst = (u8*)vertices + member_offset;
+    for (cgltf_size i = 0; i < count; i++)
+    {
+        memcpy(dst, src, size);
+        dst += sizeof(Vertex);
+        src += stride;
+    }
+}
+
+template <typename T>
+static void
+copy_indices(u32* dst, const u8* src, cgltf_size stride, cgltf_size count, u32 base)
+{
+    for (cgltf_size i = 0; i < count; i++)
+    {
+        T index;
+        memcpy(&index, src + i * stride, sizeof(T));
+        dst[i] = (u32)index + base;
+    }
+}
+
+static void
+gltf_convert_mesh(const cgltf_data* data,
+                  const cgltf_mesh* mesh,
+                  ConvertedMesh& out,
+                  bool bulk)
+{
+    std::vector<u32>& indices = out.indices;
+    std::vector<Vertex>& vertices = out.vertices;
+
+    for (cgltf_size prim_idx = 0; prim_idx < mesh->primitives_count;
+         prim_idx++) {
+        const cgltf_primitive *prim = &mesh->primitives[prim_idx];
+
+        cgltf_accessor* position_accessor = {};
+        cgltf_accessor* normal_accessor = {};
+        cgltf_accessor* uv_accessor = {};
+        cgltf_accessor* color_accessor = {};
+
+        for (cgltf_size i = 0; i < prim->attributes_count; i++) {
+            const cgltf_attribute att = prim->attributes[i];
+            switch (att.type) {
+                case cgltf_attribute_type_position: {
+                    position_accessor = att.data;
+                } break;
+                case cgltf_attribute_type_normal: {
+                    normal_accessor = att.data;
+                } break;
+
+                case cgltf_attribute_type_texcoord: {
+                    // NOTE(champ): only TEXCOORD_0 is used by the materials
+                    if (att.index == 0)
+                        uv_accessor = att.data;
+                } break;
+                case cgltf_attribute_type_color: {
+                    color_accessor = att.data;
+                } break;
+                default: {
+                }
+            }
+        }
+        if (position_accessor == nullptr || position_accessor->count == 0)
+        {
+            continue;
+        }
+
+        const u32 initial_vtx = (u32)vertices.size();
+        const cgltf_size vertex_count = position_accessor->count;
+
+        GeoSurface newSurface = {0};
+        newSurface.startIndex = (u32)indices.size();
+        newSurface.count = prim->indices ? (u32)prim->indices->count : (u32)vertex_count;
+
+        // load indicies
+        indices.resize(newSurface.startIndex + newSurface.count);
+        u32* dst_indices = indices.data() + newSurface.startIndex;
+        const u8* index_data = bulk && prim->indices ? accessor_bulk_data(prim->indices) : nullptr;
+        if (prim->indices == nullptr)
+        {
+            // non indexed primitives draw their vertices in order
+            for (u32 i = 0; i < newSurface.count; i++)
+            {
+                dst_indices[i] = initial_vtx + i;
+            }
+        }
+        else if (index_data && prim->indices->component_type == cgltf_component_type_r_16u)
+        {
+            copy_indices<u16>(dst_indices, index_data, prim->indices->stride, newSurface.count, initial_vtx);
+        }
+        else if (index_data && prim->indices->component_type == cgltf_component_type_r_32u)
+        {
+            copy_indices<u32>(dst_indices, index_data, prim->indices->stride, newSurface.count, initial_vtx);
+        }
+        else
+        {
+            for (cgltf_size index_idx = 0; index_idx < newSurface.count;
+                 index_idx++) {
+                const u32 idx =
+                (u32)cgltf_accessor_read_index(prim->indices, index_idx);
+                dst_indices[index_idx] = idx + initial_vtx;
+            }
+        }
+
+        Vertex default_vertex = {};
+        default_vertex.normal = {1, 0, 0};
+        default_vertex.color = glm::vec4{1.0f};
+        default_vertex.uv_x = 0;
+        default_vertex.uv_y = 0;
+        vertices.resize(vertices.size() + vertex_count, default_vertex);
+        Vertex* dst_vertices = vertices.data() + initial_vtx;
+
+        // NOTE(champ): packed float attributes are copied with one strided
+        // pass each, anything else (quantized, normalized, sparse) is read
+        // element by element through cgltf
+        const u8* position_data = bulk ? float_accessor_bulk_data(position_accessor, cgltf_type_vec3) : nullptr;
+        if (position_data)
+        {
+            copy_strided_to_vertices(dst_vertices, offsetof(Vertex, position), position_data,
+                                     position_accessor->stride, sizeof(float) * 3, vertex_count);
+        }
+        else
+        {
+            for (cgltf_size i = 0; i < vertex_count; i++) {
+                cgltf_accessor_read_float(position_accessor, i, &dst_vertices[i].position.x, 3);
+            }
+        }
+
+        if (normal_accessor != nullptr) {
+            const u8* normal_data = bulk ? float_accessor_bulk_data(normal_accessor, cgltf_type_vec3) : nullptr;
+            cgltf_size count = std::min(normal_accessor->count, vertex_count);
+            if (normal_data)
+            {
+                copy_strided_to_vertices(dst_vertices, offsetof(Vertex, normal), normal_data,
+                                         normal_accessor->stride, sizeof(float) * 3, count);
+            }
+            else
+            {
+                for (cgltf_size i = 0; i < count; i++) {
+                    cgltf_accessor_read_float(normal_accessor, i, &dst_vertices[i].normal.x, 3);
+                }
+            }
+        }
+
+        // NOTE(champ): uv_x and uv_y are not next to each other in Vertex
+        if (uv_accessor != nullptr) {
+            const u8* uv_data = bulk ? float_accessor_bulk_data(uv_accessor, cgltf_type_vec2) : nullptr;
+            cgltf_size count = std::min(uv_accessor->count, vertex_count);
+            if (uv_data)
+            {
+                copy_strided_to_vertices(dst_vertices, offsetof(Vertex, uv_x), uv_data,
+                                         uv_accessor->stride, sizeof(float), count);
+                copy_strided_to_vertices(dst_vertices, offsetof(Vertex, uv_y), uv_data + sizeof(float),
+                                         uv_accessor->stride, sizeof(float), count);
+            }
+            else
+            {
+                for (cgltf_size i = 0; i < count; i++) {
+                    cgltf_float uvs[2] = {};
+                    cgltf_accessor_read_float(uv_accessor, i, uvs, 2);
+                    dst_vertices[i].uv_x = uvs[0];
+                    dst_vertices[i].uv_y = uvs[1];
+                }
+            }
+        }
+
+        // load vertex colors, usually normalized integers so always through cgltf
+        if (color_accessor != nullptr) {
+            cgltf_size count = std::min(color_accessor->count, vertex_count);
+            for (cgltf_size i = 0; i < count; i++) {
+                cgltf_float colors[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+                cgltf_accessor_read_float(color_accessor, i, colors, 4);
+                dst_vertices[i].color = glm::vec4(colors[0], colors[1], colors[2], colors[3]);
+            }
+        }
+
+        cgltf_size material_index = 0;
+        if (prim->material)
+        {
+            material_index = (cgltf_size)(prim->material - data->materials);
+        }
+        out.material_indices.push_back(material_index);
+
+        // NOTE(champ): min and max vertex for bounds, only over the vertices
+        // of this primitive
+        glm::vec3 min_pos = vertices[initial_vtx].position;
+        glm::vec3 max_pos = vertices[initial_vtx].position;
+        for (size_t i = initial_vtx; i < vertices.size(); i++)
+        {
+            min_pos = glm::min(min_pos, vertices[i].position);
+            max_pos = glm::max(max_pos, vertices[i].position);
+        }
+
+        // calculate origin and extents from the min/max
+        newSurface.bounds.origin =  (max_pos + min_pos) / 2.0f;
+        newSurface.bounds.extents = (max_pos - min_pos) / 2.0f;
+        newSurface.bounds.sphere_radius = glm::length(newSurface.bounds.extents);
+
+        out.surfaces.push_back(newSurface);
     }
-    return new_image;
 }
 
 std::optional<std::vector<std::shared_ptr<MeshAsset>>>
@@ -507,130 +1273,175 @@ gltf::loadMeshes(VulkanEngine *engine,
         spdlog::error("Failed to load GTLF file at: {}!", filePath);
         return {};
     }
-    result = cgltf_load_buffers(&opts, data, "model.gltf");
+    result = cgltf_load_buffers(&opts, data, filePath);
     if (result != cgltf_result_success) {
         spdlog::error("Failed to load buffers!");
         cgltf_free(data);
         return {};
     }
     std::vector<std::shared_ptr<MeshAsset>> meshes;
-    // use the same vectors for all meshes
-    std::vector<u32> indices;
-    std::vector<Vertex> vertices;
 
     for (cgltf_size i = 0; i < data->meshes_count; i++) {
         const cgltf_mesh *mesh = &data->meshes[i];
 
         MeshAsset newMesh = {};
-        newMesh.name = mesh->name;
+        newMesh.name = name_or_empty(mesh->name);
+
+        ConvertedMesh converted;
+        gltf_convert_mesh(data, mesh, converted, true);
+        newMesh.surfaces = std::move(converted.surfaces);
+
+        constexpr bool overrideColors = false;
+        if (overrideColors) {
+            for (Vertex &vtx : converted.vertices) {
+                vtx.color = glm::vec4(vtx.normal, 1.0f);
+            }
+        }
+        newMesh.meshBuffers = engine->upload_mesh(converted.indices, converted.vertices);
+        meshes.emplace_back(std::make_shared<MeshAsset>(std::move(newMesh)));
+    }
 
-        // clear the mesh arrays for each mesh
-        indices.clear();
-        vertices.clear();
+    cgltf_free(data);
+    return meshes;
+}
 
-        for (cgltf_size prim_idx = 0; prim_idx < mesh->primitives_count;
-             prim_idx++) {
-            const cgltf_primitive *prim = &mesh->primitives[prim_idx];
-            GeoSurface newSurface = {};
-            newSurface.startIndex = (u32)indices.size();
-            newSurface.count = (u32)prim->indices->count;
+bool
+gltf::time_mesh_conversion(std::string_view path,
+                           u32 iterations,
+                           bool bulk,
+                           std::vector<float>& times,
+                           u64* vertex_count)
+{
+    cgltf_options opts = {};
+    cgltf_data* data = nullptr;
+    if (cgltf_parse_file(&opts, path.data(), &data) != cgltf_result_success)
+    {
+        spdlog::error("Failed to load GTLF file at: {}!", path);
+        return false;
+    }
+    if (cgltf_load_buffers(&opts, data, path.data()) != cgltf_result_success)
+    {
+        spdlog::error("Failed to load buffers!");
+        cgltf_free(data);
+        return false;
+    }
 
-            size_t initial_vtx = vertices.size();
+    // NOTE(champ): the meshes are converted into fresh vectors every time,
+    // like the loader does, so allocations are part of the timing
+    for (u32 iteration = 0; iteration < iterations; iteration++)
+    {
+        u64 vertices = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (cgltf_size i = 0; i < data->meshes_count; i++)
+        {
+            ConvertedMesh converted;
+            gltf_convert_mesh(data, &data->meshes[i], converted, bulk);
+            vertices += converted.vertices.size();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        times.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+        *vertex_count = vertices;
+    }
 
-            // load indicies
-            indices.reserve(newSurface.startIndex + newSurface.count);
-            for (cgltf_size index_idx = 0; index_idx < newSurface.count;
-                 index_idx++) {
-                const u32 idx =
-                (u32)cgltf_accessor_read_index(prim->indices, index_idx);
-                indices.push_back(idx + initial_vtx);
-            }
+    cgltf_free(data);
+    return true;
+}
 
-            cgltf_accessor *position_accessor = {};
-            cgltf_accessor *normal_accessor = {};
-            cgltf_accessor *uv_accessor = {};
-            cgltf_accessor *color_accessor = {};
-
-            for (cgltf_size i = 0; i < prim->attributes_count; i++) {
-                const cgltf_attribute att = prim->attributes[i];
-                switch (att.type) {
-                    case cgltf_attribute_type_position: {
-                        position_accessor = att.data;
-                    } break;
-                    case cgltf_attribute_type_normal: {
-                        normal_accessor = att.data;
-                    } break;
-
-                    case cgltf_attribute_type_texcoord: {
-                        uv_accessor = att.data;
-                    } break;
-                    case cgltf_attribute_type_color: {
-                        color_accessor = att.data;
-                    } break;
-                    default: {
-                    }
-                }
-            }
-            vertices.resize(vertices.size() + position_accessor->count);
-
-            for (cgltf_size i = 0; i < position_accessor->count; i++) {
-                Vertex newVertex = {};
-                newVertex.normal = {1, 0, 0};
-                newVertex.color = glm::vec4{1.0f};
-                newVertex.uv_x = 0;
-                newVertex.uv_y = 0;
-
-                // load vertex positions
-                cgltf_float pos[3] = {};
-                cgltf_accessor_read_float(position_accessor, i, pos, 3);
-                newVertex.position.x = pos[0];
-                newVertex.position.y = pos[1];
-                newVertex.position.z = pos[2];
-
-                // load vertex normals
-                if (normal_accessor != nullptr) {
-                    cgltf_float normal[3] = {};
-                    cgltf_accessor_read_float(normal_accessor, i, normal, 3);
-                    newVertex.normal.x = normal[0];
-                    newVertex.normal.y = normal[1];
-                    newVertex.normal.z = normal[2];
-                }
+bool
+gltf::compress_textures(std::string_view path, JobSystem* jobs, VkFormat forced_format)
+{
+    cgltf_options opts = {};
+    cgltf_data* data = nullptr;
+    if (cgltf_parse_file(&opts, path.data(), &data) != cgltf_result_success)
+    {
+        spdlog::error("Failed to load GTLF file at: {}!", path);
+        return false;
+    }
+    if (cgltf_load_buffers(&opts, data, path.data()) != cgltf_result_success)
+    {
+        spdlog::error("Failed to load buffers!");
+        cgltf_free(data);
+        return false;
+    }
 
-                // load vertex uvs
-                if (uv_accessor != nullptr) {
-                    cgltf_float uvs[2] = {};
-                    cgltf_accessor_read_float(uv_accessor, i, uvs, 2);
-                    newVertex.uv_x = uvs[0];
-                    newVertex.uv_y = uvs[1];
-                }
+    // NOTE(champ): normal maps only need two channels, everything else is
+    // BC1 unless some texel is not fully opaque
+    std::vector<u8> is_normal_map(data->images_count, 0);
+    for (cgltf_size i = 0; i < data->materials_count; i++)
+    {
+        const cgltf_texture* texture = data->materials[i].normal_texture.texture;
+        if (texture && texture->image)
+        {
+            is_normal_map[texture->image - data->images] = 1;
+        }
+    }
 
-                // load vertex colors;
-                if (color_accessor != nullptr) {
-                    cgltf_float colors[4] = {};
-                    cgltf_accessor_read_float(color_accessor, i, colors, 4);
-                    newVertex.color.x = colors[0];
-                    newVertex.color.y = colors[1];
-                    newVertex.color.z = colors[2];
-                    newVertex.color.w = colors[3];
-                }
+    std::vector<size_t> source_sizes(data->images_count, 0);
+    std::vector<size_t> compressed_sizes(data->images_count, 0);
+    std::atomic<u32> failed{0};
+    auto compress_job = [&](u32 i) {
+        cgltf_image* image = &data->images[i];
+        DecodedImage decoded = gltf_decode_image(path, image);
+        if (decoded.pixels == nullptr)
+        {
+            spdlog::warn("Failed to decode image {} of {}, skipping it.", i, path);
+            failed += 1;
+            return;
+        }
 
-                // vertices.push_back(newVertex);
-                vertices[initial_vtx + i] = newVertex;
+        u32 width = (u32)decoded.width;
+        u32 height = (u32)decoded.height;
+        VkFormat format = forced_format;
+        if (format == VK_FORMAT_UNDEFINED)
+        {
+            bool has_alpha = false;
+            for (size_t t = 0; t < (size_t)width * height && !has_alpha; t++)
+            {
+                has_alpha = decoded.pixels[t * 4 + 3] != 255;
             }
+            format = is_normal_map[i] ? VK_FORMAT_BC5_UNORM_BLOCK
+                : has_alpha ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        }
 
-            newMesh.surfaces.push_back(newSurface);
+        std::vector<u8> levels;
+        u32 mip_levels = texfile::compress_mip_chain(decoded.pixels, width, height, format, levels);
+        stbi_image_free(decoded.pixels);
+
+        std::string sidecar = image_sidecar_base(path, data, image) + ".ktx2";
+        if (!texfile::write_ktx2(sidecar, format, width, height, mip_levels, levels))
+        {
+            failed += 1;
+            return;
         }
+        // what the GPU would hold with mips built from RGBA8, about 4/3 of the base
+        source_sizes[i] = (size_t)width * height * 4 * 4 / 3;
+        compressed_sizes[i] = levels.size();
+        spdlog::info("Wrote {} ({}, {}x{}, {} levels)", sidecar, texfile::format_name(format),
+                     width, height, mip_levels);
+    };
 
-        constexpr bool overrideColors = false;
-        if (overrideColors) {
-            for (Vertex &vtx : vertices) {
-                vtx.color = glm::vec4(vtx.normal, 1.0f);
-            }
+    auto compress_start = std::chrono::high_resolution_clock::now();
+    if (jobs) {
+        jobs->parallel_for((u32)data->images_count, compress_job);
+    } else {
+        for (u32 i = 0; i < data->images_count; i++) {
+            compress_job(i);
         }
-        newMesh.meshBuffers = engine->upload_mesh(indices, vertices);
-        meshes.emplace_back(std::make_shared<MeshAsset>(std::move(newMesh)));
     }
-
+    auto compress_end = std::chrono::high_resolution_clock::now();
     cgltf_free(data);
-    return meshes;
+
+    size_t source_total = 0;
+    size_t compressed_total = 0;
+    for (size_t i = 0; i < source_sizes.size(); i++)
+    {
+        source_total += source_sizes[i];
+        compressed_total += compressed_sizes[i];
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(compress_end - compress_start);
+    spdlog::info("Compressed the textures of {} in {:.2f} ms: {:.2f} MB of RGBA8 mips down to {:.2f} MB ({:.1f}x)",
+                 path, elapsed.count() / 1000.f, source_total / (1024.0 * 1024.0),
+                 compressed_total / (1024.0 * 1024.0),
+                 compressed_total > 0 ? (double)source_total / compressed_total : 0.0);
+    return failed == 0;
 }
@@ -1,12 +1,20 @@
 #pragma once
 
 #include "core/vk_descriptors.h"
+#include "core/bvh.h"
+#include "core/scene_graph.h"
 #include <core/types.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <memory>
 #include <optional>
 #include <unordered_map>
 
 class VulkanEngine;
+struct JobSystem;
+struct RenderObject;
 
 struct GLTFMaterial {
     MaterialInstance data;
@@ -40,23 +48,181 @@ namespace gltf {
     std::optional<std::vector<std::shared_ptr<MeshAsset>>>
         loadMeshes(VulkanEngine *engine, const char *filePath);
     
+    // NOTE(champ): one surface of a mesh node of the scene graph, the items of
+    // the scene BVH
+    struct SceneSurface {
+        u32 node;
+        u32 surface;
+    };
+    
     struct LoadedScene : public IRenderable {
         std::unordered_map<std::string, std::shared_ptr<MeshAsset>> meshes;
         std::unordered_map<std::string, std::shared_ptr<Node>> nodes;
+        // NOTE(champ): the images belong to the engine texture cache, the
+        // scene holds one reference per key in texture_keys
         std::unordered_map<std::string, AllocatedImage> images;
+        std::vector<u64> texture_keys;
         std::unordered_map<std::string, std::shared_ptr<GLTFMaterial>> materials;
         std::vector<std::shared_ptr<Node>> top_nodes;
         std::vector<VkSampler> samplers;
         
+        // flattened copy of the tree below top_nodes, which is the source of
+        // truth for transforms once loading is done
+        SceneGraph graph;
+        std::vector<SceneSurface> surfaces;
+        // surfaces of graph node n are [node_surfaces[n], node_surfaces[n + 1])
+        std::vector<u32> node_surfaces;
+        // NOTE(champ): the handle of each surface in the engine render list,
+        // filled by the first update(). Later updates only move the objects
+        // of nodes that moved, clear_all takes them out again.
+        std::vector<u32> render_handles;
+        glm::mat4 registered_top_matrix;
+        bool registered = false;
+        // over the surface bounds moved by their node's worldTransform
+        BVH bvh;
+        
         DescriptorAllocatorGrowable descriptor_pool;
         AllocatedBuffer material_data_buffer;
         VulkanEngine* creator;
         
-        ~LoadedScene() { clear_all(); } 
+        ~LoadedScene();
+        // propagates the dirty transforms, refits the BVH and registers or
+        // moves the surfaces in the render list. Returns false when nothing
+        // changed since last call
+        bool update(const glm::mat4& top_matrix);
         virtual void draw(const glm::mat4& top_matrix, DrawContext& ctx);
+        // sets visible[handle] for the surfaces touching the frustum, which
+        // has to be in the space of the scene (built from viewproj *
+        // top_matrix). Call after update. Returns the number of BVH nodes
+        // visited
+        u32 mark_visible(const Frustum& frustum, std::vector<u8>& visible) const;
+        void build_bvh();
+        // call after node transforms changed
+        void refit_bvh();
+        // takes the surfaces out of the render list, main thread only
+        void unregister();
+        // unregisters and destroys the GPU resources, which no frame in
+        // flight may use anymore
         void clear_all();
     };
     
-    std::optional<std::shared_ptr<LoadedScene>> load_scene_from_file(VulkanEngine* engine, std::string_view path);
+    // NOTE(champ): written by the loader as it goes, can be read from any thread
+    struct LoadProgress {
+        std::atomic<u32> completed{0};
+        std::atomic<u32> total{1};
+        
+        float fraction() const { return (float)completed.load() / (float)std::max(total.load(), 1u); }
+    };
+    
+    // NOTE(champ): a scene on the CPU, ready to be turned into GPU objects by
+    // create_scene. It is either converted from a glTF file or points into a
+    // mapped bake, see scene_bake.h. Pixels, vertices and indices are not
+    // owned, whoever filled it keeps them alive until create_scene returns.
+    struct SceneSampler {
+        VkFilter mag_filter;
+        VkFilter min_filter;
+        VkSamplerMipmapMode mipmap_mode;
+    };
+    
+    struct SceneImage {
+        std::string name;
+        // null when the image could not be decoded
+        const void* pixels;
+        size_t size;
+        u32 width;
+        u32 height;
+        VkFormat format;
+        // levels packed in pixels, largest first. 0 when pixels only holds
+        // the base level and the mips get built on the GPU
+        u32 mip_levels;
+        // key in the engine texture cache, 0 to key it by its pixels. pixels
+        // may be null when the key is known to be cached
+        u64 content_key;
+    };
+    
+    struct SceneMaterial {
+        std::string name;
+        glm::vec4 color_factors;
+        glm::vec4 metal_rough_factors;
+        MaterialPass pass;
+        // -1 for the engine's white image and default sampler
+        i32 color_image;
+        i32 color_sampler;
+    };
+    
+    struct SceneMesh {
+        std::string name;
+        const Vertex* vertices;
+        u32 vertex_count;
+        const u32* indices;
+        u32 index_count;
+        // materials are left empty, surface_materials indexes the scene's
+        std::vector<GeoSurface> surfaces;
+        std::vector<u32> surface_materials;
+    };
+    
+    struct SceneNode {
+        std::string name;
+        // -1 for root nodes
+        i32 parent;
+        // -1 for nodes without a mesh
+        i32 mesh;
+        glm::mat4 local_transform;
+    };
+    
+    struct SceneDescription {
+        std::vector<SceneSampler> samplers;
+        std::vector<SceneImage> images;
+        std::vector<SceneMaterial> materials;
+        std::vector<SceneMesh> meshes;
+        std::vector<SceneNode> nodes;
+    };
+    
+    // creates the samplers, textures, meshes and materials of the description
+    // with a single upload batch, then its node tree, graph and BVH
+    std::shared_ptr<LoadedScene> create_scene(VulkanEngine* engine, const SceneDescription& description,
+                                              LoadProgress* progress = nullptr);
+    
+    // NOTE(champ): parallel spreads image decoding and mesh conversion over
+    // the engine job system, the serial path is kept for comparison. An up to
+    // date bake next to the file is loaded instead unless use_bake is false.
+    std::optional<std::shared_ptr<LoadedScene>> load_scene_from_file(VulkanEngine* engine, std::string_view path,
+                                                                     bool parallel = true,
+                                                                     LoadProgress* progress = nullptr,
+                                                                     bool use_bake = true);
+    
+    // maps a bake written by bake_scene and creates the scene straight from it
+    std::optional<std::shared_ptr<LoadedScene>> load_scene_from_bake(VulkanEngine* engine, std::string_view bake_path,
+                                                                     LoadProgress* progress = nullptr);
+    
+    // converts the glTF file at path and writes its bake next to it, does not
+    // need an initialized engine. jobs may be null to convert serially
+    bool bake_scene(std::string_view path, JobSystem* jobs);
+    
+    // NOTE(champ): offline texture tool, compresses every image of the file
+    // with its mips into a KTX2 sidecar that loads pick up instead of the
+    // image. forced_format is one of the BCn formats, or VK_FORMAT_UNDEFINED
+    // to pick BC5 for normal maps, BC3 with alpha and BC1 otherwise
+    bool compress_textures(std::string_view path, JobSystem* jobs, VkFormat forced_format);
+    
+    // CPU only, converts every mesh of the file iterations times and appends
+    // the time of each pass in ms. bulk picks the packed accessor fast path
+    // over reading every element through cgltf, for the vertex benchmark
+    bool time_mesh_conversion(std::string_view path, u32 iterations, bool bulk,
+                              std::vector<float>& times, u64* vertex_count);
+    
+    // NOTE(champ): a load running on its own thread, the render loop polls
+    // is_ready() and picks up the scene from the future once it is done
+    struct AsyncSceneLoad {
+        std::string name;
+        std::string path;
+        LoadProgress progress;
+        std::future<std::optional<std::shared_ptr<LoadedScene>>> result;
+        
+        bool is_ready() const { return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+    };
+    
+    std::shared_ptr<AsyncSceneLoad> load_scene_async(VulkanEngine* engine, const std::string& name,
+                                                     const std::string& path);
     
 }
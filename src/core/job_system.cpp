@@ -0,0 +1,134 @@
+#include "core/job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+void
+JobSystem::init(u32 workerCount)
+{
+    stopping = false;
+    workers.reserve(workerCount);
+    for (u32 i = 0; i < workerCount; i++) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+    spdlog::info("Job system started with {} worker threads.", workerCount);
+}
+
+void
+JobSystem::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    jobs.clear();
+    highJobs.clear();
+    highPending = 0;
+}
+
+void
+JobSystem::submit(std::function<void()>&& job, JobPriority priority)
+{
+    if (workers.empty()) {
+        job();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (priority == JobPriority::HIGH) {
+            highJobs.push_back(std::move(job));
+            highPending += 1;
+        } else {
+            jobs.push_back(std::move(job));
+        }
+    }
+    wake.notify_one();
+}
+
+// NOTE(champ): helpers grab indices from a shared counter, the state is ref
+// counted since a helper may only start running after parallel_for returned.
+// job is only called for indices below total, so it is never used once
+// parallel_for returned
+struct JobSystem::ParallelState {
+    std::atomic<u32> next{0};
+    std::atomic<u32> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    const std::function<void(u32)>* job;
+    u32 total;
+    JobPriority priority;
+};
+
+void
+JobSystem::run_parallel_items(const std::shared_ptr<ParallelState>& state, bool helper)
+{
+    u32 index;
+    while ((index = state->next.fetch_add(1)) < state->total) {
+        (*state->job)(index);
+        if (state->done.fetch_add(1) + 1 == state->total) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->finished.notify_all();
+        }
+        // let waiting frame work go first, this helper goes back in line. The
+        // calling thread never steps aside, it is the one waiting for the items
+        if (helper && state->priority == JobPriority::NORMAL && highPending.load() > 0
+            && state->next.load() < state->total) {
+            submit([this, state]() { run_parallel_items(state, true); }, JobPriority::NORMAL);
+            return;
+        }
+    }
+}
+
+void
+JobSystem::parallel_for(u32 count, const std::function<void(u32)>& job, JobPriority priority)
+{
+    if (count == 0) {
+        return;
+    }
+
+    auto state = std::make_shared<ParallelState>();
+    state->job = &job;
+    state->total = count;
+    state->priority = priority;
+
+    const u32 helperCount = std::min(worker_count(), count - 1);
+    for (u32 i = 0; i < helperCount; i++) {
+        submit([this, state]() { run_parallel_items(state, true); }, priority);
+    }
+
+    // the calling thread works too, then waits for the items other threads took
+    run_parallel_items(state, false);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done.load() == count; });
+}
+
+void
+JobSystem::worker_loop()
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty() || !highJobs.empty(); });
+            if (stopping && jobs.empty() && highJobs.empty()) {
+                return;
+            }
+            if (!highJobs.empty()) {
+                job = std::move(highJobs.front());
+                highJobs.pop_front();
+                highPending -= 1;
+            } else {
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+        }
+        job();
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "core/types.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// NOTE(champ): very small thread pool, enough to spread loading work over
+// the available cores. The thread calling parallel_for also takes part in the
+// work, so nested calls and zero worker pools never deadlock.
+// Frame work (HIGH) is picked before loading work (NORMAL), and NORMAL
+// helpers step aside between two items while HIGH jobs are waiting, so a
+// load only holds a worker for the one item it is running.
+enum class JobPriority {
+    NORMAL,
+    HIGH,
+};
+
+struct JobSystem {
+    void init(u32 workerCount);
+    void shutdown();
+
+    // runs job(i) for every i in [0, count) and returns once all are done
+    void parallel_for(u32 count, const std::function<void(u32)>& job,
+                      JobPriority priority = JobPriority::NORMAL);
+    // runs job on a worker thread, or inline if there are no workers
+    void submit(std::function<void()>&& job, JobPriority priority = JobPriority::NORMAL);
+
+    u32 worker_count() const { return (u32)workers.size(); }
+
+    private:
+    struct ParallelState;
+    void worker_loop();
+    void run_parallel_items(const std::shared_ptr<ParallelState>& state, bool helper);
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::deque<std::function<void()>> highJobs;
+    // highJobs.size(), read by NORMAL helpers without the mutex
+    std::atomic<u32> highPending{0};
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "core/types.h"
+#include <string>
+
+//> mapped_file
+// NOTE(champ): read only view of a whole file, the pages are loaded by the OS
+// as they are touched instead of being read up front
+struct MappedFile {
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path);
+    void close();
+
+    const u8* data = nullptr;
+    size_t size = 0;
+
+    private:
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
+//< mapped_file
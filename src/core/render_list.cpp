@@ -0,0 +1,98 @@
+#include "core/render_list.h"
+
+#include "core/engine.h"
+
+#include <algorithm>
+
+static bool
+is_transparent(const RenderObject& obj)
+{
+    return obj.material->passType == MaterialPass::GLTF_PBR_TRANSPARENT;
+}
+
+//> render_list
+void
+RenderList::add(const std::vector<RenderObject>& added, std::vector<u32>& handles)
+{
+    if (added.empty()) {
+        return;
+    }
+
+    std::vector<u32> newOpaque;
+    for (const RenderObject& obj : added) {
+        u32 handle;
+        if (!freeSlots.empty()) {
+            handle = freeSlots.back();
+            freeSlots.pop_back();
+            objects[handle] = obj;
+            alive[handle] = 1;
+            stateKeys[handle] = sortIds.state_key(obj);
+        } else {
+            handle = size();
+            objects.push_back(obj);
+            alive.push_back(1);
+            stateKeys.push_back(sortIds.state_key(obj));
+        }
+        handles.push_back(handle);
+
+        if (is_transparent(obj)) {
+            transparentOrder.push_back(handle);
+        } else {
+            newOpaque.push_back(handle);
+        }
+    }
+
+    // NOTE(champ): sorting only what was added and merging it in keeps a scene
+    // load linear in the size of the list instead of one insert per surface
+    auto order = [&](u32 a, u32 b) { return stateKeys[a] < stateKeys[b]; };
+    std::sort(newOpaque.begin(), newOpaque.end(), order);
+    size_t middle = opaqueOrder.size();
+    opaqueOrder.insert(opaqueOrder.end(), newOpaque.begin(), newOpaque.end());
+    std::inplace_merge(opaqueOrder.begin(), opaqueOrder.begin() + middle, opaqueOrder.end(), order);
+
+    version += 1;
+}
+
+void
+RenderList::remove(const std::vector<u32>& handles)
+{
+    if (handles.empty()) {
+        return;
+    }
+
+    for (u32 handle : handles) {
+        alive[handle] = 0;
+        freeSlots.push_back(handle);
+        sortIds.release(objects[handle]);
+    }
+    auto dead = [&](u32 handle) { return alive[handle] == 0; };
+    opaqueOrder.erase(std::remove_if(opaqueOrder.begin(), opaqueOrder.end(), dead), opaqueOrder.end());
+    transparentOrder.erase(std::remove_if(transparentOrder.begin(), transparentOrder.end(), dead),
+                           transparentOrder.end());
+
+    version += 1;
+}
+
+void
+RenderList::set_transform(u32 handle, const glm::mat4& transform)
+{
+    // the transform is not part of the sort key, the order stays as it is
+    objects[handle].transform = transform;
+    movedHandles.push_back(handle);
+    transformVersion += 1;
+}
+
+void
+RenderList::clear()
+{
+    objects.clear();
+    alive.clear();
+    stateKeys.clear();
+    opaqueOrder.clear();
+    transparentOrder.clear();
+    freeSlots.clear();
+    sortIds.clear();
+    movedHandles.clear();
+    version += 1;
+}
+//< render_list
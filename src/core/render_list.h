@@ -0,0 +1,47 @@
+#pragma once
+
+#include "core/types.h"
+#include "core/draw_sort.h"
+#include <vector>
+
+struct RenderObject;
+
+//> render_list
+// NOTE(champ): retained list of everything that can be drawn. Surfaces are
+// added once when their scene shows up and removed with it, moving one only
+// rewrites its transform and leaves version as it is. The opaque order is kept sorted by the state part
+// of the sort keys as objects come and go.
+// Handles are slots in objects and stay valid until removed.
+struct RenderList {
+    // appends the handle of every added object to handles, in order
+    void add(const std::vector<RenderObject>& added, std::vector<u32>& handles);
+    void remove(const std::vector<u32>& handles);
+    void set_transform(u32 handle, const glm::mat4& transform);
+    void clear();
+
+    u32 size() const { return (u32)alive.size(); }
+    bool is_alive(u32 handle) const { return alive[handle] != 0; }
+
+    // indexed by handle, dead slots keep their last object until reused
+    std::vector<RenderObject> objects;
+    std::vector<u8> alive;
+    // pipeline | material | mesh bits of the sort key of each object, the
+    // frame adds the depth, see draw_sort.h
+    std::vector<u64> stateKeys;
+    // handles of the live opaque objects, sorted by their state key
+    std::vector<u32> opaqueOrder;
+    // handles of the live transparent objects, in the order they were added
+    std::vector<u32> transparentOrder;
+    // bumped when objects come or go, tells users when what they derived
+    // from the set of objects or their order is stale
+    u64 version = 0;
+    // bumped by set_transform only, the handles written since the user last
+    // cleared it are in movedHandles, possibly more than once
+    u64 transformVersion = 0;
+    std::vector<u32> movedHandles;
+
+    private:
+    std::vector<u32> freeSlots;
+    SortKeyIds sortIds;
+};
+//< render_list
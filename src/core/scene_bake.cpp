@@ -0,0 +1,418 @@
+#include "core/scene_bake.h"
+
+#include "core/vk_images.h"
+#include "core/vk_upload.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<bake::Header>::value, "bake records are written as is");
+static_assert(std::is_trivially_copyable<bake::Image>::value, "bake records are written as is");
+static_assert(std::is_trivially_copyable<bake::Material>::value, "bake records are written as is");
+static_assert(std::is_trivially_copyable<bake::Mesh>::value, "bake records are written as is");
+static_assert(std::is_trivially_copyable<bake::Surface>::value, "bake records are written as is");
+static_assert(std::is_trivially_copyable<bake::Node>::value, "bake records are written as is");
+static_assert(std::is_trivially_copyable<bake::Dependency>::value, "bake records are written as is");
+static_assert(std::is_trivially_copyable<Vertex>::value, "vertices are written as is");
+
+//> scene_bake
+static u64
+align_offset(u64 offset)
+{
+    return (offset + bake::BAKE_ALIGNMENT - 1) & ~(bake::BAKE_ALIGNMENT - 1);
+}
+
+static bool
+source_stamp(std::string_view sourcePath, u64& size, i64& time)
+{
+    std::error_code error;
+    std::filesystem::path path(sourcePath);
+    size = (u64)std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    time = (i64)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    return !error;
+}
+
+static std::filesystem::path
+dependency_path(std::string_view sourcePath, const std::string& dependency)
+{
+    return std::filesystem::path(sourcePath).parent_path() / dependency;
+}
+
+std::string
+bake::bake_path(std::string_view sourcePath)
+{
+    return std::string(sourcePath) + ".bake";
+}
+
+bool
+bake::is_up_to_date(std::string_view sourcePath)
+{
+    u64 sourceSize;
+    i64 sourceTime;
+    if (!source_stamp(sourcePath, sourceSize, sourceTime)) {
+        return false;
+    }
+
+    std::ifstream file(bake_path(sourcePath), std::ios::binary);
+    Header header = {};
+    if (!file.read((char*)&header, sizeof(header))) {
+        return false;
+    }
+    if (header.magic != BAKE_MAGIC || header.version != BAKE_VERSION
+        || header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+        return false;
+    }
+
+    // NOTE(champ): only the dependency table and the strings are read, the
+    // rest of the bake is left to the mapping in read
+    if (header.dependenciesOffset > header.fileSize
+        || header.dependencyCount > (header.fileSize - header.dependenciesOffset) / sizeof(Dependency)
+        || header.stringsOffset > header.fileSize
+        || header.stringsSize > header.fileSize - header.stringsOffset) {
+        return false;
+    }
+    std::vector<Dependency> dependencies(header.dependencyCount);
+    std::string strings(header.stringsSize, '\0');
+    if (!file.seekg((std::streamoff)header.dependenciesOffset)
+        || !file.read((char*)dependencies.data(), dependencies.size() * sizeof(Dependency))
+        || !file.seekg((std::streamoff)header.stringsOffset)
+        || !file.read(strings.data(), strings.size())) {
+        return false;
+    }
+    for (const Dependency& dependency : dependencies) {
+        if ((u64)dependency.path.offset + dependency.path.length > strings.size()) {
+            return false;
+        }
+        std::string path = strings.substr(dependency.path.offset, dependency.path.length);
+        u64 size = 0;
+        i64 time = 0;
+        bool exists = source_stamp(dependency_path(sourcePath, path).string(), size, time);
+        if (exists != (dependency.exists != 0)) {
+            return false;
+        }
+        if (exists && (size != dependency.size || time != dependency.time)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+bake::write(std::string_view sourcePath,
+            const gltf::SceneDescription& description,
+            const std::vector<std::string>& dependencies)
+{
+    Header header = {};
+    header.magic = BAKE_MAGIC;
+    header.version = BAKE_VERSION;
+    if (!source_stamp(sourcePath, header.sourceSize, header.sourceTime)) {
+        spdlog::error("Failed to read the size and time of {}!", sourcePath);
+        return false;
+    }
+
+    std::string strings;
+    auto add_string = [&](const std::string& str) {
+        StringRef ref = { (u32)strings.size(), (u32)str.size() };
+        strings += str;
+        return ref;
+    };
+
+    std::vector<Sampler> samplers;
+    for (const gltf::SceneSampler& sampler : description.samplers) {
+        samplers.push_back({ (u32)sampler.mag_filter, (u32)sampler.min_filter, (u32)sampler.mipmap_mode });
+    }
+
+    std::vector<Image> images;
+    for (const gltf::SceneImage& image : description.images) {
+        Image record = {};
+        record.name = add_string(image.name);
+        record.width = image.width;
+        record.height = image.height;
+        record.format = (u32)image.format;
+        record.mipLevels = image.mip_levels;
+        record.contentKey = image.content_key;
+        record.dataSize = image.pixels ? image.size : 0;
+        images.push_back(record);
+    }
+
+    std::vector<Material> materials;
+    for (const gltf::SceneMaterial& material : description.materials) {
+        Material record = {};
+        record.name = add_string(material.name);
+        record.colorFactors = material.color_factors;
+        record.metalRoughFactors = material.metal_rough_factors;
+        record.pass = (u32)material.pass;
+        record.colorImage = material.color_image;
+        record.colorSampler = material.color_sampler;
+        materials.push_back(record);
+    }
+
+    std::vector<Mesh> meshes;
+    std::vector<Surface> surfaces;
+    for (const gltf::SceneMesh& mesh : description.meshes) {
+        Mesh record = {};
+        record.name = add_string(mesh.name);
+        record.firstSurface = (u32)surfaces.size();
+        record.surfaceCount = (u32)mesh.surfaces.size();
+        record.vertexCount = mesh.vertex_count;
+        record.indexCount = mesh.index_count;
+        meshes.push_back(record);
+
+        for (size_t i = 0; i < mesh.surfaces.size(); i++) {
+            const GeoSurface& surface = mesh.surfaces[i];
+            surfaces.push_back({ surface.startIndex, surface.count, mesh.surface_materials[i], surface.bounds });
+        }
+    }
+
+    std::vector<Node> nodes;
+    for (const gltf::SceneNode& node : description.nodes) {
+        nodes.push_back({ add_string(node.name), node.parent, node.mesh, node.local_transform });
+    }
+
+    std::vector<Dependency> stamps;
+    for (const std::string& dependency : dependencies) {
+        Dependency record = {};
+        record.path = add_string(dependency);
+        record.exists = source_stamp(dependency_path(sourcePath, dependency).string(), record.size, record.time);
+        if (!record.exists) {
+            record.size = 0;
+            record.time = 0;
+        }
+        stamps.push_back(record);
+    }
+
+    // @SECTION: layout, the tables first and then the blobs
+    u64 offset = align_offset(sizeof(Header));
+    auto place_table = [&](u64& tableOffset, size_t size) {
+        tableOffset = offset;
+        offset = align_offset(offset + size);
+    };
+    header.samplerCount = (u32)samplers.size();
+    header.imageCount = (u32)images.size();
+    header.materialCount = (u32)materials.size();
+    header.meshCount = (u32)meshes.size();
+    header.surfaceCount = (u32)surfaces.size();
+    header.nodeCount = (u32)nodes.size();
+    header.dependencyCount = (u32)stamps.size();
+    place_table(header.samplersOffset, samplers.size() * sizeof(Sampler));
+    place_table(header.imagesOffset, images.size() * sizeof(Image));
+    place_table(header.materialsOffset, materials.size() * sizeof(Material));
+    place_table(header.meshesOffset, meshes.size() * sizeof(Mesh));
+    place_table(header.surfacesOffset, surfaces.size() * sizeof(Surface));
+    place_table(header.nodesOffset, nodes.size() * sizeof(Node));
+    place_table(header.dependenciesOffset, stamps.size() * sizeof(Dependency));
+    place_table(header.stringsOffset, strings.size());
+    header.stringsSize = strings.size();
+
+    for (Mesh& mesh : meshes) {
+        place_table(mesh.verticesOffset, (size_t)mesh.vertexCount * sizeof(Vertex));
+        place_table(mesh.indicesOffset, (size_t)mesh.indexCount * sizeof(u32));
+    }
+    for (Image& image : images) {
+        place_table(image.dataOffset, image.dataSize);
+    }
+    header.fileSize = offset;
+
+    // @SECTION: write, into a temporary file that replaces the bake once
+    // complete so a failed bake never looks valid
+    const std::string path = bake_path(sourcePath);
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            spdlog::error("Failed to open {} for writing!", tempPath);
+            return false;
+        }
+
+        u64 written = 0;
+        auto write_at = [&](u64 at, const void* data, size_t size) {
+            static const char zeros[BAKE_ALIGNMENT] = {};
+            while (written < at) {
+                size_t padding = (size_t)std::min<u64>(at - written, sizeof(zeros));
+                file.write(zeros, padding);
+                written += padding;
+            }
+            file.write((const char*)data, size);
+            written += size;
+        };
+
+        write_at(0, &header, sizeof(header));
+        write_at(header.samplersOffset, samplers.data(), samplers.size() * sizeof(Sampler));
+        write_at(header.imagesOffset, images.data(), images.size() * sizeof(Image));
+        write_at(header.materialsOffset, materials.data(), materials.size() * sizeof(Material));
+        write_at(header.meshesOffset, meshes.data(), meshes.size() * sizeof(Mesh));
+        write_at(header.surfacesOffset, surfaces.data(), surfaces.size() * sizeof(Surface));
+        write_at(header.nodesOffset, nodes.data(), nodes.size() * sizeof(Node));
+        write_at(header.dependenciesOffset, stamps.data(), stamps.size() * sizeof(Dependency));
+        write_at(header.stringsOffset, strings.data(), strings.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const gltf::SceneMesh& mesh = description.meshes[i];
+            write_at(meshes[i].verticesOffset, mesh.vertices, (size_t)mesh.vertex_count * sizeof(Vertex));
+            write_at(meshes[i].indicesOffset, mesh.indices, (size_t)mesh.index_count * sizeof(u32));
+        }
+        for (size_t i = 0; i < images.size(); i++) {
+            write_at(images[i].dataOffset, description.images[i].pixels, images[i].dataSize);
+        }
+        write_at(header.fileSize, nullptr, 0);
+
+        if (!file) {
+            spdlog::error("Failed to write {}!", tempPath);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        spdlog::error("Failed to move {} to {}: {}", tempPath, path, error.message());
+        return false;
+    }
+    spdlog::info("Baked {} into {} ({:.1f} MB)", sourcePath, path, (double)header.fileSize / (1024.0 * 1024.0));
+    return true;
+}
+
+bool
+bake::read(const std::string& bakePath, MappedFile& file, gltf::SceneDescription& description)
+{
+    if (!file.open(bakePath)) {
+        spdlog::error("Failed to map {}!", bakePath);
+        return false;
+    }
+
+    Header header = {};
+    if (file.size >= sizeof(header)) {
+        memcpy(&header, file.data, sizeof(header));
+    }
+    if (header.magic != BAKE_MAGIC || header.version != BAKE_VERSION || header.fileSize != file.size) {
+        spdlog::error("{} is not a version {} bake!", bakePath, BAKE_VERSION);
+        file.close();
+        return false;
+    }
+
+    // NOTE(champ): only the structure is checked, a bake is trusted to hold
+    // what bake::write put in it
+    auto fits = [&](u64 offset, u64 count, u64 stride) {
+        return offset <= file.size && count <= (file.size - offset) / stride;
+    };
+    bool valid = fits(header.samplersOffset, header.samplerCount, sizeof(Sampler))
+        && fits(header.imagesOffset, header.imageCount, sizeof(Image))
+        && fits(header.materialsOffset, header.materialCount, sizeof(Material))
+        && fits(header.meshesOffset, header.meshCount, sizeof(Mesh))
+        && fits(header.surfacesOffset, header.surfaceCount, sizeof(Surface))
+        && fits(header.nodesOffset, header.nodeCount, sizeof(Node))
+        && fits(header.dependenciesOffset, header.dependencyCount, sizeof(Dependency))
+        && fits(header.stringsOffset, header.stringsSize, 1);
+
+    const Sampler* samplers = (const Sampler*)(file.data + header.samplersOffset);
+    const Image* images = (const Image*)(file.data + header.imagesOffset);
+    const Material* materials = (const Material*)(file.data + header.materialsOffset);
+    const Mesh* meshes = (const Mesh*)(file.data + header.meshesOffset);
+    const Surface* surfaces = (const Surface*)(file.data + header.surfacesOffset);
+    const Node* nodes = (const Node*)(file.data + header.nodesOffset);
+    const char* strings = (const char*)(file.data + header.stringsOffset);
+
+    auto read_string = [&](StringRef ref) {
+        if ((u64)ref.offset + ref.length > header.stringsSize) {
+            valid = false;
+            return std::string();
+        }
+        return std::string(strings + ref.offset, ref.length);
+    };
+
+    for (u32 i = 0; valid && i < header.samplerCount; i++) {
+        description.samplers.push_back({ (VkFilter)samplers[i].magFilter, (VkFilter)samplers[i].minFilter,
+                                         (VkSamplerMipmapMode)samplers[i].mipmapMode });
+    }
+
+    for (u32 i = 0; valid && i < header.imageCount; i++) {
+        const Image& image = images[i];
+        // NOTE(champ): the uploader trusts the size implied by the format, so
+        // the blob has to hold at least that. Compressed images can not be
+        // blitted and always come with their mips
+        size_t expectedSize = image.mipLevels > 0
+            ? vkutil::mip_chain_size((VkFormat)image.format, image.width, image.height, image.mipLevels)
+            : vkutil::mip_level_size((VkFormat)image.format, image.width, image.height);
+        valid = fits(image.dataOffset, image.dataSize, 1)
+            && (image.dataSize == 0 || (expectedSize > 0 && image.dataSize >= expectedSize))
+            && image.mipLevels <= MAX_MIP_LEVELS
+            && (image.mipLevels > 0 || !vkutil::is_block_compressed((VkFormat)image.format));
+
+        gltf::SceneImage sceneImage = {};
+        sceneImage.name = read_string(image.name);
+        sceneImage.pixels = image.dataSize > 0 ? file.data + image.dataOffset : nullptr;
+        sceneImage.size = (size_t)image.dataSize;
+        sceneImage.width = image.width;
+        sceneImage.height = image.height;
+        sceneImage.format = (VkFormat)image.format;
+        sceneImage.mip_levels = image.mipLevels;
+        sceneImage.content_key = image.contentKey;
+        description.images.push_back(sceneImage);
+    }
+
+    for (u32 i = 0; valid && i < header.materialCount; i++) {
+        const Material& material = materials[i];
+        valid = material.colorImage >= -1 && material.colorImage < (i32)header.imageCount
+            && material.colorSampler >= -1 && material.colorSampler < (i32)header.samplerCount;
+
+        gltf::SceneMaterial sceneMaterial = {};
+        sceneMaterial.name = read_string(material.name);
+        sceneMaterial.color_factors = material.colorFactors;
+        sceneMaterial.metal_rough_factors = material.metalRoughFactors;
+        sceneMaterial.pass = (MaterialPass)material.pass;
+        sceneMaterial.color_image = material.colorImage;
+        sceneMaterial.color_sampler = material.colorSampler;
+        description.materials.push_back(sceneMaterial);
+    }
+
+    for (u32 i = 0; valid && i < header.meshCount; i++) {
+        const Mesh& mesh = meshes[i];
+        valid = fits(mesh.verticesOffset, mesh.vertexCount, sizeof(Vertex))
+            && fits(mesh.indicesOffset, mesh.indexCount, sizeof(u32))
+            && (u64)mesh.firstSurface + mesh.surfaceCount <= header.surfaceCount;
+        if (!valid) {
+            break;
+        }
+
+        gltf::SceneMesh sceneMesh = {};
+        sceneMesh.name = read_string(mesh.name);
+        sceneMesh.vertices = (const Vertex*)(file.data + mesh.verticesOffset);
+        sceneMesh.vertex_count = mesh.vertexCount;
+        sceneMesh.indices = (const u32*)(file.data + mesh.indicesOffset);
+        sceneMesh.index_count = mesh.indexCount;
+        for (u32 s = mesh.firstSurface; s < mesh.firstSurface + mesh.surfaceCount; s++) {
+            const Surface& surface = surfaces[s];
+            valid = valid && surface.material < header.materialCount
+                && (u64)surface.startIndex + surface.count <= mesh.indexCount;
+
+            GeoSurface geoSurface = {};
+            geoSurface.startIndex = surface.startIndex;
+            geoSurface.count = surface.count;
+            geoSurface.bounds = surface.bounds;
+            sceneMesh.surfaces.push_back(geoSurface);
+            sceneMesh.surface_materials.push_back(surface.material);
+        }
+        description.meshes.push_back(std::move(sceneMesh));
+    }
+
+    for (u32 i = 0; valid && i < header.nodeCount; i++) {
+        const Node& node = nodes[i];
+        valid = node.parent >= -1 && node.parent < (i32)header.nodeCount
+            && node.mesh >= -1 && node.mesh < (i32)header.meshCount;
+        description.nodes.push_back({ read_string(node.name), node.parent, node.mesh, node.localTransform });
+    }
+
+    if (!valid) {
+        spdlog::error("{} is corrupted!", bakePath);
+        description = {};
+        file.close();
+        return false;
+    }
+    return true;
+}
+//< scene_bake
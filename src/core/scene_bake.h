@@ -0,0 +1,134 @@
+#pragma once
+
+#include "core/types.h"
+#include "core/gltf_loader.h"
+#include "core/mapped_file.h"
+#include <string>
+#include <string_view>
+
+//> scene_bake
+// NOTE(champ): a bake is a glTF scene converted offline to what create_scene
+// consumes. The file is a header, the tables below and then the vertex,
+// index and pixel blobs, each aligned to BAKE_ALIGNMENT so the uploader can
+// copy them straight out of the mapping. Every record is plain data written
+// as is, a new layout needs a new BAKE_VERSION.
+namespace bake {
+    constexpr u32 BAKE_MAGIC = 0x454b4142; // "BAKE"
+    constexpr u32 BAKE_VERSION = 3;
+    constexpr u64 BAKE_ALIGNMENT = 16;
+
+    struct StringRef {
+        u32 offset;
+        u32 length;
+    };
+
+    struct Header {
+        u32 magic;
+        u32 version;
+        // size and modification time of the source file, the bake is stale
+        // once they do not match anymore
+        u64 sourceSize;
+        i64 sourceTime;
+        u64 fileSize;
+
+        u32 samplerCount;
+        u32 imageCount;
+        u32 materialCount;
+        u32 meshCount;
+        u32 surfaceCount;
+        u32 nodeCount;
+        u32 dependencyCount;
+        u32 pad;
+
+        // from the start of the file
+        u64 samplersOffset;
+        u64 imagesOffset;
+        u64 materialsOffset;
+        u64 meshesOffset;
+        u64 surfacesOffset;
+        u64 nodesOffset;
+        u64 dependenciesOffset;
+        u64 stringsOffset;
+        u64 stringsSize;
+    };
+
+    // NOTE(champ): another file the bake was made from (external buffers,
+    // images and their sidecars), stamped like the source. Files that did
+    // not exist are kept too, since creating one changes the bake
+    struct Dependency {
+        // relative to the directory of the source file
+        StringRef path;
+        u32 exists;
+        u32 pad;
+        u64 size;
+        i64 time;
+    };
+
+    struct Sampler {
+        u32 magFilter;
+        u32 minFilter;
+        u32 mipmapMode;
+    };
+
+    struct Image {
+        StringRef name;
+        u32 width;
+        u32 height;
+        u32 format;
+        // see gltf::SceneImage::mip_levels
+        u32 mipLevels;
+        // a size of 0 when the source image could not be decoded
+        u64 dataOffset;
+        u64 dataSize;
+        // see gltf::SceneImage::content_key
+        u64 contentKey;
+    };
+
+    struct Material {
+        StringRef name;
+        glm::vec4 colorFactors;
+        glm::vec4 metalRoughFactors;
+        u32 pass;
+        i32 colorImage;
+        i32 colorSampler;
+        u32 pad;
+    };
+
+    struct Mesh {
+        StringRef name;
+        // surfaces [firstSurface, firstSurface + surfaceCount) of the table
+        u32 firstSurface;
+        u32 surfaceCount;
+        u32 vertexCount;
+        u32 indexCount;
+        u64 verticesOffset;
+        u64 indicesOffset;
+    };
+
+    struct Surface {
+        u32 startIndex;
+        u32 count;
+        u32 material;
+        Bounds bounds;
+    };
+
+    struct Node {
+        StringRef name;
+        i32 parent;
+        i32 mesh;
+        glm::mat4 localTransform;
+    };
+
+    // <source path>.bake
+    std::string bake_path(std::string_view sourcePath);
+    // true when the bake of sourcePath exists and was written for its current
+    // contents and those of its dependencies by this version
+    bool is_up_to_date(std::string_view sourcePath);
+    // dependencies are relative to the directory of sourcePath
+    bool write(std::string_view sourcePath, const gltf::SceneDescription& description,
+               const std::vector<std::string>& dependencies);
+    // maps the bake and fills description with pointers into it, the mapping
+    // has to outlive every use of the description
+    bool read(const std::string& bakePath, MappedFile& file, gltf::SceneDescription& description);
+}
+//< scene_bake
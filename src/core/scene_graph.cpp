@@ -0,0 +1,193 @@
+#include "core/scene_graph.h"
+
+#include "core/engine.h"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+
+//> scene_graph
+void
+SceneGraph::add_trees(const std::vector<std::shared_ptr<Node>>& roots)
+{
+    // a node may share its mesh with others, each mesh is stored once
+    std::unordered_map<const MeshAsset*, u32> meshLookup;
+    for (u32 i = 0; i < meshes.size(); i++) {
+        meshLookup[meshes[i].get()] = i;
+    }
+
+    struct Pending {
+        Node* node;
+        u32 parent;
+    };
+    std::vector<Pending> stack;
+    for (size_t i = roots.size(); i-- > 0;) {
+        stack.push_back({ roots[i].get(), INVALID_NODE });
+    }
+
+    while (!stack.empty()) {
+        Pending pending = stack.back();
+        stack.pop_back();
+        Node* node = pending.node;
+
+        u32 index = (u32)parents.size();
+        parents.push_back(pending.parent);
+        localTransforms.push_back(node->localTransform);
+        worldTransforms.push_back(node->localTransform);
+        dirty.push_back(0);
+        mark_dirty(index);
+
+        u32 meshId = INVALID_MESH;
+        MeshNode* meshNode = dynamic_cast<MeshNode*>(node);
+        if (meshNode && meshNode->mesh) {
+            auto it = meshLookup.find(meshNode->mesh.get());
+            if (it == meshLookup.end()) {
+                meshId = (u32)meshes.size();
+                meshes.push_back(meshNode->mesh);
+                meshLookup[meshNode->mesh.get()] = meshId;
+            } else {
+                meshId = it->second;
+            }
+        }
+        meshIds.push_back(meshId);
+
+        node->graph = this;
+        node->graphIndex = index;
+
+        for (size_t i = node->children.size(); i-- > 0;) {
+            stack.push_back({ node->children[i].get(), index });
+        }
+    }
+
+    update_transforms();
+}
+
+u32
+SceneGraph::add_node(u32 parent,
+                     const glm::mat4& localTransform,
+                     const std::shared_ptr<MeshAsset>& mesh)
+{
+    assert(parent == INVALID_NODE || parent < size());
+
+    u32 index = size();
+    parents.push_back(parent);
+    localTransforms.push_back(localTransform);
+    worldTransforms.push_back(localTransform);
+    dirty.push_back(0);
+    mark_dirty(index);
+    if (mesh) {
+        meshIds.push_back((u32)meshes.size());
+        meshes.push_back(mesh);
+    } else {
+        meshIds.push_back(INVALID_MESH);
+    }
+    return index;
+}
+
+void
+SceneGraph::set_local_transform(u32 node, const glm::mat4& localTransform)
+{
+    localTransforms[node] = localTransform;
+    mark_dirty(node);
+}
+
+void
+SceneGraph::mark_dirty(u32 node)
+{
+    dirty[node] = 1;
+    firstDirty = hasDirty ? std::min(firstDirty, node) : node;
+    hasDirty = true;
+}
+
+u32
+SceneGraph::update_transforms()
+{
+    changedNodes.clear();
+    if (!hasDirty) {
+        return 0;
+    }
+
+    // parents come first, their world transform is always up to date here and
+    // a dirty parent has already passed its flag down when a child is reached
+    for (u32 i = firstDirty; i < size(); i++) {
+        u32 parent = parents[i];
+        bool parentChanged = parent != INVALID_NODE && dirty[parent];
+        if (!dirty[i] && !parentChanged) {
+            continue;
+        }
+        dirty[i] = 1;
+        worldTransforms[i] = parent == INVALID_NODE ? localTransforms[i]
+            : worldTransforms[parent] * localTransforms[i];
+        changedNodes.push_back(i);
+    }
+
+    for (u32 i : changedNodes) {
+        dirty[i] = 0;
+    }
+    hasDirty = false;
+    return (u32)changedNodes.size();
+}
+
+void
+SceneGraph::draw(const glm::mat4& topMatrix, DrawContext& context) const
+{
+    for (u32 i = 0; i < size(); i++) {
+        const MeshAsset* mesh = mesh_of(i);
+        if (mesh == nullptr) {
+            continue;
+        }
+        glm::mat4 transform = topMatrix * worldTransforms[i];
+        for (u32 s = 0; s < mesh->surfaces.size(); s++) {
+            draw_mesh_surface(*mesh, s, transform, context);
+        }
+    }
+}
+
+void
+SceneGraph::clear()
+{
+    parents.clear();
+    localTransforms.clear();
+    worldTransforms.clear();
+    meshIds.clear();
+    meshes.clear();
+    changedNodes.clear();
+    dirty.clear();
+    hasDirty = false;
+}
+//< scene_graph
+
+//> node_facade
+const glm::mat4&
+Node::world_transform() const
+{
+    return graph ? graph->worldTransforms[graphIndex] : worldTransform;
+}
+
+void
+Node::set_local_transform(const glm::mat4& transform)
+{
+    localTransform = transform;
+    if (graph) {
+        graph->set_local_transform(graphIndex, transform);
+    }
+}
+
+void
+Node::refresh_transform(const glm::mat4& parentMatrix)
+{
+    // NOTE(champ): the graph nodes are only marked dirty, the scene
+    // propagates them in LoadedScene::update so it also sees which moved.
+    // Its roots are relative to the scene, parentMatrix only applies to
+    // detached trees
+    if (graph) {
+        graph->set_local_transform(graphIndex, localTransform);
+        return;
+    }
+
+    worldTransform = parentMatrix * localTransform;
+    for (auto& c: children) {
+        c->refresh_transform(worldTransform);
+    }
+}
+//< node_facade
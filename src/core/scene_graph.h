@@ -0,0 +1,59 @@
+#pragma once
+
+#include "core/types.h"
+#include <memory>
+#include <vector>
+
+struct MeshAsset;
+struct DrawContext;
+
+constexpr u32 INVALID_NODE = ~0u;
+constexpr u32 INVALID_MESH = ~0u;
+
+//> scene_graph
+// NOTE(champ): the nodes of a scene stored as parallel arrays in topological
+// order, a parent always comes before its children. World transforms are then
+// computed in a single linear pass and drawing never follows a pointer between
+// nodes. The Node tree of a scene is kept as a facade over it, see
+// Node::graph. Local transforms are only written through
+// set_local_transform so untouched subtrees are never recomputed.
+struct SceneGraph {
+    // appends the nodes of the trees below roots in depth first order and
+    // points every Node at its slot in the graph
+    void add_trees(const std::vector<std::shared_ptr<Node>>& roots);
+    u32 add_node(u32 parent, const glm::mat4& localTransform, const std::shared_ptr<MeshAsset>& mesh);
+    // marks the node dirty, its subtree gets recomputed by the next update
+    void set_local_transform(u32 node, const glm::mat4& localTransform);
+    // recomputes the world transform of the dirty nodes and their children
+    // only, and lists them in changedNodes. Returns how many changed.
+    u32 update_transforms();
+    // emits every surface of every mesh node, moved by topMatrix
+    void draw(const glm::mat4& topMatrix, DrawContext& context) const;
+    void clear();
+
+    u32 size() const { return (u32)parents.size(); }
+    const MeshAsset* mesh_of(u32 node) const
+    {
+        return meshIds[node] == INVALID_MESH ? nullptr : meshes[meshIds[node]].get();
+    }
+
+    std::vector<u32> parents;
+    std::vector<glm::mat4> localTransforms;
+    std::vector<glm::mat4> worldTransforms;
+    // INVALID_MESH for nodes without a mesh
+    std::vector<u32> meshIds;
+    std::vector<std::shared_ptr<MeshAsset>> meshes;
+
+    // nodes recomputed by the last update_transforms, in order
+    std::vector<u32> changedNodes;
+
+    private:
+    // NOTE(champ): since parents come first, a single pass starting at the
+    // first dirty node reaches every node below it
+    std::vector<u8> dirty;
+    u32 firstDirty = 0;
+    bool hasDirty = false;
+
+    void mark_dirty(u32 node);
+};
+//< scene_graph
@@ -0,0 +1,129 @@
+#include "core/texture_cache.h"
+
+#include "core/engine.h"
+
+#include <algorithm>
+#include <cstring>
+
+//> texture_cache
+void
+TextureCache::init(VulkanEngine* engine)
+{
+    this->engine = engine;
+}
+
+void
+TextureCache::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& [key, entry] : entries) {
+        engine->destroy_image(entry.image);
+    }
+    entries.clear();
+    for (const RetiredImage& image : retired) {
+        engine->destroy_image(image.image);
+    }
+    retired.clear();
+    imageCount = 0;
+    referenceCount = 0;
+}
+
+bool
+TextureCache::acquire(u64 key, AllocatedImage* image)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return false;
+    }
+    it->second.references += 1;
+    referenceCount += 1;
+    if (image) {
+        *image = it->second.image;
+    }
+    return true;
+}
+
+void
+TextureCache::insert(u64 key, AllocatedImage* image)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        // the upload of this load has completed and nothing uses it yet
+        engine->destroy_image(*image);
+        it->second.references += 1;
+        referenceCount += 1;
+        *image = it->second.image;
+        return;
+    }
+    entries[key] = { *image, 1 };
+    imageCount = (u32)entries.size();
+    referenceCount += 1;
+}
+
+void
+TextureCache::release(u64 key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        spdlog::warn("Releasing texture {:016x} which is not cached!", key);
+        return;
+    }
+    it->second.references -= 1;
+    referenceCount -= 1;
+    if (it->second.references == 0) {
+        // NOTE(champ): releases can come from any thread while a frame is
+        // being recorded, so the next submit has to be done with it too
+        retired.push_back({ it->second.image, engine->_frameTimelineValue + 1 });
+        entries.erase(it);
+        imageCount = (u32)entries.size();
+    }
+}
+
+void
+TextureCache::destroy_retired(u64 completedTimelineValue)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto done = [&](const RetiredImage& image) {
+        return image.timelineValue <= completedTimelineValue;
+    };
+    for (const RetiredImage& image : retired) {
+        if (done(image)) {
+            engine->destroy_image(image.image);
+        }
+    }
+    retired.erase(std::remove_if(retired.begin(), retired.end(), done), retired.end());
+}
+
+// NOTE(champ): eight bytes at a time with a multiply and xorshift mix, fast
+// enough to key every embedded image before decoding it
+static u64
+mix(u64 value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+u64
+TextureCache::hash(const void* data, size_t size, u64 seed)
+{
+    const u8* bytes = (const u8*)data;
+    u64 h = mix(seed ^ (size * 0x9e3779b97f4a7c15ull));
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        u64 word;
+        memcpy(&word, bytes + i, sizeof(word));
+        h = mix(h ^ word) + 0x9e3779b97f4a7c15ull;
+    }
+    u64 tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    h = mix(h ^ tail);
+    return h ? h : 1;
+}
+//< texture_cache
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "core/types.h"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct VulkanEngine;
+
+//> texture_cache
+// NOTE(champ): GPU images shared by every loaded scene, keyed by where the
+// image came from (the resolved URI of an image file, or a hash of the bytes
+// of an embedded one). A scene takes one reference per texture and gives them
+// back when it is cleared. The image is destroyed once the last one is gone
+// and the frames in flight at that point are done with it.
+// Loads run on other threads, so every call locks.
+struct TextureCache {
+    void init(VulkanEngine* engine);
+    // destroys every image, referenced or not
+    void destroy();
+    // destroys the released images whose frames are done, called by the
+    // render thread with the completed frame timeline value
+    void destroy_retired(u64 completedTimelineValue);
+
+    // adds a reference to the image of key and copies it to image (which may
+    // be null), returns false when key is not cached
+    bool acquire(u64 key, AllocatedImage* image);
+    // caches a freshly uploaded image with one reference. When another load
+    // cached the same key in the meantime, image is destroyed and replaced by
+    // the cached one, which gets the reference instead
+    void insert(u64 key, AllocatedImage* image);
+    void release(u64 key);
+
+    // 64 bit hash of the bytes, never 0 so 0 can mean "no key"
+    static u64 hash(const void* data, size_t size, u64 seed = 0);
+
+    // stats, written under the mutex and read from the UI without it
+    std::atomic<u32> imageCount{0};
+    std::atomic<u32> referenceCount{0};
+
+    private:
+    struct Entry {
+        AllocatedImage image;
+        u32 references;
+    };
+    struct RetiredImage {
+        AllocatedImage image;
+        u64 timelineValue;
+    };
+
+    VulkanEngine* engine;
+    std::unordered_map<u64, Entry> entries;
+    std::vector<RetiredImage> retired;
+    std::mutex mutex;
+};
+//< texture_cache
@@ -0,0 +1,472 @@
+#include "core/texture_file.h"
+
+#include "core/bc_encoder.h"
+#include "core/vk_images.h"
+#include "core/vk_upload.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+//> texture_file
+static const u8 KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Ktx2Header {
+    u8 identifier[12];
+    u32 vkFormat;
+    u32 typeSize;
+    u32 pixelWidth;
+    u32 pixelHeight;
+    u32 pixelDepth;
+    u32 layerCount;
+    u32 faceCount;
+    u32 levelCount;
+    u32 supercompressionScheme;
+    u32 dfdByteOffset;
+    u32 dfdByteLength;
+    u32 kvdByteOffset;
+    u32 kvdByteLength;
+    u64 sgdByteOffset;
+    u64 sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header is read as is");
+
+struct Ktx2Level {
+    u64 byteOffset;
+    u64 byteLength;
+    u64 uncompressedByteLength;
+};
+
+// NOTE(champ): offsets into a DDS file, the header follows the "DDS " magic
+constexpr u32 DDS_MAGIC = 0x20534444;
+constexpr size_t DDS_HEIGHT_OFFSET = 12;
+constexpr size_t DDS_WIDTH_OFFSET = 16;
+constexpr size_t DDS_MIP_COUNT_OFFSET = 28;
+constexpr size_t DDS_FOURCC_OFFSET = 84;
+constexpr size_t DDS_DATA_OFFSET = 128;
+// the DX10 extension header sits between the header and the data
+constexpr size_t DDS_DX10_SIZE = 20;
+
+constexpr u32
+fourcc(char a, char b, char c, char d)
+{
+    return (u32)a | ((u32)b << 8) | ((u32)c << 16) | ((u32)d << 24);
+}
+
+template <typename T>
+static T
+read_value(const u8* data, size_t offset)
+{
+    T value;
+    memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+static bool
+is_supported_format(VkFormat format, bool allowUncompressed)
+{
+    if (vkutil::is_block_compressed(format)) {
+        return true;
+    }
+    return allowUncompressed && vkutil::mip_level_size(format, 1, 1) != 0;
+}
+
+// the level count has to fit in the image, some tools write a chain that
+// goes past 1x1
+static bool
+valid_level_count(u32 width, u32 height, u32 mipLevels)
+{
+    u32 fullChain = (u32)std::floor(std::log2(std::max(width, height))) + 1;
+    return mipLevels >= 1 && mipLevels <= std::min(fullChain, MAX_MIP_LEVELS);
+}
+
+static bool
+load_ktx2(const std::string& path, TextureFile& out)
+{
+    const u8* data = out.file.data;
+    size_t size = out.file.size;
+    if (size < sizeof(Ktx2Header)) {
+        return false;
+    }
+    Ktx2Header header = read_value<Ktx2Header>(data, 0);
+    if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        return false;
+    }
+    // NOTE(champ): supercompressed (basis) textures would need a transcoder,
+    // only plain block data is uploaded as is
+    if (header.supercompressionScheme != 0 || header.pixelDepth != 0 || header.layerCount > 1
+        || header.faceCount != 1 || header.pixelWidth == 0 || header.pixelHeight == 0) {
+        spdlog::warn("{} is not a plain 2D texture, skipping it.", path);
+        return false;
+    }
+    VkFormat format = (VkFormat)header.vkFormat;
+    if (!is_supported_format(format, true)
+        || !valid_level_count(header.pixelWidth, header.pixelHeight, header.levelCount)) {
+        spdlog::warn("{} has an unsupported format or mip chain, skipping it.", path);
+        return false;
+    }
+    if (sizeof(Ktx2Header) + (size_t)header.levelCount * sizeof(Ktx2Level) > size) {
+        return false;
+    }
+
+    out.format = format;
+    out.width = header.pixelWidth;
+    out.height = header.pixelHeight;
+    out.mipLevels = header.levelCount;
+    out.storage.resize(vkutil::mip_chain_size(format, out.width, out.height, out.mipLevels));
+
+    size_t offset = 0;
+    u32 width = out.width;
+    u32 height = out.height;
+    for (u32 level = 0; level < header.levelCount; level++) {
+        Ktx2Level index = read_value<Ktx2Level>(data, sizeof(Ktx2Header) + level * sizeof(Ktx2Level));
+        size_t levelSize = vkutil::mip_level_size(format, width, height);
+        if (index.byteLength < levelSize || index.byteOffset > size || index.byteLength > size - index.byteOffset) {
+            spdlog::warn("{} has a truncated mip level, skipping it.", path);
+            return false;
+        }
+        memcpy(out.storage.data() + offset, data + index.byteOffset, levelSize);
+        offset += levelSize;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+
+    out.data = out.storage.data();
+    out.size = out.storage.size();
+    // everything was copied out of the mapping
+    out.file.close();
+    return true;
+}
+
+static bool
+load_dds(const std::string& path, TextureFile& out)
+{
+    const u8* data = out.file.data;
+    size_t size = out.file.size;
+    if (size < DDS_DATA_OFFSET || read_value<u32>(data, 0) != DDS_MAGIC) {
+        return false;
+    }
+
+    size_t dataOffset = DDS_DATA_OFFSET;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    u32 code = read_value<u32>(data, DDS_FOURCC_OFFSET);
+    if (code == fourcc('D', 'X', 'T', '1')) {
+        format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    } else if (code == fourcc('D', 'X', 'T', '5')) {
+        format = VK_FORMAT_BC3_UNORM_BLOCK;
+    } else if (code == fourcc('A', 'T', 'I', '2') || code == fourcc('B', 'C', '5', 'U')) {
+        format = VK_FORMAT_BC5_UNORM_BLOCK;
+    } else if (code == fourcc('D', 'X', '1', '0') && size >= DDS_DATA_OFFSET + DDS_DX10_SIZE) {
+        dataOffset += DDS_DX10_SIZE;
+        // DXGI_FORMAT values
+        switch (read_value<u32>(data, DDS_DATA_OFFSET)) {
+            case 71: format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+            case 72: format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK; break;
+            case 77: format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+            case 78: format = VK_FORMAT_BC3_SRGB_BLOCK; break;
+            case 83: format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+            case 98: format = VK_FORMAT_BC7_UNORM_BLOCK; break;
+            case 99: format = VK_FORMAT_BC7_SRGB_BLOCK; break;
+            default: break;
+        }
+    }
+
+    u32 width = read_value<u32>(data, DDS_WIDTH_OFFSET);
+    u32 height = read_value<u32>(data, DDS_HEIGHT_OFFSET);
+    u32 mipLevels = std::max(read_value<u32>(data, DDS_MIP_COUNT_OFFSET), 1u);
+    if (format == VK_FORMAT_UNDEFINED || width == 0 || height == 0
+        || !valid_level_count(width, height, mipLevels)) {
+        spdlog::warn("{} has an unsupported format or mip chain, skipping it.", path);
+        return false;
+    }
+    size_t chainSize = vkutil::mip_chain_size(format, width, height, mipLevels);
+    if (dataOffset + chainSize > size) {
+        spdlog::warn("{} is truncated, skipping it.", path);
+        return false;
+    }
+
+    out.format = format;
+    out.width = width;
+    out.height = height;
+    out.mipLevels = mipLevels;
+    out.data = data + dataOffset;
+    out.size = chainSize;
+    return true;
+}
+
+bool
+texfile::load(const std::string& path, TextureFile& out)
+{
+    if (!out.file.open(path)) {
+        return false;
+    }
+
+    std::string extension = std::filesystem::path(path).extension().string();
+    bool loaded = extension == ".dds" ? load_dds(path, out) : load_ktx2(path, out);
+    if (!loaded) {
+        out.file.close();
+        out.storage.clear();
+        out.data = nullptr;
+        out.size = 0;
+    }
+    return loaded;
+}
+
+std::string
+texfile::find_sidecar(const std::string& basePath)
+{
+    std::error_code error;
+    for (const std::string& path : sidecar_candidates(basePath)) {
+        if (std::filesystem::is_regular_file(path, error)) {
+            return path;
+        }
+    }
+    return {};
+}
+
+std::vector<std::string>
+texfile::sidecar_candidates(const std::string& basePath)
+{
+    return { basePath + ".ktx2", basePath + ".dds" };
+}
+
+bool
+texfile::parse_format(const char* name, VkFormat* format)
+{
+    struct Named {
+        const char* name;
+        VkFormat format;
+    };
+    static const Named formats[] = {
+        { "bc1", VK_FORMAT_BC1_RGB_UNORM_BLOCK },
+        { "bc3", VK_FORMAT_BC3_UNORM_BLOCK },
+        { "bc5", VK_FORMAT_BC5_UNORM_BLOCK },
+        { "bc7", VK_FORMAT_BC7_UNORM_BLOCK },
+    };
+    for (const Named& named : formats) {
+        if (strcmp(name, named.name) == 0) {
+            *format = named.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char*
+texfile::format_name(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            return "BC1";
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            return "BC3";
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            return "BC5";
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return "BC7";
+        default:
+            return "RGBA8";
+    }
+}
+
+// 2x2 box filter, odd edges reuse their last texel
+static void
+downsample(const std::vector<u8>& src, u32 width, u32 height, std::vector<u8>& dst)
+{
+    u32 dstWidth = std::max(width / 2, 1u);
+    u32 dstHeight = std::max(height / 2, 1u);
+    dst.resize((size_t)dstWidth * dstHeight * 4);
+    for (u32 y = 0; y < dstHeight; y++) {
+        u32 y0 = std::min(y * 2, height - 1);
+        u32 y1 = std::min(y * 2 + 1, height - 1);
+        for (u32 x = 0; x < dstWidth; x++) {
+            u32 x0 = std::min(x * 2, width - 1);
+            u32 x1 = std::min(x * 2 + 1, width - 1);
+            for (u32 c = 0; c < 4; c++) {
+                u32 sum = src[((size_t)y0 * width + x0) * 4 + c] + src[((size_t)y0 * width + x1) * 4 + c]
+                        + src[((size_t)y1 * width + x0) * 4 + c] + src[((size_t)y1 * width + x1) * 4 + c];
+                dst[((size_t)y * dstWidth + x) * 4 + c] = (u8)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+static void
+compress_level(const u8* rgba, u32 width, u32 height, VkFormat format, std::vector<u8>& out)
+{
+    const size_t blockSize = vkutil::mip_level_size(format, 4, 4);
+    u8 block[64];
+    for (u32 by = 0; by < height; by += 4) {
+        for (u32 bx = 0; bx < width; bx += 4) {
+            // blocks past the edge repeat the last row and column
+            for (u32 y = 0; y < 4; y++) {
+                for (u32 x = 0; x < 4; x++) {
+                    u32 sx = std::min(bx + x, width - 1);
+                    u32 sy = std::min(by + y, height - 1);
+                    memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+                }
+            }
+
+            size_t at = out.size();
+            out.resize(at + blockSize);
+            switch (format) {
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK: bc::encode_bc1(block, out.data() + at); break;
+                case VK_FORMAT_BC3_UNORM_BLOCK: bc::encode_bc3(block, out.data() + at); break;
+                case VK_FORMAT_BC5_UNORM_BLOCK: bc::encode_bc5(block, out.data() + at); break;
+                default: bc::encode_bc7(block, out.data() + at); break;
+            }
+        }
+    }
+}
+
+u32
+texfile::compress_mip_chain(const u8* rgba, u32 width, u32 height, VkFormat format, std::vector<u8>& out)
+{
+    // same chain length as create_image gives mipmapped images
+    u32 mipLevels = std::min((u32)std::floor(std::log2(std::max(width, height))) + 1, MAX_MIP_LEVELS);
+    out.reserve(out.size() + vkutil::mip_chain_size(format, width, height, mipLevels));
+
+    std::vector<u8> level(rgba, rgba + (size_t)width * height * 4);
+    std::vector<u8> next;
+    for (u32 i = 0; i < mipLevels; i++) {
+        compress_level(level.data(), width, height, format, out);
+        if (i + 1 < mipLevels) {
+            downsample(level, width, height, next);
+            level.swap(next);
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+    }
+    return mipLevels;
+}
+
+// NOTE(champ): the basic data format descriptor KTX2 requires, one sample
+// per channel of the block. Values come from the Khronos data format spec
+static std::vector<u8>
+make_dfd(VkFormat format)
+{
+    struct Sample {
+        u16 bitOffset;
+        u8 bitLength;
+        u8 channel;
+    };
+    u8 colorModel;
+    std::vector<Sample> samples;
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            colorModel = 128; // KHR_DF_MODEL_BC1A
+            samples = { { 0, 63, 0 } };
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+            colorModel = 130; // KHR_DF_MODEL_BC3
+            samples = { { 0, 63, 15 }, { 64, 63, 0 } };
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            colorModel = 132; // KHR_DF_MODEL_BC5
+            samples = { { 0, 63, 0 }, { 64, 63, 1 } };
+            break;
+        default:
+            colorModel = 134; // KHR_DF_MODEL_BC7
+            samples = { { 0, 127, 0 } };
+            break;
+    }
+
+    const u32 blockSize = 24 + 16 * (u32)samples.size();
+    std::vector<u8> dfd(4 + blockSize, 0);
+    u32 totalSize = (u32)dfd.size();
+    u32 vendorAndType = 0;
+    u32 versionAndSize = 2 | (blockSize << 16);
+    memcpy(dfd.data(), &totalSize, 4);
+    memcpy(dfd.data() + 4, &vendorAndType, 4);
+    memcpy(dfd.data() + 8, &versionAndSize, 4);
+    dfd[12] = colorModel;
+    dfd[13] = 1; // BT709 primaries
+    dfd[14] = 1; // linear transfer, the formats are UNORM
+    dfd[15] = 0; // straight alpha
+    dfd[16] = 3; // 4x4 texel blocks
+    dfd[17] = 3;
+    dfd[20] = (u8)vkutil::mip_level_size(format, 4, 4);
+    for (size_t i = 0; i < samples.size(); i++) {
+        u8* sample = dfd.data() + 28 + i * 16;
+        memcpy(sample, &samples[i].bitOffset, 2);
+        sample[2] = samples[i].bitLength;
+        sample[3] = samples[i].channel;
+        u32 upper = 0xFFFFFFFF;
+        memcpy(sample + 12, &upper, 4);
+    }
+    return dfd;
+}
+
+bool
+texfile::write_ktx2(const std::string& path,
+                    VkFormat format,
+                    u32 width,
+                    u32 height,
+                    u32 mipLevels,
+                    const std::vector<u8>& levels)
+{
+    std::vector<u8> dfd = make_dfd(format);
+
+    Ktx2Header header = {};
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = (u32)format;
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = mipLevels;
+    header.dfdByteOffset = (u32)(sizeof(Ktx2Header) + mipLevels * sizeof(Ktx2Level));
+    header.dfdByteLength = (u32)dfd.size();
+
+    // NOTE(champ): levels go in the file smallest first, each aligned to the
+    // block size (which is a multiple of 4 for every BCn format)
+    const size_t alignment = vkutil::mip_level_size(format, 4, 4);
+    std::vector<Ktx2Level> index(mipLevels);
+    std::vector<size_t> sourceOffsets(mipLevels);
+    size_t sourceOffset = 0;
+    u32 levelWidth = width;
+    u32 levelHeight = height;
+    for (u32 level = 0; level < mipLevels; level++) {
+        sourceOffsets[level] = sourceOffset;
+        index[level].byteLength = vkutil::mip_level_size(format, levelWidth, levelHeight);
+        index[level].uncompressedByteLength = index[level].byteLength;
+        sourceOffset += index[level].byteLength;
+        levelWidth = std::max(levelWidth / 2, 1u);
+        levelHeight = std::max(levelHeight / 2, 1u);
+    }
+    if (sourceOffset > levels.size()) {
+        spdlog::error("Not enough level data to write {}!", path);
+        return false;
+    }
+
+    u64 offset = header.dfdByteOffset + header.dfdByteLength;
+    for (u32 level = mipLevels; level-- > 0;) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        index[level].byteOffset = offset;
+        offset += index[level].byteLength;
+    }
+
+    std::vector<u8> file(offset, 0);
+    memcpy(file.data(), &header, sizeof(header));
+    memcpy(file.data() + sizeof(header), index.data(), index.size() * sizeof(Ktx2Level));
+    memcpy(file.data() + header.dfdByteOffset, dfd.data(), dfd.size());
+    for (u32 level = 0; level < mipLevels; level++) {
+        memcpy(file.data() + index[level].byteOffset, levels.data() + sourceOffsets[level], index[level].byteLength);
+    }
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open()) {
+        spdlog::error("Failed to open {} for writing!", path);
+        return false;
+    }
+    stream.write((const char*)file.data(), (std::streamsize)file.size());
+    return stream.good();
+}
+//< texture_file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "core/types.h"
+#include "core/mapped_file.h"
+#include <string>
+#include <vector>
+
+//> texture_file
+// NOTE(champ): a texture with its whole mip chain from a KTX2 or DDS file,
+// levels packed largest first the way the uploader copies them. DDS files
+// already are, so data points into the mapping. KTX2 stores the smallest
+// level first and gets reordered into storage.
+struct TextureFile {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    u32 width = 0;
+    u32 height = 0;
+    u32 mipLevels = 0;
+    const u8* data = nullptr;
+    size_t size = 0;
+
+    MappedFile file;
+    std::vector<u8> storage;
+};
+
+namespace texfile {
+    // .ktx2 or .dds, only uncompressed 2D BC1/BC3/BC5/BC7 (and RGBA8 for
+    // KTX2) textures with their mips are accepted
+    bool load(const std::string& path, TextureFile& out);
+    // path + ".ktx2" or path + ".dds" if one of them exists, empty otherwise
+    std::string find_sidecar(const std::string& basePath);
+    // every path find_sidecar looks at, in the order it does
+    std::vector<std::string> sidecar_candidates(const std::string& basePath);
+
+    // bc1, bc3, bc5 or bc7
+    bool parse_format(const char* name, VkFormat* format);
+    const char* format_name(VkFormat format);
+
+    // box filters the RGBA8 image down to 1x1 and compresses every level,
+    // appending them to out largest first. Returns the level count
+    u32 compress_mip_chain(const u8* rgba, u32 width, u32 height, VkFormat format, std::vector<u8>& out);
+    // levels packed largest first, as compress_mip_chain writes them
+    bool write_ktx2(const std::string& path, VkFormat format, u32 width, u32 height, u32 mipLevels,
+                    const std::vector<u8>& levels);
+}
+//< texture_file
@@ -82,18 +82,81 @@ struct Vertex {
     glm::vec4 color;
 };
 
+// NOTE(champ): the vertex layout used with --compact-vertices, a third of
+// Vertex. Read as four uints by mesh_compact.vert and unpacked there:
+// positionXY and the low half of positionZNormal are snorm16 positions in the
+// box of GPUMeshBuffers, the high half of positionZNormal is the normal
+// octahedral encoded as two snorm8, uv is two halves and color is RGBA8
+struct CompactVertex {
+    u32 positionXY;
+    u32 positionZNormal;
+    u32 uv;
+    u32 color;
+};
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must match the std430 layout");
+
 // holds the resources needed for a mesh
 struct GPUMeshBuffers {
     
     AllocatedBuffer indexBuffer;
     AllocatedBuffer vertexBuffer;
     VkDeviceAddress vertexBufferAddress;
+    
+    // NOTE(champ): meshes are sub-allocated from the geometry arena, indices
+    // start at firstIndex and are relative to vertexOffset. Meshes that did not
+    // fit have buffers of their own, with null allocations and zero offsets.
+    u32 firstIndex;
+    i32 vertexOffset;
+    u32 indexCount;
+    u32 vertexCount;
+    VmaVirtualAllocation indexAllocation;
+    VmaVirtualAllocation vertexAllocation;
+    // the box compact vertices are quantized in, w unused. The full vertex
+    // shaders ignore it
+    glm::vec4 positionOrigin;
+    glm::vec4 positionExtents;
 };
 
 // push constants for our mesh object draws
 struct GPUDrawPushConstants {
     glm::mat4 worldMatrix;
+    glm::vec4 positionOrigin;
+    glm::vec4 positionExtents;
+    VkDeviceAddress vertexBuffer;
+};
+
+// NOTE(champ): one per opaque surface in the object buffer of a frame, read by
+// cull_objects.comp and mesh_indirect.vert so the layout has to match std430
+struct GPUObjectData {
+    glm::mat4 transform;
+    // w is the sphere radius
+    glm::vec4 boundsOrigin;
+    glm::vec4 boundsExtents;
+    // see GPUMeshBuffers::positionOrigin
+    glm::vec4 positionOrigin;
+    glm::vec4 positionExtents;
     VkDeviceAddress vertexBuffer;
+    u32 firstIndex;
+    u32 indexCount;
+    i32 vertexOffset;
+    // which count the object is added to and where its batch's commands start
+    u32 batchIndex;
+    u32 commandOffset;
+    u32 pad;
+};
+static_assert(sizeof(GPUObjectData) == 160, "GPUObjectData must match the std430 layout");
+
+struct GPUIndirectPushConstants {
+    VkDeviceAddress objectBuffer;
+};
+
+struct GPUCullPushConstants {
+    glm::mat4 viewproj;
+    VkDeviceAddress objectBuffer;
+    VkDeviceAddress commandBuffer;
+    VkDeviceAddress countBuffer;
+    u32 objectCount;
+    u32 batchCount;
 };
 
 struct GPUSceneData {
@@ -131,21 +194,24 @@ struct IRenderable {
     virtual void draw(const glm::mat4& topMatrix, DrawContext& context) = 0; 
 };
 
+struct SceneGraph;
+
 struct Node : public IRenderable {
     
     std::weak_ptr<Node> parent;
     std::vector<std::shared_ptr<Node>> children;
     
+    // NOTE(champ): once a node belongs to a scene graph its transforms live
+    // there, these two are only read while the node is detached. Go through
+    // the accessors below to get the right one.
     glm::mat4 localTransform;
     glm::mat4 worldTransform;
+    SceneGraph* graph = nullptr;
+    u32 graphIndex = 0;
     
-    void refresh_transform(const glm::mat4& parentMatrix)
-    {
-        worldTransform = parentMatrix * localTransform;
-        for (auto c: children) {
-            c->refresh_transform(worldTransform);
-        }
-    }
+    const glm::mat4& world_transform() const;
+    void set_local_transform(const glm::mat4& transform);
+    void refresh_transform(const glm::mat4& parentMatrix);
     
     virtual void draw(const glm::mat4& topMatrix, DrawContext& context)
     {
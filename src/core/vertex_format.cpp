@@ -0,0 +1,118 @@
+#include "core/vertex_format.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/packing.hpp>
+
+//> vertex_format
+void
+vertex_format::position_bounds(const Vertex* vertices, u32 count, glm::vec4& origin, glm::vec4& extents)
+{
+    if (count == 0) {
+        origin = glm::vec4(0.0f);
+        extents = glm::vec4(0.0f);
+        return;
+    }
+    glm::vec3 min_pos = vertices[0].position;
+    glm::vec3 max_pos = vertices[0].position;
+    for (u32 i = 1; i < count; i++) {
+        min_pos = glm::min(min_pos, vertices[i].position);
+        max_pos = glm::max(max_pos, vertices[i].position);
+    }
+    origin = glm::vec4((max_pos + min_pos) / 2.0f, 0.0f);
+    extents = glm::vec4((max_pos - min_pos) / 2.0f, 0.0f);
+}
+
+// NOTE(champ): the unit sphere folded onto the [-1, 1] square, the lower
+// hemisphere is mirrored over the diagonals
+static glm::vec2
+octahedral_encode(glm::vec3 normal)
+{
+    float length = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+    if (length == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+    normal /= length;
+    glm::vec2 encoded = glm::vec2(normal.x, normal.y);
+    if (normal.z < 0.0f) {
+        encoded.x = (1.0f - glm::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+        encoded.y = (1.0f - glm::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return encoded;
+}
+
+static glm::vec3
+octahedral_decode(glm::vec2 encoded)
+{
+    glm::vec3 normal = glm::vec3(encoded.x, encoded.y, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y));
+    float t = glm::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -t : t;
+    normal.y += normal.y >= 0.0f ? -t : t;
+    return glm::normalize(normal);
+}
+
+void
+vertex_format::compress(const Vertex* vertices,
+                        u32 count,
+                        const glm::vec4& origin,
+                        const glm::vec4& extents,
+                        CompactVertex* out)
+{
+    // flat axes keep every vertex at the origin
+    glm::vec3 scale = glm::vec3(extents.x > 0.0f ? 1.0f / extents.x : 0.0f,
+                                extents.y > 0.0f ? 1.0f / extents.y : 0.0f,
+                                extents.z > 0.0f ? 1.0f / extents.z : 0.0f);
+    for (u32 i = 0; i < count; i++) {
+        const Vertex& v = vertices[i];
+        glm::vec3 position = (v.position - glm::vec3(origin)) * scale;
+        glm::vec2 normal = octahedral_encode(v.normal);
+
+        CompactVertex& c = out[i];
+        c.positionXY = glm::packSnorm2x16(glm::vec2(position.x, position.y));
+        c.positionZNormal = (glm::packSnorm2x16(glm::vec2(position.z, 0.0f)) & 0xffffu)
+            | (glm::packSnorm4x8(glm::vec4(0.0f, 0.0f, normal.x, normal.y)) & 0xffff0000u);
+        c.uv = glm::packHalf2x16(glm::vec2(v.uv_x, v.uv_y));
+        c.color = glm::packUnorm4x8(v.color);
+    }
+}
+
+Vertex
+vertex_format::decompress(const CompactVertex& vertex, const glm::vec4& origin, const glm::vec4& extents)
+{
+    glm::vec2 xy = glm::unpackSnorm2x16(vertex.positionXY);
+    glm::vec2 z = glm::unpackSnorm2x16(vertex.positionZNormal);
+    glm::vec4 normal = glm::unpackSnorm4x8(vertex.positionZNormal);
+    glm::vec2 uv = glm::unpackHalf2x16(vertex.uv);
+
+    Vertex v = {};
+    v.position = glm::vec3(origin) + glm::vec3(xy.x, xy.y, z.x) * glm::vec3(extents);
+    v.normal = octahedral_decode(glm::vec2(normal.z, normal.w));
+    v.uv_x = uv.x;
+    v.uv_y = uv.y;
+    v.color = glm::unpackUnorm4x8(vertex.color);
+    return v;
+}
+
+void
+vertex_format::round_trip_error(const Vertex* vertices,
+                                const CompactVertex* compressed,
+                                u32 count,
+                                const glm::vec4& origin,
+                                const glm::vec4& extents,
+                                float& positionError,
+                                float& normalError)
+{
+    positionError = 0.0f;
+    normalError = 0.0f;
+    float size = glm::max(glm::length(glm::vec3(extents)), 1e-6f);
+    for (u32 i = 0; i < count; i++) {
+        const Vertex& v = vertices[i];
+        Vertex decoded = decompress(compressed[i], origin, extents);
+        positionError = glm::max(positionError, glm::distance(v.position, decoded.position) / size);
+        // degenerate normals have no direction to keep
+        if (glm::length(v.normal) > 0.0f) {
+            normalError = glm::max(normalError, glm::distance(glm::normalize(v.normal), decoded.normal));
+        }
+    }
+}
+//< vertex_format
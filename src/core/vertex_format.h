@@ -0,0 +1,23 @@
+#pragma once
+
+#include "core/types.h"
+
+//> vertex_format
+// NOTE(champ): packing of Vertex into CompactVertex, done on the CPU right
+// before the upload so loaders and bakes keep producing full vertices
+namespace vertex_format {
+    // the box holding every position, as origin and half size
+    void position_bounds(const Vertex* vertices, u32 count, glm::vec4& origin, glm::vec4& extents);
+    // quantizes the positions in the box of position_bounds
+    void compress(const Vertex* vertices, u32 count, const glm::vec4& origin, const glm::vec4& extents,
+                  CompactVertex* out);
+
+    // the inverse of compress, for checking the precision on the CPU
+    Vertex decompress(const CompactVertex& vertex, const glm::vec4& origin, const glm::vec4& extents);
+    // largest position and normal distance between the vertices and their
+    // compressed round trip, the position one relative to the box size
+    void round_trip_error(const Vertex* vertices, const CompactVertex* compressed, u32 count,
+                          const glm::vec4& origin, const glm::vec4& extents,
+                          float& positionError, float& normalError);
+}
+//< vertex_format
@@ -80,6 +80,41 @@ void vkutil::copy_image_to_image(VkCommandBuffer cmd, VkImage source,
     vkCmdBlitImage2(cmd, &blitInfo);
 }
 //< copyimg
+//> copybuf
+void vkutil::copy_image_to_buffer(VkCommandBuffer cmd, VkImage source,
+                                  VkBuffer destination, VkExtent2D size) {
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = 0;
+    copyRegion.bufferRowLength = 0;
+    copyRegion.bufferImageHeight = 0;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageExtent = {size.width, size.height, 1};
+    
+    vkCmdCopyImageToBuffer(cmd, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           destination, 1, &copyRegion);
+    
+    // make the copy visible to the host once the frame timeline value of this
+    // submit is reached
+    VkMemoryBarrier2 memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.pNext = nullptr;
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &memoryBarrier;
+    
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+//< copybuf
 //> mipgen
 void vkutil::generate_mipmaps(VkCommandBuffer cmd,
                               VkImage image,
@@ -167,3 +202,59 @@ void vkutil::generate_mipmaps(VkCommandBuffer cmd,
                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 //< mipgen
+
+//> texture_formats
+bool vkutil::is_block_compressed(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t vkutil::mip_level_size(VkFormat format, uint32_t width, uint32_t height)
+{
+    size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return (size_t)width * height * 4;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            return blocks * 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return blocks * 16;
+        default:
+            return 0;
+    }
+}
+
+size_t vkutil::mip_chain_size(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount)
+{
+    size_t size = 0;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        size += mip_level_size(format, width, height);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return size;
+}
+//< texture_formats
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
 
 namespace vkutil {
     
@@ -11,5 +13,16 @@ namespace vkutil {
                              VkImage destination, VkExtent2D srcSize,
                              VkExtent2D dstSize);
     
+    void copy_image_to_buffer(VkCommandBuffer cmd, VkImage source,
+                              VkBuffer destination, VkExtent2D size);
+    
     void generate_mipmaps(VkCommandBuffer cmd, VkImage image, VkExtent2D imageSize);
+    
+    // NOTE(champ): sizes of the color formats textures are uploaded in. BCn
+    // formats are stored in 4x4 blocks, a level smaller than a block still
+    // takes a whole one. Unknown formats return 0
+    bool is_block_compressed(VkFormat format);
+    size_t mip_level_size(VkFormat format, uint32_t width, uint32_t height);
+    // levels packed one after the other, largest first
+    size_t mip_chain_size(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount);
 }
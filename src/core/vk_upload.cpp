@@ -0,0 +1,510 @@
+#include "core/vk_upload.h"
+
+#include "core/engine.h"
+#include "core/vk_images.h"
+#include "core/vk_initializers.h"
+
+static size_t
+align_up(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// NOTE(champ): 16 covers the texel size of every format we upload and the
+// block size of compressed ones
+constexpr size_t STAGING_ALIGNMENT = 16;
+
+static VkSemaphore
+create_timeline(VkDevice device)
+{
+    VkSemaphoreTypeCreateInfo timelineCI = {};
+    timelineCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineCI.pNext = nullptr;
+    timelineCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineCI.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreCI = vkinit::semaphore_create_info();
+    semaphoreCI.pNext = &timelineCI;
+
+    VkSemaphore semaphore;
+    VK_CHECK(vkCreateSemaphore(device, &semaphoreCI, nullptr, &semaphore));
+    return semaphore;
+}
+
+static VkCommandPool
+create_upload_pool(VkDevice device, u32 queueFamily, VkCommandBuffer* commandBuffers)
+{
+    VkCommandPoolCreateInfo poolCI = vkinit::command_pool_create_info(queueFamily,
+                                                                      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VkCommandPool pool;
+    VK_CHECK(vkCreateCommandPool(device, &poolCI, nullptr, &pool));
+
+    VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(pool,
+                                                                                 UPLOAD_COMMAND_BUFFER_COUNT);
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, commandBuffers));
+    return pool;
+}
+
+//> ownership
+// NOTE(champ): the release half goes on the transfer queue and the acquire half
+// on the graphics queue, both have to describe the same transfer
+static void
+transfer_buffer_ownership(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+                          u32 srcFamily, u32 dstFamily, bool release)
+{
+    VkBufferMemoryBarrier2 bufferBarrier = {};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    bufferBarrier.pNext = nullptr;
+    if (release) {
+        bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        bufferBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        bufferBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+    } else {
+        bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        bufferBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+        bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+    }
+    bufferBarrier.srcQueueFamilyIndex = srcFamily;
+    bufferBarrier.dstQueueFamilyIndex = dstFamily;
+    bufferBarrier.buffer = buffer;
+    bufferBarrier.offset = offset;
+    bufferBarrier.size = size;
+
+    VkDependencyInfo depInfo = {};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.pNext = nullptr;
+    depInfo.bufferMemoryBarrierCount = 1;
+    depInfo.pBufferMemoryBarriers = &bufferBarrier;
+
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
+static void
+transfer_image_ownership(VkCommandBuffer cmd, VkImage image,
+                         VkImageLayout currentLayout, VkImageLayout newLayout,
+                         u32 srcFamily, u32 dstFamily, bool release)
+{
+    VkImageMemoryBarrier2 imageBarrier = {};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    imageBarrier.pNext = nullptr;
+    if (release) {
+        imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        imageBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        imageBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+    } else {
+        imageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        imageBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+        imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+    }
+    imageBarrier.oldLayout = currentLayout;
+    imageBarrier.newLayout = newLayout;
+    imageBarrier.srcQueueFamilyIndex = srcFamily;
+    imageBarrier.dstQueueFamilyIndex = dstFamily;
+    imageBarrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    imageBarrier.image = image;
+
+    VkDependencyInfo depInfo = {};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.pNext = nullptr;
+    depInfo.imageMemoryBarrierCount = 1;
+    depInfo.pImageMemoryBarriers = &imageBarrier;
+
+    vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+//< ownership
+
+void
+UploadBatcher::init(VulkanEngine* engine,
+                    VkQueue graphicsQueue,
+                    u32 graphicsFamily,
+                    VkQueue transferQueue,
+                    u32 transferFamily,
+                    size_t stagingSize)
+{
+    this->engine = engine;
+    this->device = engine->_device;
+    this->graphicsQueue = graphicsQueue;
+    this->graphicsFamily = graphicsFamily;
+    this->transferQueue = transferQueue;
+    this->transferFamily = transferFamily;
+    dedicatedTransfer = transferFamily != graphicsFamily;
+
+    graphicsPool = create_upload_pool(device, graphicsFamily, graphicsCommands);
+    timeline = create_timeline(device);
+    if (dedicatedTransfer) {
+        transferPool = create_upload_pool(device, transferFamily, transferCommands);
+        transferTimeline = create_timeline(device);
+    }
+    for (u32 i = 0; i < UPLOAD_COMMAND_BUFFER_COUNT; i++) {
+        commandTickets[i] = 0;
+    }
+
+    stagingCapacity = stagingSize;
+    staging = engine->create_buffer(stagingCapacity,
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                    VMA_MEMORY_USAGE_CPU_ONLY);
+}
+
+void
+UploadBatcher::destroy()
+{
+    wait(lastTicket);
+    retire_completed();
+
+    engine->destroy_buffer(staging);
+    vkDestroySemaphore(device, timeline, nullptr);
+    vkDestroyCommandPool(device, graphicsPool, nullptr);
+    if (dedicatedTransfer) {
+        vkDestroySemaphore(device, transferTimeline, nullptr);
+        vkDestroyCommandPool(device, transferPool, nullptr);
+    }
+}
+
+void
+UploadBatcher::begin()
+{
+    batchMutex.lock();
+    retire_completed();
+}
+
+u64
+UploadBatcher::submit()
+{
+    u64 ticket = 0;
+    if (recording) {
+        flush();
+        ticket = lastTicket;
+    }
+    batchMutex.unlock();
+    return ticket;
+}
+
+void
+UploadBatcher::wait(u64 ticket)
+{
+    if (ticket == 0) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.pNext = nullptr;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &ticket;
+    VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+}
+
+bool
+UploadBatcher::is_complete(u64 ticket)
+{
+    u64 value = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, timeline, &value));
+    return value >= ticket;
+}
+
+void
+UploadBatcher::upload_buffer(VkBuffer dst,
+                             VkDeviceSize dstOffset,
+                             const void* data,
+                             size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    size_t offset;
+    void* mapped;
+    VkBuffer src = allocate_staging(size, offset, mapped);
+    memcpy(mapped, data, size);
+
+    begin_recording();
+
+    VkBufferCopy copy = {0};
+    copy.srcOffset = offset;
+    copy.dstOffset = dstOffset;
+    copy.size = size;
+    vkCmdCopyBuffer(copyCmd, src, dst, 1, &copy);
+
+    if (dedicatedTransfer) {
+        transfer_buffer_ownership(copyCmd, dst, dstOffset, size, transferFamily, graphicsFamily, true);
+        transfer_buffer_ownership(graphicsCmd, dst, dstOffset, size, transferFamily, graphicsFamily, false);
+    }
+
+    uploadedBytes += size;
+}
+
+void
+UploadBatcher::upload_image(const AllocatedImage& image,
+                            const void* data,
+                            size_t size,
+                            bool mipmapped)
+{
+    size_t offset;
+    void* mapped;
+    VkBuffer src = allocate_staging(size, offset, mapped);
+    memcpy(mapped, data, size);
+
+    begin_recording();
+    VkCommandBuffer cmd = copyCmd;
+    vkutil::transition_image(cmd, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = offset;
+    copyRegion.bufferRowLength = 0;
+    copyRegion.bufferImageHeight = 0;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageExtent = image.imageExtent;
+
+    vkCmdCopyBufferToImage(cmd, src, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    // NOTE(champ): blits need a graphics queue, so mipmapped images stay in
+    // TRANSFER_DST until the graphics side has built the other levels
+    VkImageLayout handoffLayout = mipmapped ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+                                            : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    if (dedicatedTransfer)
+    {
+        transfer_image_ownership(copyCmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, handoffLayout,
+                                 transferFamily, graphicsFamily, true);
+        transfer_image_ownership(graphicsCmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, handoffLayout,
+                                 transferFamily, graphicsFamily, false);
+    }
+    else if (!mipmapped)
+    {
+        vkutil::transition_image(cmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, handoffLayout);
+    }
+
+    if (mipmapped)
+    {
+        vkutil::generate_mipmaps(graphicsCmd, image.image,
+                                 VkExtent2D{image.imageExtent.width, image.imageExtent.height});
+    }
+
+    uploadedBytes += size;
+}
+
+void
+UploadBatcher::upload_image_levels(const AllocatedImage& image,
+                                   const void* data,
+                                   size_t size,
+                                   u32 levelCount)
+{
+    size_t offset;
+    void* mapped;
+    VkBuffer src = allocate_staging(size, offset, mapped);
+    memcpy(mapped, data, size);
+
+    begin_recording();
+    VkCommandBuffer cmd = copyCmd;
+    vkutil::transition_image(cmd, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    // NOTE(champ): one region per level, BCn rows are measured in texels so
+    // the tight packing of the levels needs no row length
+    VkBufferImageCopy copyRegions[MAX_MIP_LEVELS] = {};
+    u32 width = image.imageExtent.width;
+    u32 height = image.imageExtent.height;
+    size_t levelOffset = offset;
+    levelCount = std::min(levelCount, MAX_MIP_LEVELS);
+    for (u32 level = 0; level < levelCount; level++)
+    {
+        VkBufferImageCopy& copyRegion = copyRegions[level];
+        copyRegion.bufferOffset = levelOffset;
+        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copyRegion.imageSubresource.mipLevel = level;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = 1;
+        copyRegion.imageExtent = VkExtent3D{width, height, 1};
+
+        levelOffset += vkutil::mip_level_size(image.imageFormat, width, height);
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+
+    vkCmdCopyBufferToImage(cmd, src, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, copyRegions);
+
+    if (dedicatedTransfer)
+    {
+        transfer_image_ownership(copyCmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, transferFamily, graphicsFamily, true);
+        transfer_image_ownership(graphicsCmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, transferFamily, graphicsFamily, false);
+    }
+    else
+    {
+        vkutil::transition_image(cmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    uploadedBytes += size;
+}
+
+void
+UploadBatcher::begin_recording()
+{
+    if (recording) {
+        return;
+    }
+
+    // the slot may still be in use by an older batch
+    wait(commandTickets[currentCommand]);
+
+    VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    graphicsCmd = graphicsCommands[currentCommand];
+    VK_CHECK(vkResetCommandBuffer(graphicsCmd, 0));
+    VK_CHECK(vkBeginCommandBuffer(graphicsCmd, &beginInfo));
+
+    copyCmd = graphicsCmd;
+    if (dedicatedTransfer) {
+        copyCmd = transferCommands[currentCommand];
+        VK_CHECK(vkResetCommandBuffer(copyCmd, 0));
+        VK_CHECK(vkBeginCommandBuffer(copyCmd, &beginInfo));
+    }
+    recording = true;
+}
+
+void
+UploadBatcher::flush()
+{
+    const u64 ticket = nextTicket++;
+
+    VkCommandBufferSubmitInfo graphicsInfo = vkinit::command_buffer_submit_info(graphicsCmd);
+    VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timeline);
+    signalInfo.value = ticket;
+    VkSemaphoreSubmitInfo waitInfo = {};
+
+    if (dedicatedTransfer) {
+        VK_CHECK(vkEndCommandBuffer(copyCmd));
+
+        // NOTE(champ): the transfer queue is only ever used from here, under
+        // batchMutex, so it does not need the engine queue mutex
+        VkCommandBufferSubmitInfo transferInfo = vkinit::command_buffer_submit_info(copyCmd);
+        VkSemaphoreSubmitInfo transferSignal = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+                                                                             transferTimeline);
+        transferSignal.value = ticket;
+        VkSubmitInfo2 transferSubmit = vkinit::submit_info(&transferInfo, &transferSignal, nullptr);
+        VK_CHECK(vkQueueSubmit2(transferQueue, 1, &transferSubmit, VK_NULL_HANDLE));
+
+        waitInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, transferTimeline);
+        waitInfo.value = ticket;
+    }
+    VK_CHECK(vkEndCommandBuffer(graphicsCmd));
+
+    VkSubmitInfo2 graphicsSubmit = vkinit::submit_info(&graphicsInfo, &signalInfo,
+                                                       dedicatedTransfer ? &waitInfo : nullptr);
+    {
+        std::lock_guard<std::mutex> queueLock(engine->_queueMutex);
+        VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &graphicsSubmit, VK_NULL_HANDLE));
+    }
+
+    // everything staged so far belongs to this submit
+    for (StagingRegion& region : regions) {
+        if (region.ticket == 0) {
+            region.ticket = ticket;
+        }
+    }
+    for (OversizedStaging& buffer : oversized) {
+        if (buffer.ticket == 0) {
+            buffer.ticket = ticket;
+        }
+    }
+
+    commandTickets[currentCommand] = ticket;
+    currentCommand = (currentCommand + 1) % UPLOAD_COMMAND_BUFFER_COUNT;
+    recording = false;
+    lastTicket = ticket;
+    submitCount += 1;
+}
+
+void
+UploadBatcher::retire_completed()
+{
+    u64 completed = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, timeline, &completed));
+
+    while (!regions.empty() && regions.front().ticket != 0 && regions.front().ticket <= completed) {
+        regions.pop_front();
+    }
+
+    for (size_t i = 0; i < oversized.size();) {
+        if (oversized[i].ticket != 0 && oversized[i].ticket <= completed) {
+            engine->destroy_buffer(oversized[i].buffer);
+            oversized[i] = oversized.back();
+            oversized.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+VkBuffer
+UploadBatcher::allocate_staging(size_t size,
+                                size_t& offset,
+                                void*& mapped)
+{
+    // NOTE(champ): things that would never fit in the ring get a buffer of
+    // their own, freed once the batch they were part of has finished
+    if (size > stagingCapacity) {
+        OversizedStaging buffer = {};
+        buffer.buffer = engine->create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+        buffer.ticket = 0;
+        oversized.push_back(buffer);
+
+        offset = 0;
+        mapped = buffer.buffer.info.pMappedData;
+        return buffer.buffer.buffer;
+    }
+
+    while (true) {
+        bool fits = false;
+        if (regions.empty()) {
+            offset = 0;
+            fits = true;
+        } else {
+            const StagingRegion& oldest = regions.front();
+            const StagingRegion& newest = regions.back();
+            size_t head = align_up(newest.end, STAGING_ALIGNMENT);
+
+            if (oldest.begin <= newest.begin) {
+                // live data is [oldest.begin, newest.end), try the end first and wrap if needed
+                if (head + size <= stagingCapacity) {
+                    offset = head;
+                    fits = true;
+                } else if (size <= oldest.begin) {
+                    offset = 0;
+                    fits = true;
+                }
+            } else if (head + size <= oldest.begin) {
+                // already wrapped, only the gap up to the oldest region is free
+                offset = head;
+                fits = true;
+            }
+        }
+
+        if (fits) {
+            break;
+        }
+
+        // the ring is full, the oldest region has to finish before it can be reused
+        if (regions.front().ticket == 0 && recording) {
+            flush();
+        }
+        wait(regions.front().ticket);
+        retire_completed();
+    }
+
+    StagingRegion region = {};
+    region.begin = offset;
+    region.end = offset + size;
+    region.ticket = 0;
+    regions.push_back(region);
+
+    mapped = (u8*)staging.info.pMappedData + offset;
+    return staging.buffer;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "core/types.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct VulkanEngine;
+
+constexpr u32 UPLOAD_COMMAND_BUFFER_COUNT = 4;
+constexpr size_t UPLOAD_STAGING_SIZE = 64 * 1024 * 1024;
+// enough for a 32768 texel wide image
+constexpr u32 MAX_MIP_LEVELS = 16;
+
+//> upload_batcher
+// NOTE(champ): uploads go through one persistently mapped staging ring and get
+// recorded into a single command buffer until submit() is called. Every submit
+// signals the next value of a timeline semaphore, which is the ticket that can
+// be waited on. Staging memory is only recycled once its ticket has passed.
+// A batch is recorded by one thread at a time, begin() blocks until the
+// previous batch has been submitted.
+// When the transfer queue belongs to another family than the graphics one,
+// copies run there and the resources are released to the graphics family,
+// which acquires them (and builds mipmaps) in a second submit waiting on the
+// transfer one. Otherwise everything is recorded on the graphics queue.
+struct UploadBatcher {
+    void init(VulkanEngine* engine,
+              VkQueue graphicsQueue, u32 graphicsFamily,
+              VkQueue transferQueue, u32 transferFamily,
+              size_t stagingSize);
+    void destroy();
+
+    void begin();
+    void upload_buffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, size_t size);
+    // copies the RGBA data into mip 0 and leaves the image in SHADER_READ_ONLY_OPTIMAL
+    void upload_image(const AllocatedImage& image, const void* data, size_t size, bool mipmapped);
+    // copies levelCount levels packed largest first (see vkutil::mip_chain_size)
+    // and leaves the image in SHADER_READ_ONLY_OPTIMAL, no mips are built
+    void upload_image_levels(const AllocatedImage& image, const void* data, size_t size, u32 levelCount);
+    // returns the ticket of the batch, 0 if nothing was recorded
+    u64 submit();
+
+    void wait(u64 ticket);
+    bool is_complete(u64 ticket);
+
+    // stats since init, read from the UI while loads record batches
+    std::atomic<u32> submitCount{0};
+    std::atomic<u64> uploadedBytes{0};
+
+    private:
+    struct StagingRegion {
+        size_t begin;
+        size_t end;
+        // 0 while the batch using it has not been submitted
+        u64 ticket;
+    };
+
+    struct OversizedStaging {
+        AllocatedBuffer buffer;
+        u64 ticket;
+    };
+
+    void begin_recording();
+    void flush();
+    void retire_completed();
+    // returns the offset of size bytes in the ring, or the buffer the data has to go to
+    VkBuffer allocate_staging(size_t size, size_t& offset, void*& mapped);
+
+    VulkanEngine* engine;
+    VkDevice device;
+    VkQueue graphicsQueue;
+    VkQueue transferQueue;
+    u32 graphicsFamily;
+    u32 transferFamily;
+    bool dedicatedTransfer;
+
+    // NOTE(champ): both arrays share the same slot and ticket, the transfer
+    // ones are only used with a dedicated transfer queue
+    VkCommandPool graphicsPool;
+    VkCommandPool transferPool = VK_NULL_HANDLE;
+    VkCommandBuffer graphicsCommands[UPLOAD_COMMAND_BUFFER_COUNT];
+    VkCommandBuffer transferCommands[UPLOAD_COMMAND_BUFFER_COUNT];
+    u64 commandTickets[UPLOAD_COMMAND_BUFFER_COUNT];
+    u32 currentCommand = 0;
+    bool recording = false;
+    // what the copies get recorded into, the graphics one when there is no
+    // dedicated transfer queue
+    VkCommandBuffer copyCmd;
+    VkCommandBuffer graphicsCmd;
+
+    // signaled by the graphics submit of a batch, a ticket is a value of it.
+    // transferTimeline is signaled with the same value by the transfer submit
+    VkSemaphore timeline;
+    VkSemaphore transferTimeline = VK_NULL_HANDLE;
+    u64 nextTicket = 1;
+    u64 lastTicket = 0;
+
+    AllocatedBuffer staging;
+    size_t stagingCapacity;
+    std::deque<StagingRegion> regions;
+    std::vector<OversizedStaging> oversized;
+
+    std::mutex batchMutex;
+};
+//< upload_batcher
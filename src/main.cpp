@@ -1,17 +1,177 @@
 #include "core/engine.h"
+#include "core/texture_file.h"
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <thread>
 
-int main() {
+// the file itself, or the .glb/.gltf files of a folder
+static std::vector<std::string>
+collect_gltf_files(const char* target)
+{
+    std::vector<std::string> paths;
+    if (target == nullptr) {
+        return paths;
+    }
+    std::error_code error;
+    if (std::filesystem::is_directory(target, error)) {
+        for (const auto& entry : std::filesystem::directory_iterator(target, error)) {
+            std::string extension = entry.path().extension().string();
+            if (extension == ".glb" || extension == ".gltf") {
+                paths.push_back(entry.path().string());
+            }
+        }
+    } else {
+        paths.push_back(target);
+    }
+    return paths;
+}
+
+int main(int argc, char** argv) {
     spdlog::info("Initializing Application!");
     VulkanEngine app;
-    
+
 #if defined _DEBUG
     constexpr bool useValidationLayers = true;
 #else
     constexpr bool useValidationLayers = false;
 #endif
-    app.init(1024, 720, "Vulkan Engine", useValidationLayers);
-    app.run();
-    
+
+    // NOTE(champ): headless mode renders offscreen without a window or a
+    // swapchain, so it can run on machines without any display
+    bool headless = false;
+    u32 frameCount = 100;
+    const char* outputImage = nullptr;
+
+    // NOTE(champ): benchmark mode replays a camera path over a given scene
+    // and writes per-frame timings to a report
+    bool runBenchmark = false;
+    BenchmarkConfig benchConfig;
+    const char* loadBenchScene = nullptr;
+    u32 loadIterations = 3;
+    u32 cullingIterations = 0;
+    u32 sortIterations = 0;
+    const char* bakeTarget = nullptr;
+    const char* compressTarget = nullptr;
+    VkFormat textureFormat = VK_FORMAT_UNDEFINED;
+    std::vector<std::string> vertexBenchScenes;
+    bool presentModeSet = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frameCount = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputImage = argv[++i];
+        } else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            runBenchmark = true;
+            benchConfig.scenePath = argv[++i];
+        } else if (strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc) {
+            benchConfig.cameraPathFile = argv[++i];
+        } else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            benchConfig.reportPath = argv[++i];
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            benchConfig.warmupFrames = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            app._framesInFlightSetting = std::clamp(atoi(argv[++i]), 1, (int)MAX_FRAMES_IN_FLIGHT);
+        } else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            presentModeSet = parse_present_mode(name, &app._presentModeSetting);
+            if (!presentModeSet) {
+                spdlog::warn("Unknown present mode: {}", name);
+            }
+        } else if (strcmp(argv[i], "--swapchain-images") == 0 && i + 1 < argc) {
+            app._swapchainImageCountSetting = std::max(atoi(argv[++i]), 0);
+        } else if (strcmp(argv[i], "--no-transfer-queue") == 0) {
+            app._useTransferQueue = false;
+        } else if (strcmp(argv[i], "--compact-vertices") == 0) {
+            app._compactVertices = true;
+        } else if (strcmp(argv[i], "--arena-vertices") == 0 && i + 1 < argc) {
+            app._arenaVertexCount = (u32)std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--arena-indices") == 0 && i + 1 < argc) {
+            app._arenaIndexCount = (u32)std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--bench-load") == 0 && i + 1 < argc) {
+            loadBenchScene = argv[++i];
+        } else if (strcmp(argv[i], "--load-iterations") == 0 && i + 1 < argc) {
+            loadIterations = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-culling") == 0 && i + 1 < argc) {
+            cullingIterations = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-sort") == 0 && i + 1 < argc) {
+            sortIterations = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-vertices") == 0 && i + 1 < argc) {
+            vertexBenchScenes.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--bake") == 0 && i + 1 < argc) {
+            bakeTarget = argv[++i];
+        } else if (strcmp(argv[i], "--compress-textures") == 0 && i + 1 < argc) {
+            compressTarget = argv[++i];
+        } else if (strcmp(argv[i], "--texture-format") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (!texfile::parse_format(name, &textureFormat)) {
+                spdlog::warn("Unknown texture format: {}", name);
+            }
+        } else {
+            spdlog::warn("Unknown argument: {}", argv[i]);
+        }
+    }
+
+    // NOTE(champ): the culling and sort benchmarks only run on the CPU, no
+    // need for a window or a device
+    if (cullingIterations > 0) {
+        benchmark::run_culling_benchmark(cullingIterations);
+        return 0;
+    }
+    if (sortIterations > 0) {
+        benchmark::run_sort_benchmark(sortIterations);
+        return 0;
+    }
+    if (!vertexBenchScenes.empty()) {
+        benchmark::run_vertex_benchmark(vertexBenchScenes, loadIterations);
+        return 0;
+    }
+    // NOTE(champ): texture compression and baking are CPU only as well, a
+    // folder processes every glTF file directly inside it. Textures are
+    // compressed first so a bake made in the same run picks them up
+    if (compressTarget || bakeTarget) {
+        JobSystem jobs;
+        jobs.init(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        int failed = 0;
+        for (const std::string& path : collect_gltf_files(compressTarget)) {
+            if (!gltf::compress_textures(path, &jobs, textureFormat)) {
+                spdlog::error("Failed to compress the textures of {}!", path);
+                failed += 1;
+            }
+        }
+        for (const std::string& path : collect_gltf_files(bakeTarget)) {
+            if (!gltf::bake_scene(path, &jobs)) {
+                spdlog::error("Failed to bake {}!", path);
+                failed += 1;
+            }
+        }
+        jobs.shutdown();
+        return failed == 0 ? 0 : 1;
+    }
+
+    // NOTE(champ): vsync would cap the benchmark at the refresh rate, run it
+    // uncapped unless a present mode was asked for
+    if (runBenchmark && !presentModeSet) {
+        app._presentModeSetting = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+
+    app.init(1024, 720, "Vulkan Engine", useValidationLayers, headless);
+    if (loadBenchScene) {
+        benchmark::run_load_benchmark(&app, loadBenchScene, loadIterations);
+    } else if (runBenchmark) {
+        benchConfig.frameCount = frameCount;
+        benchmark::run(&app, benchConfig);
+    } else if (headless) {
+        app.run_headless(frameCount);
+        if (outputImage) {
+            app.save_frame_ppm(outputImage);
+        }
+    } else {
+        app.run();
+    }
+
     app.cleanup();
 }